@@ -13,7 +13,11 @@
 #include <utils/ud.h>
 
 #include <benchmark.h>
+#include <cache_state.h>
+#include <calibration.h>
 #include <fault.h>
+#include <harness.h>
+#include <pmu.h>
 
 #define NOPS ""
 #include <arch/fault.h>
@@ -40,13 +44,13 @@ static inline void fault(void)
 }
 
 static void parse_handler_args(int argc, char **argv,
-                               seL4_CPtr *ep, volatile ccnt_t **start, fault_results_t **results,
+                               seL4_CPtr *ep, volatile ccnt_t **start, harness_t **harness,
                                seL4_CPtr *done_ep, seL4_CPtr *reply)
 {
     assert(argc == N_HANDLER_ARGS);
     *ep = atol(argv[0]);
     *start = (volatile ccnt_t *) atol(argv[1]);
-    *results = (fault_results_t *) atol(argv[2]);
+    *harness = (harness_t *) atol(argv[2]);
     *done_ep = atol(argv[3]);
     *reply = atol(argv[4]);
 }
@@ -85,6 +89,7 @@ static void measure_fault_fn(int argc, char **argv)
     seL4_CPtr done_ep = atol(argv[2]);
 
     for (int i = 0; i < N_RUNS + 1; i++) {
+        cache_state_prepare();
         /* record time */
         SEL4BENCH_READ_CCNT(*start);
         fault();
@@ -92,70 +97,57 @@ static void measure_fault_fn(int argc, char **argv)
     seL4_Send(done_ep, seL4_MessageInfo_new(0, 0, 0, 0));
 }
 
-static void measure_fault_handler_fn(int argc, char **argv)
+/* the timed section of the fault benchmarks, see harness.h */
+static inline ALWAYS_INLINE void fault_handler_loop(harness_kind_t kind, harness_t *harness, seL4_CPtr ep,
+                                                    volatile ccnt_t *start, seL4_CPtr reply, seL4_Word *last_ip)
 {
-    seL4_CPtr ep, done_ep, reply;
-    volatile ccnt_t *start;
-    ccnt_t end;
-    fault_results_t *results;
-
-    parse_handler_args(argc, argv, &ep, &start, &results, &done_ep, &reply);
-
-    seL4_Word ip = fault_handler_start(ep, done_ep, reply);
-    for (int i = 0; i < N_RUNS; i++) {
+    seL4_Word ip = *last_ip;
+    for (seL4_Word i = 0; harness_more(kind, harness, i); i++) {
         ip += UD_INSTRUCTION_SIZE;
         DO_REAL_REPLY_RECV_1(ep, ip, reply);
 
+        ccnt_t end;
         SEL4BENCH_READ_CCNT(end);
-        results->fault[i] = end - *start;
+        harness_collect(kind, harness, i, *start, end);
     }
-    fault_handler_done(ep, ip, done_ep, reply);
+    *last_ip = ip;
 }
 
-static void measure_fault_handler_fn_ep(int argc, char **argv)
+static void measure_fault_handler_fn(int argc, char **argv)
 {
     seL4_CPtr ep, done_ep, reply;
     volatile ccnt_t *start;
-    ccnt_t end, sum = 0, sum2 = 0, overhead;
-    fault_results_t *results;
-    DATACOLLECT_INIT();
-
-    parse_handler_args(argc, argv, &ep, &start, &results, &done_ep, &reply);
+    harness_t *harness;
 
-    overhead = results->fault_ep_min_overhead;
+    parse_handler_args(argc, argv, &ep, &start, &harness, &done_ep, &reply);
 
     seL4_Word ip = fault_handler_start(ep, done_ep, reply);
-    for (seL4_Word i = 0; i < N_RUNS; i++) {
-        ip += UD_INSTRUCTION_SIZE;
-        DO_REAL_REPLY_RECV_1(ep, ip, reply);
+    HARNESS_RUN(harness, fault_handler_loop, ep, start, reply, &ip);
+    fault_handler_done(ep, ip, done_ep, reply);
+}
 
+/* Pair for measuring fault handler -> faultee path */
+static inline ALWAYS_INLINE void fault_reply_loop(harness_kind_t kind, harness_t *harness, volatile ccnt_t *start)
+{
+    for (seL4_Word i = 0; harness_more(kind, harness, i); i++) {
+        fault();
+        ccnt_t end;
         SEL4BENCH_READ_CCNT(end);
-        DATACOLLECT_GET_SUMS(i, N_IGNORED, *start, end, overhead, sum, sum2);
+        harness_collect(kind, harness, i, *start, end);
     }
-
-    results->fault_ep_sum = sum;
-    results->fault_ep_sum2 = sum2;
-    results->fault_ep_num = N_RUNS - N_IGNORED;
-
-    fault_handler_done(ep, ip, done_ep, reply);
 }
 
-/* Pair for measuring fault handler -> faultee path */
 static void measure_fault_reply_fn(int argc, char **argv)
 {
     assert(argc == N_FAULTER_ARGS);
     volatile ccnt_t *start = (volatile ccnt_t *) atol(argv[0]);
-    fault_results_t *results = (fault_results_t *) atol(argv[1]);
+    harness_t *harness = (harness_t *) atol(argv[1]);
     seL4_CPtr done_ep = atol(argv[2]);
 
     /* handle 1 fault first to make sure start is set */
     fault();
-    for (int i = 0; i < N_RUNS + 1; i++) {
-        fault();
-        ccnt_t end;
-        SEL4BENCH_READ_CCNT(end);
-        results->fault_reply[i] = end - *start;
-    }
+    HARNESS_RUN(harness, fault_reply_loop, start);
+    fault();
     seL4_Send(done_ep, seL4_MessageInfo_new(0, 0, 0, 0));
 }
 
@@ -163,13 +155,14 @@ static void measure_fault_reply_handler_fn(int argc, char **argv)
 {
     seL4_CPtr ep, done_ep, reply;
     volatile ccnt_t *start;
-    fault_results_t *results;
+    UNUSED harness_t *harness;
 
-    parse_handler_args(argc, argv, &ep, &start, &results, &done_ep, &reply);
+    parse_handler_args(argc, argv, &ep, &start, &harness, &done_ep, &reply);
 
     seL4_Word ip = fault_handler_start(ep, done_ep, reply);
     for (int i = 0; i <= N_RUNS; i++) {
         ip += UD_INSTRUCTION_SIZE;
+        cache_state_prepare();
         /* record time */
         SEL4BENCH_READ_CCNT(*start);
         /* wait for fault */
@@ -178,88 +171,65 @@ static void measure_fault_reply_handler_fn(int argc, char **argv)
     fault_handler_done(ep, ip, done_ep, reply);
 }
 
-/* measure_fault_reply_fn with early processing */
-static void measure_fault_reply_fn_ep(int argc, char **argv)
+/* round_trip fault handling pair */
+static inline ALWAYS_INLINE void fault_roundtrip_loop(harness_kind_t kind, harness_t *harness)
 {
-    assert(argc == N_FAULTER_ARGS);
-    volatile ccnt_t *start = (volatile ccnt_t *) atol(argv[0]);
-    fault_results_t *results = (fault_results_t *) atol(argv[1]);
-    seL4_CPtr done_ep = atol(argv[2]);
-    ccnt_t overhead, sum = 0, sum2 = 0;
-    DATACOLLECT_INIT();
-
-    overhead = results->fault_reply_ep_min_overhead;
-
-    /* handle 1 fault first to make sure start is set */
-    fault();
-    for (seL4_Word i = 0; i < N_RUNS; i++) {
-        fault();
-        ccnt_t end;
-        SEL4BENCH_READ_CCNT(end);
-        DATACOLLECT_GET_SUMS(i, N_IGNORED, *start, end, overhead, sum, sum2);
+    for (seL4_Word i = 0; harness_more(kind, harness, i); i++) {
+        HARNESS_TIME(kind, harness, i, fault());
     }
-    fault();
-
-    results->fault_reply_ep_sum = sum;
-    results->fault_reply_ep_sum2 = sum2;
-    results->fault_reply_ep_num = N_RUNS - N_IGNORED;
-
-    seL4_Send(done_ep, seL4_MessageInfo_new(0, 0, 0, 0));
 }
 
-/* round_trip fault handling pair */
 static void measure_fault_roundtrip_fn(int argc, char **argv)
 {
     assert(argc == N_FAULTER_ARGS);
-    fault_results_t *results = (fault_results_t *) atol(argv[1]);
+    harness_t *harness = (harness_t *) atol(argv[1]);
     seL4_CPtr done_ep = atol(argv[2]);
 
-    for (int i = 0; i < N_RUNS + 1; i++) {
-        ccnt_t start, end;
-        SEL4BENCH_READ_CCNT(start);
-        fault();
-        SEL4BENCH_READ_CCNT(end);
-        results->round_trip[i] = end - start;
-    }
+    HARNESS_RUN(harness, fault_roundtrip_loop);
+    fault();
     seL4_Send(done_ep, seL4_MessageInfo_new(0, 0, 0, 0));
 }
 
-static void measure_fault_roundtrip_fn_ep(int argc, char **argv)
+static void measure_fault_roundtrip_handler_fn(int argc, char **argv)
 {
-    assert(argc == N_FAULTER_ARGS);
-    fault_results_t *results = (fault_results_t *) atol(argv[1]);
-    seL4_CPtr done_ep = atol(argv[2]);
-    ccnt_t sum = 0, sum2 = 0, overhead;
-    DATACOLLECT_INIT();
+    seL4_CPtr ep, done_ep, reply;
+    UNUSED volatile ccnt_t *start;
+    UNUSED harness_t *harness;
 
-    overhead = results->round_trip_ep_min_overhead;
+    parse_handler_args(argc, argv, &ep, &start, &harness, &done_ep, &reply);
 
-    for (seL4_Word i = 0; i < N_RUNS; i++) {
-        ccnt_t start, end;
-        SEL4BENCH_READ_CCNT(start);
-        fault();
-        SEL4BENCH_READ_CCNT(end);
-        DATACOLLECT_GET_SUMS(i, N_IGNORED, start, end, overhead, sum, sum2);
+    seL4_Word ip = fault_handler_start(ep, done_ep, reply);
+    for (int i = 0; i < N_RUNS; i++) {
+        /* wait for fault */
+        ip += UD_INSTRUCTION_SIZE;
+        DO_REAL_REPLY_RECV_1(ep, ip, reply);
     }
-    fault();
+    fault_handler_done(ep, ip, done_ep, reply);
+}
 
-    results->round_trip_ep_sum = sum;
-    results->round_trip_ep_sum2 = sum2;
-    results->round_trip_ep_num = N_RUNS - N_IGNORED;
+/* round trip fault handling pair, counting events (see pmu.h) */
+static pmu_results_t *round_trip_events;
+
+static void measure_fault_roundtrip_events_fn(int argc, char **argv)
+{
+    assert(argc == N_FAULTER_ARGS);
+    seL4_CPtr done_ep = atol(argv[2]);
 
+    PMU_CAPTURE(round_trip_events->counts, PMU_ROTATIONS, fault());
+    fault();
     seL4_Send(done_ep, seL4_MessageInfo_new(0, 0, 0, 0));
 }
 
-static void measure_fault_roundtrip_handler_fn(int argc, char **argv)
+static void measure_fault_roundtrip_events_handler_fn(int argc, char **argv)
 {
     seL4_CPtr ep, done_ep, reply;
     UNUSED volatile ccnt_t *start;
-    fault_results_t *results;
+    UNUSED harness_t *harness;
 
-    parse_handler_args(argc, argv, &ep, &start, &results, &done_ep, &reply);
+    parse_handler_args(argc, argv, &ep, &start, &harness, &done_ep, &reply);
 
     seL4_Word ip = fault_handler_start(ep, done_ep, reply);
-    for (int i = 0; i < N_RUNS; i++) {
+    for (seL4_Word i = 0; i < pmu_ops(PMU_ROTATIONS); i++) {
         /* wait for fault */
         ip += UD_INSTRUCTION_SIZE;
         DO_REAL_REPLY_RECV_1(ep, ip, reply);
@@ -303,6 +273,29 @@ void run_benchmark(void *faulter_fn, void *handler_fn, seL4_CPtr done_ep)
     ZF_LOGF_IF(error, "Failed to suspend fault handler");
 }
 
+void measure_overhead(fault_results_t *results)
+{
+    ccnt_t start, end;
+    seL4_CPtr ep = 0;
+    UNUSED seL4_Word mr0 = 0;
+    UNUSED seL4_CPtr reply = 0;
+
+    /* overhead of reply recv stub + cycle count */
+    for (int i = 0; i < N_RUNS; i++) {
+        SEL4BENCH_READ_CCNT(start);
+        DO_NOP_REPLY_RECV_1(ep, mr0, reply);
+        SEL4BENCH_READ_CCNT(end);
+        results->reply_recv_overhead[i] = (end - start);
+    }
+
+    /* overhead of cycle count */
+    for (int i = 0; i < N_RUNS; i++) {
+        SEL4BENCH_READ_CCNT(start);
+        SEL4BENCH_READ_CCNT(end);
+        results->ccnt_overhead[i] = (end - start);
+    }
+}
+
 static void run_fault_benchmark(env_t *env, fault_results_t *results)
 {
     /* allocate endpoint */
@@ -316,61 +309,61 @@ static void run_fault_benchmark(env_t *env, fault_results_t *results)
 
     /* create faulter */
     ccnt_t start = 0;
+    /* where the thread taking the samples of a run puts them */
+    harness_t harness;
 
     benchmark_configure_thread(env, fault_endpoint.cptr, seL4_MinPrio + 1, "faulter", &faulter);
     sel4utils_create_word_args(faulter_args, faulter_argv, N_FAULTER_ARGS, (seL4_Word) &start,
-                               (seL4_Word) results, done_ep.cptr);
+                               (seL4_Word) &harness, done_ep.cptr);
 
     /* create fault handler */
     benchmark_configure_thread(env, seL4_CapNull, seL4_MinPrio, "fault handler", &fault_handler);
     configure_fpu(fault_handler.tcb.cptr, false);
     sel4utils_create_word_args(handler_args, handler_argv, N_HANDLER_ARGS,
                                fault_endpoint.cptr, (seL4_Word) &start,
-                               (seL4_Word) results, done_ep.cptr, fault_handler.reply.cptr);
-
-    /* benchmark fault */
-    run_benchmark(measure_fault_fn, measure_fault_handler_fn, done_ep.cptr);
-
-    /* benchmark fault early processing */
-    results->fault_ep_min_overhead = getMinOverhead(results->reply_recv_overhead, N_RUNS);
-    run_benchmark(measure_fault_fn, measure_fault_handler_fn_ep, done_ep.cptr);
-
-    /* benchmark reply */
-    run_benchmark(measure_fault_reply_fn, measure_fault_reply_handler_fn, done_ep.cptr);
-
-    /* benchmark reply early processing */
-    results->fault_reply_ep_min_overhead = getMinOverhead(results->ccnt_overhead, N_RUNS);
-    run_benchmark(measure_fault_reply_fn_ep, measure_fault_reply_handler_fn, done_ep.cptr);
-
-    /* benchmark round_trip */
-    run_benchmark(measure_fault_roundtrip_fn, measure_fault_roundtrip_handler_fn, done_ep.cptr);
-
-    /* benchmark round_trip early processing */
-    results->round_trip_ep_min_overhead = getMinOverhead(results->reply_recv_overhead, N_RUNS);
-    run_benchmark(measure_fault_roundtrip_fn_ep, measure_fault_roundtrip_handler_fn, done_ep.cptr);
-}
-
-void measure_overhead(fault_results_t *results)
-{
-    ccnt_t start, end;
-    seL4_CPtr ep = 0;
-    UNUSED seL4_Word mr0 = 0;
-    UNUSED seL4_CPtr reply = 0;
-
-    /* overhead of reply recv stub + cycle count */
-    for (int i = 0; i < N_RUNS; i++) {
-        SEL4BENCH_READ_CCNT(start);
-        DO_NOP_REPLY_RECV_1(ep, mr0, reply);
-        SEL4BENCH_READ_CCNT(end);
-        results->reply_recv_overhead[i] = (end - start);
-    }
-
-    /* overhead of cycle count */
-    for (int i = 0; i < N_RUNS; i++) {
-        SEL4BENCH_READ_CCNT(start);
-        SEL4BENCH_READ_CCNT(end);
-        results->ccnt_overhead[i] = (end - start);
-    }
+                               (seL4_Word) &harness, done_ep.cptr, fault_handler.reply.cptr);
+
+    do {
+        /* subtract the overheads calibrated by the root task */
+        results->calibration = env->args->calibration;
+        measure_overhead(results);
+
+        /* benchmark fault */
+        harness = harness_raw(results->fault, N_RUNS);
+        run_benchmark(measure_fault_fn, measure_fault_handler_fn, done_ep.cptr);
+
+        /* benchmark fault early processing */
+        results->fault_ep_min_overhead = results->calibration.overheads[CALIBRATION_REPLY_RECV_1].value;
+        harness = harness_sums(results->fault_ep_min_overhead, N_RUNS, N_IGNORED, &results->fault_ep_sum,
+                               &results->fault_ep_sum2, &results->fault_ep_num);
+        run_benchmark(measure_fault_fn, measure_fault_handler_fn, done_ep.cptr);
+
+        /* benchmark reply */
+        harness = harness_raw(results->fault_reply, N_RUNS);
+        run_benchmark(measure_fault_reply_fn, measure_fault_reply_handler_fn, done_ep.cptr);
+
+        /* benchmark reply early processing */
+        results->fault_reply_ep_min_overhead = results->calibration.overheads[CALIBRATION_CCNT].value;
+        harness = harness_sums(results->fault_reply_ep_min_overhead, N_RUNS, N_IGNORED, &results->fault_reply_ep_sum,
+                               &results->fault_reply_ep_sum2, &results->fault_reply_ep_num);
+        run_benchmark(measure_fault_reply_fn, measure_fault_reply_handler_fn, done_ep.cptr);
+
+        /* benchmark round_trip */
+        harness = harness_raw(results->round_trip, N_RUNS);
+        run_benchmark(measure_fault_roundtrip_fn, measure_fault_roundtrip_handler_fn, done_ep.cptr);
+
+        /* benchmark round_trip early processing */
+        results->round_trip_ep_min_overhead = results->calibration.overheads[CALIBRATION_REPLY_RECV_1].value;
+        harness = harness_sums(results->round_trip_ep_min_overhead, N_RUNS, N_IGNORED, &results->round_trip_ep_sum,
+                               &results->round_trip_ep_sum2, &results->round_trip_ep_num);
+        run_benchmark(measure_fault_roundtrip_fn, measure_fault_roundtrip_handler_fn, done_ep.cptr);
+
+        if (config_set(CONFIG_PMU_EVENTS)) {
+            round_trip_events = &results->round_trip_events;
+            run_benchmark(measure_fault_roundtrip_events_fn, measure_fault_roundtrip_events_handler_fn,
+                          done_ep.cptr);
+        }
+    } while (benchmark_iteration_done(EXIT_SUCCESS));
 }
 
 int main(int argc, char **argv)
@@ -393,7 +386,6 @@ int main(int argc, char **argv)
 
     sel4bench_init();
 
-    measure_overhead(results);
     run_fault_benchmark(env, results);
 
     /* done -> results are stored in shared memory so we can now return */
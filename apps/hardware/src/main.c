@@ -11,8 +11,12 @@
 #include <sel4/sel4.h>
 #include <sel4bench/arch/sel4bench.h>
 
+#include <adaptive.h>
 #include <benchmark.h>
+#include <calibration.h>
+#include <harness.h>
 #include <hardware.h>
+#include <pmu.h>
 
 #define NOPS ""
 
@@ -34,35 +38,17 @@ void measure_nullsyscall_overhead(ccnt_t *results)
     }
 }
 
-void measure_nullsyscall(ccnt_t *results)
+/* the timed section of every null syscall result, see harness.h */
+static inline ALWAYS_INLINE void measure_nullsyscall_loop(harness_kind_t kind, harness_t *harness)
 {
-    ccnt_t start, end;
-    for (int i = 0; i < N_RUNS; i++) {
-        SEL4BENCH_READ_CCNT(start);
-        DO_REAL_NULLSYSCALL();
-        SEL4BENCH_READ_CCNT(end);
-        results[i] = (end - start);
+    for (seL4_Word i = 0; harness_more(kind, harness, i); i++) {
+        HARNESS_TIME(kind, harness, i, DO_REAL_NULLSYSCALL());
     }
-
 }
 
-void measure_nullsyscall_ep(hardware_results_t *results)
+static void measure_nullsyscall(harness_t *harness)
 {
-    ccnt_t start, end, sum = 0, sum2 = 0, overhead;
-
-    overhead = results->overhead_min;
-    DATACOLLECT_INIT();
-
-    for (seL4_Word i = 0; i < N_RUNS; i++) {
-        SEL4BENCH_READ_CCNT(start);
-        DO_REAL_NULLSYSCALL();
-        SEL4BENCH_READ_CCNT(end);
-        DATACOLLECT_GET_SUMS(i, N_IGNORED, start, end, overhead, sum, sum2);
-    }
-
-    results->nullSyscall_ep_sum = sum;
-    results->nullSyscall_ep_sum2 = sum2;
-    results->nullSyscall_ep_num = N_RUNS - N_IGNORED;
+    HARNESS_RUN(harness, measure_nullsyscall_loop);
 }
 
 int main(int argc, char **argv)
@@ -77,10 +63,40 @@ int main(int argc, char **argv)
 
     sel4bench_init();
 
-    /* measure overhead */
-    measure_nullsyscall_overhead(results->nullSyscall_overhead);
-    measure_nullsyscall(results->nullSyscall_results);
-    measure_nullsyscall_ep(results);
+    do {
+        /* subtract the overhead calibrated by the root task */
+        results->calibration = env->args->calibration;
+        results->overhead_min = results->calibration.overheads[CALIBRATION_NULLSYSCALL].value;
+
+        /* measure overhead */
+        measure_nullsyscall_overhead(results->nullSyscall_overhead);
+
+        adaptive_t adaptive;
+        adaptive_init(&adaptive, N_RUNS - N_IGNORED, N_ADAPTIVE_RUNS - N_IGNORED);
+        harness_t harness = harness_adaptive(results->nullSyscall_results, N_ADAPTIVE_RUNS, N_IGNORED,
+                                             &adaptive);
+        measure_nullsyscall(&harness);
+        results->nullSyscall_runs = adaptive.n + N_IGNORED;
+        results->nullSyscall_converged = adaptive_converged(&adaptive);
+
+        harness = harness_sums(results->overhead_min, N_RUNS, N_IGNORED, &results->nullSyscall_ep_sum,
+                               &results->nullSyscall_ep_sum2, &results->nullSyscall_ep_num);
+        measure_nullsyscall(&harness);
+
+        harness = harness_histogram(&results->nullSyscall_histogram, results->overhead_min,
+                                    hardware_histogram_runs(), N_IGNORED);
+        measure_nullsyscall(&harness);
+
+        if (CONFIG_HARDWARE_RING_SAMPLES > 0) {
+            benchmark_ring_set_stream(env, HARDWARE_RING_NULLSYSCALL);
+            harness = harness_ring(env, CONFIG_HARDWARE_RING_SAMPLES);
+            measure_nullsyscall(&harness);
+        }
+
+        if (config_set(CONFIG_PMU_EVENTS)) {
+            PMU_CAPTURE(results->nullSyscall_events.counts, PMU_ROTATIONS, DO_REAL_NULLSYSCALL());
+        }
+    } while (benchmark_iteration_done(EXIT_SUCCESS));
 
     /* done -> results are stored in shared memory so we can now return */
     benchmark_finished(EXIT_SUCCESS);
@@ -22,8 +22,13 @@
 #include <utils/util.h>
 #include <vka/vka.h>
 
+#include <adaptive.h>
 #include <benchmark.h>
+#include <cache_state.h>
+#include <calibration.h>
 #include <ipc.h>
+#include <pmu.h>
+#include <shuffle.h>
 
 /* arch/ipc.h requires these defines */
 #define NOPS ""
@@ -32,7 +37,6 @@
 
 #define NUM_ARGS 3
 #define WARMUPS RUNS
-#define OVERHEAD_RETRIES 4
 
 #ifndef CONFIG_CYCLE_COUNT
 
@@ -131,7 +135,8 @@ static inline void dummy_cache_func(void) {}
 } while (0)
 
 #else
-#define CACHE_FUNC dummy_cache_func
+/* see CacheState */
+#define CACHE_FUNC cache_state_prepare
 #endif
 
 seL4_Word ipc_call_func(int argc, char *argv[]);
@@ -144,6 +149,12 @@ seL4_Word ipc_replyrecv_10_func2(int argc, char *argv[]);
 seL4_Word ipc_replyrecv_10_func(int argc, char *argv[]);
 seL4_Word ipc_send_func(int argc, char *argv[]);
 seL4_Word ipc_recv_func(int argc, char *argv[]);
+seL4_Word ipc_call_events_func(int argc, char *argv[]);
+seL4_Word ipc_call_10_events_func(int argc, char *argv[]);
+seL4_Word ipc_replyrecv_events_func(int argc, char *argv[]);
+seL4_Word ipc_replyrecv_10_events_func(int argc, char *argv[]);
+seL4_Word ipc_send_events_func(int argc, char *argv[]);
+seL4_Word ipc_recv_events_func(int argc, char *argv[]);
 
 static helper_func_t bench_funcs[] = {
     ipc_call_func,
@@ -155,7 +166,13 @@ static helper_func_t bench_funcs[] = {
     ipc_replyrecv_10_func2,
     ipc_replyrecv_10_func,
     ipc_send_func,
-    ipc_recv_func
+    ipc_recv_func,
+    ipc_call_events_func,
+    ipc_call_10_events_func,
+    ipc_replyrecv_events_func,
+    ipc_replyrecv_10_events_func,
+    ipc_send_events_func,
+    ipc_recv_events_func
 };
 
 #define IPC_CALL_FUNC(name, bench_func, send_func, call_func, send_start_end, length, cache_func) \
@@ -257,56 +274,171 @@ seL4_Word ipc_send_func(int argc, char *argv[])
     return 0;
 }
 
-#define MEASURE_OVERHEAD(op, dest, decls) do { \
-    uint32_t i; \
-    timing_init(); \
-    for (i = 0; i < OVERHEAD_RETRIES; i++) { \
-        uint32_t j; \
-        for (j = 0; j < RUNS; j++) { \
-            uint32_t k; \
-            decls; \
-            ccnt_t start, end; \
-            COMPILER_MEMORY_FENCE(); \
-            for (k = 0; k < WARMUPS; k++) { \
-                READ_COUNTER_BEFORE(start); \
-                op; \
-                READ_COUNTER_AFTER(end); \
-            } \
-            COMPILER_MEMORY_FENCE(); \
-            dest[j] = end - start; \
+/*
+ * The events functions count nothing themselves: the main thread counts the events of
+ * a chunk (see pmu.h and count_events), while the client runs AVERAGE_RUNS ipcs each
+ * time it is signalled on go (its third argument) and sends a result when done. The
+ * server serves the ipcs until it is suspended.
+ */
+#define IPC_CALL_EVENTS_FUNC(name, bench_func, length) \
+seL4_Word name(int argc, char *argv[]) { \
+    seL4_CPtr ep = atoi(argv[0]);\
+    seL4_CPtr result_ep = atoi(argv[1]);\
+    seL4_CPtr go = atoi(argv[2]);\
+    seL4_MessageInfo_t tag = seL4_MessageInfo_new(0, 0, 0, length); \
+    seL4_Call(ep, tag); \
+    while (true) { \
+        seL4_Wait(go, NULL); \
+        for (int i = 0; i < AVERAGE_RUNS; i++) { \
+            bench_func(ep, tag); \
         } \
-        if (results_stable(dest, RUNS)) break; \
+        send_result(result_ep, 0); \
+    } \
+    return 0; \
+}
+
+IPC_CALL_EVENTS_FUNC(ipc_call_events_func, DO_REAL_CALL, 0)
+IPC_CALL_EVENTS_FUNC(ipc_call_10_events_func, DO_REAL_CALL_10, 10)
+
+#define IPC_REPLY_RECV_EVENTS_FUNC(name, bench_func, length) \
+seL4_Word name(int argc, char *argv[]) { \
+    seL4_MessageInfo_t tag = seL4_MessageInfo_new(0, 0, 0, length); \
+    seL4_CPtr ep = atoi(argv[0]);\
+    seL4_CPtr reply = atoi(argv[2]);\
+    if (config_set(CONFIG_KERNEL_MCS)) {\
+        api_nbsend_recv(ep, tag, ep, NULL, reply);\
+    } else {\
+        api_recv(ep, NULL, reply); \
+    }\
+    while (true) { \
+        bench_func(ep, tag, reply); \
     } \
-    timing_destroy(); \
-} while(0)
+    return 0; \
+}
+
+IPC_REPLY_RECV_EVENTS_FUNC(ipc_replyrecv_events_func, DO_REAL_REPLY_RECV, 0)
+IPC_REPLY_RECV_EVENTS_FUNC(ipc_replyrecv_10_events_func, DO_REAL_REPLY_RECV_10, 10)
 
-static void measure_overhead(ipc_results_t *results)
+seL4_Word ipc_send_events_func(int argc, char *argv[])
 {
-    MEASURE_OVERHEAD(DO_NOP_CALL(0, tag),
-                     results->overhead_benchmarks[CALL_OVERHEAD],
-                     seL4_MessageInfo_t tag = seL4_MessageInfo_new(0, 0, 0, 0));
-    MEASURE_OVERHEAD(DO_NOP_REPLY_RECV(0, tag, 0),
-                     results->overhead_benchmarks[REPLY_RECV_OVERHEAD],
-                     seL4_MessageInfo_t tag = seL4_MessageInfo_new(0, 0, 0, 0));
-    MEASURE_OVERHEAD(DO_NOP_SEND(0, tag),
-                     results->overhead_benchmarks[SEND_OVERHEAD],
-                     seL4_MessageInfo_t tag = seL4_MessageInfo_new(0, 0, 0, 0));
-    MEASURE_OVERHEAD(DO_NOP_RECV(0, 0),
-                     results->overhead_benchmarks[RECV_OVERHEAD],
-                     {});
-    MEASURE_OVERHEAD(DO_NOP_CALL_10(0, tag10),
-                     results->overhead_benchmarks[CALL_10_OVERHEAD],
-                     seL4_MessageInfo_t tag10 = seL4_MessageInfo_new(0, 0, 0, 10));
-    MEASURE_OVERHEAD(DO_NOP_REPLY_RECV_10(0, tag10, 0),
-                     results->overhead_benchmarks[REPLY_RECV_10_OVERHEAD],
-                     seL4_MessageInfo_t tag10 = seL4_MessageInfo_new(0, 0, 0, 10));
+    seL4_CPtr ep = atoi(argv[0]);
+    seL4_CPtr result_ep = atoi(argv[1]);
+    seL4_CPtr go = atoi(argv[2]);
+    seL4_MessageInfo_t tag = seL4_MessageInfo_new(0, 0, 0, 0);
+    while (true) {
+        seL4_Wait(go, NULL);
+        for (int i = 0; i < AVERAGE_RUNS; i++) {
+            DO_REAL_SEND(ep, tag);
+        }
+        send_result(result_ep, 0);
+    }
+    return 0;
+}
+
+seL4_Word ipc_recv_events_func(int argc, char *argv[])
+{
+    seL4_CPtr ep = atoi(argv[0]);
+    UNUSED seL4_CPtr reply = atoi(argv[2]);
+    while (true) {
+        DO_REAL_RECV(ep, reply);
+    }
+    return 0;
 }
 
-void run_bench(env_t *env, cspacepath_t result_ep_path, seL4_CPtr ep,
-               const benchmark_params_t *params,
+/* time op with READ_COUNTER_*, which do not always count cycles */
+#define SAMPLE_OVERHEAD(op) do { \
+    READ_COUNTER_BEFORE(start); \
+    op; \
+    READ_COUNTER_AFTER(end); \
+} while (0)
+
+static ccnt_t sample_overhead(calibration_overhead_id_t id)
+{
+    ccnt_t start = 0, end = 0;
+    seL4_MessageInfo_t tag = seL4_MessageInfo_new(0, 0, 0, 0);
+    seL4_MessageInfo_t tag10 = seL4_MessageInfo_new(0, 0, 0, 10);
+
+    COMPILER_MEMORY_FENCE();
+    for (int i = 0; i < WARMUPS; i++) {
+        switch (id) {
+        case CALIBRATION_CALL:
+            SAMPLE_OVERHEAD(DO_NOP_CALL(0, tag));
+            break;
+        case CALIBRATION_REPLY_RECV:
+            SAMPLE_OVERHEAD(DO_NOP_REPLY_RECV(0, tag, 0));
+            break;
+        case CALIBRATION_SEND:
+            SAMPLE_OVERHEAD(DO_NOP_SEND(0, tag));
+            break;
+        case CALIBRATION_RECV:
+            SAMPLE_OVERHEAD(DO_NOP_RECV(0, 0));
+            break;
+        case CALIBRATION_CALL_10:
+            SAMPLE_OVERHEAD(DO_NOP_CALL_10(0, tag10));
+            break;
+        case CALIBRATION_REPLY_RECV_10:
+            SAMPLE_OVERHEAD(DO_NOP_REPLY_RECV_10(0, tag10, 0));
+            break;
+        default:
+            ZF_LOGF("Not an ipc overhead: %d", id);
+        }
+    }
+    COMPILER_MEMORY_FENCE();
+
+    return end - start;
+}
+
+static void measure_overhead(env_t *env, ipc_results_t *results)
+{
+    /* the root task calibrated the overheads in cycles */
+    results->calibration = env->args->calibration;
+    if (results->calibration.valid && config_set(CONFIG_CYCLE_COUNT)) {
+        return;
+    }
+
+    timing_init();
+    for (int id = CALIBRATION_CALL; id <= CALIBRATION_REPLY_RECV_10; id++) {
+        results->calibration.overheads[id] = calibration_estimate(id, sample_overhead);
+    }
+    timing_destroy();
+    results->calibration.valid = true;
+}
+
+/*
+ * Count the events of the ipcs of the client of an events function, a chunk of events
+ * for each AVERAGE_RUNS of them (see pmu.h). The handshake of each chunk with the
+ * client is counted too.
+ */
+static void count_events(seL4_CPtr result_ep, seL4_CPtr go, pmu_results_t *events)
+{
+    pmu_session_t pmu = pmu_session_new();
+    for (int rotation = 0; rotation < PMU_ROTATIONS; rotation++) {
+        for (seL4_Word chunk = 0; chunk < pmu_chunks(&pmu); chunk++) {
+            pmu_chunk_start(&pmu, chunk);
+            seL4_Signal(go);
+            get_result(result_ep);
+            pmu_chunk_stop(&pmu, events->counts[rotation]);
+        }
+    }
+}
+
+/* Does the server tell us it is initialised before it serves ipcs? */
+static bool server_announces(helper_func_id_t server_fn)
+{
+    return config_set(CONFIG_KERNEL_MCS) && server_fn != IPC_RECV_FUNC && server_fn != IPC_RECV_EVENTS_FUNC;
+}
+
+/*
+ * Run client and server, with the functions set as their entry points, and take a
+ * sample: the start and end the two send back. If events is not NULL, they run events
+ * functions instead, whose events are counted into it.
+ */
+void run_bench(env_t *env, cspacepath_t result_ep_path, seL4_CPtr ep, seL4_CPtr go,
+               const benchmark_params_t *params, pmu_results_t *events,
                ccnt_t *ret1, ccnt_t *ret2,
                helper_thread_t *client, helper_thread_t *server)
 {
+    helper_func_id_t server_fn = events ? params->server_events_fn : params->server_fn;
 
     timing_init();
 
@@ -315,7 +447,7 @@ void run_bench(env_t *env, cspacepath_t result_ep_path, seL4_CPtr ep,
                                         server->argv, 1);
     ZF_LOGF_IF(error, "Failed to spawn server\n");
 
-    if (config_set(CONFIG_KERNEL_MCS) && params->server_fn != IPC_RECV_FUNC) {
+    if (server_announces(server_fn)) {
         /* wait for server to tell us its initialised */
         seL4_Wait(ep, NULL);
 
@@ -331,16 +463,22 @@ void run_bench(env_t *env, cspacepath_t result_ep_path, seL4_CPtr ep,
     ZF_LOGF_IF(error, "Failed to spawn client\n");
 
     /* get results */
-    *ret1 = get_result(result_ep_path.capPtr);
+    if (events) {
+        count_events(result_ep_path.capPtr, go, events);
+    } else {
+        *ret1 = get_result(result_ep_path.capPtr);
+    }
 
-    if (config_set(CONFIG_KERNEL_MCS) && params->server_fn != IPC_RECV_FUNC && params->passive) {
+    if (server_announces(server_fn) && params->passive) {
         /* convert server to active so it can send us the result */
         error = api_sc_bind(server->process.thread.sched_context.cptr,
                             server->process.thread.tcb.cptr);
         ZF_LOGF_IF(error, "Failed to convert server to active");
     }
 
-    *ret2 = get_result(result_ep_path.capPtr);
+    if (!events) {
+        *ret2 = get_result(result_ep_path.capPtr);
+    }
 
     /* clean up - clean server first in case it is sharing the client's cspace and vspace */
     seL4_TCB_Suspend(client->process.thread.tcb.cptr);
@@ -349,22 +487,62 @@ void run_bench(env_t *env, cspacepath_t result_ep_path, seL4_CPtr ep,
     timing_destroy();
 }
 
+/* Set up client and server to run client_fn and server_fn at the point of params, and
+ * return the server to run */
+static helper_thread_t *prepare_bench(seL4_CPtr auth, const benchmark_params_t *params,
+                                      helper_func_id_t client_fn, helper_func_id_t server_fn,
+                                      helper_thread_t *client, helper_thread_t *server_thread,
+                                      helper_thread_t *server_process)
+{
+    seL4_CPtr client_tcb = client->process.thread.tcb.cptr;
+
+    /* Enable client FPU explicitly, even though it's on by default: */
+    configure_fpu(client_tcb, true);
+
+    /* set up client for benchmark */
+    int error = seL4_TCB_SetPriority(client_tcb, auth, params->client_prio);
+    ZF_LOGF_IF(error, "Failed to set client prio");
+    client->process.entry_point = bench_funcs[client_fn];
+
+    helper_thread_t *server = params->same_vspace ? server_thread : server_process;
+    seL4_CPtr tcb = server->process.thread.tcb.cptr;
+
+    configure_fpu(tcb, params->server_fpu);
+    error = seL4_TCB_SetPriority(tcb, auth, params->server_prio);
+    assert(error == seL4_NoError);
+    server->process.entry_point = bench_funcs[server_fn];
+
+    return server;
+}
+
+/* Does every benchmark have enough samples? */
+static bool all_done(size_t n, adaptive_t adaptive[n])
+{
+    for (size_t j = 0; j < n; j++) {
+        if (!adaptive_done(&adaptive[j])) {
+            return false;
+        }
+    }
+    return true;
+}
+
 int main(int argc, char **argv)
 {
     env_t *env;
-    vka_object_t ep, result_ep;
+    vka_object_t ep, result_ep, go;
     cspacepath_t ep_path, result_ep_path;
 
     static size_t object_freq[seL4_ObjectTypeCount] = {
         [seL4_TCBObject] = 4,
         [seL4_EndpointObject] = 2,
+        [seL4_NotificationObject] = 1,
 #ifdef CONFIG_KERNEL_MCS
         [seL4_SchedContextObject] = 4,
         [seL4_ReplyObject] = 4
 #endif
     };
 
-    env = benchmark_get_env(argc, argv, sizeof(ipc_results_t), object_freq);
+    env = benchmark_get_env(argc, argv, IPC_RESULTS_SIZE, object_freq);
     ipc_results_t *results = (ipc_results_t *) env->results;
 
     /* allocate benchmark endpoint - the IPC's that we benchmark
@@ -381,8 +559,12 @@ int main(int argc, char **argv)
     }
     vka_cspace_make_path(&env->slab_vka, result_ep.cptr, &result_ep_path);
 
-    /* measure benchmarking overhead */
-    measure_overhead(results);
+    /* allocate the notification that starts each chunk of the events functions */
+    if (vka_alloc_notification(&env->slab_vka, &go) != 0) {
+        ZF_LOGF("Failed to allocate notification");
+    }
+    cspacepath_t go_path;
+    vka_cspace_make_path(&env->slab_vka, go.cptr, &go_path);
 
     helper_thread_t client, server_thread, server_process;
 
@@ -392,6 +574,7 @@ int main(int argc, char **argv)
 
     client.ep = sel4utils_copy_path_to_process(&client.process, ep_path);
     client.result_ep = sel4utils_copy_path_to_process(&client.process, result_ep_path);
+    seL4_CPtr client_go = sel4utils_copy_path_to_process(&client.process, go_path);
 
     server_process.ep = sel4utils_copy_path_to_process(&server_process.process, ep_path);
     server_process.result_ep = sel4utils_copy_path_to_process(&server_process.process, result_ep_path);
@@ -399,65 +582,81 @@ int main(int argc, char **argv)
     server_thread.ep = client.ep;
     server_thread.result_ep = client.result_ep;
 
-    sel4utils_create_word_args(client.argv_strings, client.argv, NUM_ARGS, client.ep, client.result_ep, 0);
+    sel4utils_create_word_args(client.argv_strings, client.argv, NUM_ARGS, client.ep, client.result_ep, client_go);
     sel4utils_create_word_args(server_process.argv_strings, server_process.argv, NUM_ARGS,
                                server_process.ep, server_process.result_ep, SEL4UTILS_REPLY_SLOT);
     sel4utils_create_word_args(server_thread.argv_strings, server_thread.argv, NUM_ARGS,
                                server_thread.ep, server_thread.result_ep, SEL4UTILS_REPLY_SLOT);
 
-    /* run the benchmark */
     seL4_CPtr auth = simple_get_tcb(&env->simple);
-    ccnt_t start, end;
-    for (int i = 0; i < RUNS; i++) {
-        int j;
-        ZF_LOGI("--------------------------------------------------\n");
-        ZF_LOGI("Doing iteration %d\n", i);
-        ZF_LOGI("--------------------------------------------------\n");
-        for (j = 0; j < ARRAY_SIZE(benchmark_params); j++) {
-            const struct benchmark_params *params = &benchmark_params[j];
-            seL4_CPtr client_tcb = client.process.thread.tcb.cptr;
-
-            ZF_LOGI("%s\t: IPC duration (%s), client prio: %3d server prio %3d, %s vspace, %s, length %2d\n",
-                    params->name,
-                    params->direction == DIR_TO ? "client --> server" : "server --> client",
-                    params->client_prio, params->server_prio,
-                    params->same_vspace ? "same" : "diff",
-                    (config_set(CONFIG_KERNEL_MCS) && params->passive) ? "passive" : "active", params->length);
-
-            /* Enable client FPU explicitly, even though it's on by default: */
-            configure_fpu(client_tcb, true);
-
-            /* set up client for benchmark */
-            int error = seL4_TCB_SetPriority(client_tcb, auth, params->client_prio);
-            ZF_LOGF_IF(error, "Failed to set client prio");
-            client.process.entry_point = bench_funcs[params->client_fn];
-
-            if (params->same_vspace) {
-                seL4_CPtr tcb = server_thread.process.thread.tcb.cptr;
-
-                configure_fpu(tcb, params->server_fpu);
-                error = seL4_TCB_SetPriority(tcb, auth, params->server_prio);
-                assert(error == seL4_NoError);
-                server_thread.process.entry_point = bench_funcs[params->server_fn];
-            } else {
-                seL4_CPtr tcb = server_process.process.thread.tcb.cptr;
-
-                configure_fpu(tcb, params->server_fpu);
-                error = seL4_TCB_SetPriority(tcb, auth, params->server_prio);
-                assert(error == seL4_NoError);
-                server_process.process.entry_point = bench_funcs[params->server_fn];
-            }
-
-            run_bench(env, result_ep_path, ep_path.capPtr, params, &end, &start, &client,
-                      params->same_vspace ? &server_thread : &server_process);
+    do {
+        /* measure benchmarking overhead */
+        measure_overhead(env, results);
+
+        /* work out what to run */
+        results->n_benchmarks = benchmark_sweep_size(env, sweep_size(&ipc_sweep));
+        for (int j = 0; j < results->n_benchmarks; j++) {
+            size_t n = benchmark_sweep_overridden(env) ? env->args->params.values[j] : j;
+            results->benchmarks[j].point = sweep_point(&ipc_sweep, n);
+            ZF_LOGF_IF(!sweep_valid(&ipc_sweep, results->benchmarks[j].point), "Invalid ipc benchmark %zu", n);
+        }
 
-            if (end > start) {
-                results->benchmarks[j][i] = end - start;
-            } else {
-                results->benchmarks[j][i] = start - end;
+        /* run the benchmark, until each one has enough samples. Each round takes a sample
+         * of every benchmark, in a random order with ShuffleOrder */
+        ccnt_t start, end;
+        adaptive_t adaptive[results->n_benchmarks];
+        for (int j = 0; j < results->n_benchmarks; j++) {
+            adaptive_init(&adaptive[j], RUNS, ADAPTIVE_RUNS);
+        }
+        shuffle_t shuffle = shuffle_new(env->args->order_seed);
+        size_t order[results->n_benchmarks];
+        for (int i = 0; !all_done(results->n_benchmarks, adaptive); i++) {
+            ZF_LOGI("--------------------------------------------------\n");
+            ZF_LOGI("Doing iteration %d\n", i);
+            ZF_LOGI("--------------------------------------------------\n");
+            shuffle_order(&shuffle, results->n_benchmarks, order);
+            for (size_t k = 0; k < results->n_benchmarks; k++) {
+                size_t j = order[k];
+                if (adaptive_done(&adaptive[j])) {
+                    continue;
+                }
+                const benchmark_params_t params = ipc_benchmark_params(results->benchmarks[j].point);
+
+                ZF_LOGI("%s\t: IPC duration (%s), client prio: %3d server prio %3d, %s vspace, %s, length %2d\n",
+                        params.name,
+                        params.direction == DIR_TO ? "client --> server" : "server --> client",
+                        params.client_prio, params.server_prio,
+                        params.same_vspace ? "same" : "diff",
+                        (config_set(CONFIG_KERNEL_MCS) && params.passive) ? "passive" : "active", params.length);
+
+                helper_thread_t *server = prepare_bench(auth, &params, params.client_fn, params.server_fn,
+                                                        &client, &server_thread, &server_process);
+                run_bench(env, result_ep_path, ep_path.capPtr, go.cptr, &params, NULL, &end, &start, &client,
+                          server);
+
+                ccnt_t sample = end > start ? end - start : start - end;
+                results->benchmarks[j].samples[adaptive[j].n] = sample;
+                adaptive_add(&adaptive[j], sample);
             }
         }
-    }
+        for (int j = 0; j < results->n_benchmarks; j++) {
+            results->benchmarks[j].runs = adaptive[j].n;
+            results->benchmarks[j].converged = adaptive_converged(&adaptive[j]);
+        }
+
+#ifdef CONFIG_PMU_EVENTS
+        /* then count the events of each benchmark */
+        shuffle_order(&shuffle, results->n_benchmarks, order);
+        for (size_t k = 0; k < results->n_benchmarks; k++) {
+            size_t j = order[k];
+            const benchmark_params_t params = ipc_benchmark_params(results->benchmarks[j].point);
+            helper_thread_t *server = prepare_bench(auth, &params, params.client_events_fn, params.server_events_fn,
+                                                    &client, &server_thread, &server_process);
+            run_bench(env, result_ep_path, ep_path.capPtr, go.cptr, &params, &results->benchmarks[j].events,
+                      NULL, NULL, &client, server);
+        }
+#endif
+    } while (benchmark_iteration_done(EXIT_SUCCESS));
 
     /* done -> results are stored in shared memory so we can now return */
     benchmark_finished(EXIT_SUCCESS);
@@ -20,6 +20,7 @@
 
 #include <benchmark.h>
 #include <irq.h>
+#include <shared_mem.h>
 
 #define INTERRUPT_PERIOD_NS (10 * NS_IN_MS)
 
@@ -162,10 +163,12 @@ int main(int argc, char **argv)
     results->overhead_min = getMinOverhead(results->overheads, N_RUNS);
 
     /* create a frame for the shared time variable so we can share it between processes */
-    ccnt_t *local_current_time = (ccnt_t *) vspace_new_pages(&env->vspace, seL4_AllRights, 1, seL4_PageBits);
+    size_t page_bits;
+    ccnt_t *local_current_time = (ccnt_t *) shared_mem_alloc(&env->vspace, sizeof(ccnt_t), &page_bits);
     if (local_current_time == NULL) {
         ZF_LOGF("Failed to allocate page");
     }
+    shared_mem_prefault(local_current_time, sizeof(ccnt_t));
 
     /* first run the benchmark between two threads in the current address space */
     benchmark_configure_thread(env, endpoint.cptr, seL4_MaxPrio - 1, "ticker", &ticker);
@@ -235,7 +238,7 @@ int main(int argc, char **argv)
 
     /* share the current time variable with the spinner process */
     void *current_time_remote = vspace_share_mem(&env->vspace, &spinner_process.vspace,
-                                                 (void *) local_current_time, 1, seL4_PageBits,
+                                                 (void *) local_current_time, 1, page_bits,
                                                  seL4_AllRights, true);
     assert(current_time_remote != NULL);
 
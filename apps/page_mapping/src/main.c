@@ -8,7 +8,9 @@
 #include <vka/capops.h>
 #include <sel4bench/arch/sel4bench.h>
 #include <benchmark.h>
+#include <cache_state.h>
 #include <page_mapping.h>
+#include <pmu.h>
 
 #if CONFIG_ARCH_AARCH64
 /* Pick START_ADDR below userTop, but high to avoid existing mapping in
@@ -169,6 +171,7 @@ bench_proc(int argc UNUSED, char *argv[])
     seL4_CPtr pt_ptr_start = free_slot;
     /* Install page tables to avoid mapping to fail */
     COMPILER_MEMORY_FENCE();
+    cache_state_prepare();
     SEL4BENCH_READ_CCNT(start);
 
     prepare_page_table(addr, npage, untyped, &free_slot);
@@ -180,6 +183,7 @@ bench_proc(int argc UNUSED, char *argv[])
     seL4_CPtr page_ptr_start = free_slot;
     /* allocate pages */
     COMPILER_MEMORY_FENCE();
+    cache_state_prepare();
     SEL4BENCH_READ_CCNT(start);
 
     prepare_pages(npage, untyped, &free_slot);
@@ -190,6 +194,7 @@ bench_proc(int argc UNUSED, char *argv[])
 
     /* Do the real mapping */
     COMPILER_MEMORY_FENCE();
+    cache_state_prepare();
     SEL4BENCH_READ_CCNT(start);
 
     map_pages(addr, page_ptr_start, npage);
@@ -200,6 +205,7 @@ bench_proc(int argc UNUSED, char *argv[])
 
     /* Protect mapped page as seL4_CanRead */
     COMPILER_MEMORY_FENCE();
+    cache_state_prepare();
     SEL4BENCH_READ_CCNT(start);
 
     prot_pages(addr, page_ptr_start, npage);
@@ -210,6 +216,7 @@ bench_proc(int argc UNUSED, char *argv[])
 
     /* Unprotect it back */
     COMPILER_MEMORY_FENCE();
+    cache_state_prepare();
     SEL4BENCH_READ_CCNT(start);
 
     unprot_pages(addr, page_ptr_start, npage);
@@ -261,6 +268,36 @@ static void measure_overhead(page_mapping_results_t *results)
     sel4bench_destroy();
 }
 
+/*
+ * Count the events (see pmu.h) of mapping a page and unmapping it again. The page
+ * tables are in place, so this is the mapping itself, which the phases above time
+ * for many pages at once.
+ */
+static void measure_map_unmap_events(env_t *env, pmu_results_t *events)
+{
+    long err UNUSED;
+    void *vaddr = vspace_new_pages(&env->vspace, seL4_AllRights, 1, seL4_PageBits);
+    ZF_LOGF_IF(vaddr == NULL, "Failed to map a page");
+    seL4_CPtr frame = vspace_get_cap(&env->vspace, vaddr);
+
+    err = seL4_ARCH_Page_Unmap(frame);
+    assert(err == 0);
+
+    sel4bench_init();
+    PMU_CAPTURE(events->counts, PMU_ROTATIONS, {
+        seL4_ARCH_Page_Map(frame, SEL4UTILS_PD_SLOT, (seL4_Word) vaddr, seL4_AllRights,
+                           seL4_ARCH_Default_VMAttributes);
+        seL4_ARCH_Page_Unmap(frame);
+    });
+    sel4bench_destroy();
+
+    /* map it back for the vspace to free */
+    err = seL4_ARCH_Page_Map(frame, SEL4UTILS_PD_SLOT, (seL4_Word) vaddr, seL4_AllRights,
+                             seL4_ARCH_Default_VMAttributes);
+    assert(err == 0);
+    vspace_unmap_pages(&env->vspace, vaddr, 1, seL4_PageBits, VSPACE_FREE);
+}
+
 int main(int argc, char *argv[])
 {
     env_t *env;
@@ -304,33 +341,49 @@ int main(int argc, char *argv[])
     proc.result_ep = sel4utils_copy_path_to_process(&proc.process,
                                                     result_ep_path);
 
-    measure_overhead(results);
-    for (int i = 0; i < RUNS; i++) {
-        for (int j = 0; j < TESTS; j++) {
-            proc.untyped = sel4utils_copy_path_to_process(&proc.process,
-                                                          untyped_path);
-            proc.npage = page_mapping_benchmark_params[j].npage;
-
-            sel4utils_create_word_args(proc.argv_strings, proc.argv, NUM_ARGS,
-                                       proc.result_ep, proc.untyped, proc.npage);
-
-            /* run test */
-            ccnt_t ret_time[NPHASE] = {0};
-            run_bench_child_proc(env, &result_ep_path, ret_time, &proc);
-            /* record result */
-            for (int k = 0; k < NPHASE; k++) {
-                results->benchmarks_result[j][k][i] = ret_time[k];
-            }
-            vka_cnode_revoke(&untyped_path);
+    do {
+        /* work out what to run */
+        results->n_tests = benchmark_sweep_size(env, TESTS);
+        for (int j = 0; j < results->n_tests; j++) {
+            results->npage[j] = benchmark_sweep_overridden(env) ? env->args->params.values[j] :
+                                sweep_value(&page_mapping_sweep, sweep_point(&page_mapping_sweep, j), 0);
+            ZF_LOGF_IF(results->npage[j] == 0 || results->npage[j] > MAX_NPAGE,
+                       "Can only map between 1 and %d pages", MAX_NPAGE);
+        }
 
-            /* Manually set next free slot to make sure untyped cap is set
-             * at the same slot every time*/
-            proc.process.cspace_next_free--;
+        measure_overhead(results);
+        for (int i = 0; i < RUNS; i++) {
+            for (int j = 0; j < results->n_tests; j++) {
+                proc.untyped = sel4utils_copy_path_to_process(&proc.process,
+                                                              untyped_path);
+                proc.npage = results->npage[j];
+
+                sel4utils_create_word_args(proc.argv_strings, proc.argv, NUM_ARGS,
+                                           proc.result_ep, proc.untyped, proc.npage);
+
+                /* run test */
+                ccnt_t ret_time[NPHASE] = {0};
+                run_bench_child_proc(env, &result_ep_path, ret_time, &proc);
+                /* record result */
+                for (int k = 0; k < NPHASE; k++) {
+                    results->benchmarks_result[j][k][i] = ret_time[k];
+                }
+                vka_cnode_revoke(&untyped_path);
+
+                /* Manually set next free slot to make sure untyped cap is set
+                 * at the same slot every time*/
+                proc.process.cspace_next_free--;
+
+                /* suspend proc to be reused */
+                seL4_TCB_Suspend(proc.process.thread.tcb.cptr);
+            }
+        }
 
-            /* suspend proc to be reused */
-            seL4_TCB_Suspend(proc.process.thread.tcb.cptr);
+        if (config_set(CONFIG_PMU_EVENTS)) {
+            measure_map_unmap_events(env, &results->map_unmap_events);
         }
-    }
+    } while (benchmark_iteration_done(EXIT_SUCCESS));
+
     vka_free_object(&env->delegate_vka, &untyped_obj);
 
     benchmark_finished(EXIT_SUCCESS);
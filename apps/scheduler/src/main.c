@@ -11,13 +11,19 @@
 #include <sel4bench/arch/sel4bench.h>
 
 #include <benchmark.h>
+#include <cache_state.h>
+#include <calibration.h>
+#include <harness.h>
+#include <pmu.h>
 #include <scheduler.h>
+#include <shared_mem.h>
+#include <shuffle.h>
 
 #define NOPS ""
 
 #include <arch/signal.h>
-#define N_LOW_ARGS 8
-#define N_HIGH_ARGS 4
+#define N_LOW_ARGS 6
+#define N_HIGH_ARGS 6
 #define N_YIELD_ARGS 2
 
 void abort(void)
@@ -33,9 +39,17 @@ void high_fn(int argc, char **argv)
     seL4_CPtr done_ep = (seL4_CPtr) atol(argv[1]);
     volatile ccnt_t *start = (volatile ccnt_t *) atol(argv[2]);
     seL4_CPtr consume = (seL4_CPtr) atol(argv[3]);
+    seL4_Word runs = (seL4_Word) atol(argv[4]);
+    seL4_Word warmups = (seL4_Word) atol(argv[5]);
 
-    for (int i = 0; i < N_RUNS; i++) {
+    for (seL4_Word i = 0; i < warmups; i++) {
         DO_REAL_SIGNAL(produce);
+        DO_REAL_WAIT(consume);
+    }
+
+    for (seL4_Word i = 0; i < runs; i++) {
+        DO_REAL_SIGNAL(produce);
+        cache_state_prepare();
         /* we're running at high prio, read the cycle counter */
         SEL4BENCH_READ_CCNT(*start);
         DO_REAL_WAIT(consume);
@@ -47,54 +61,78 @@ void high_fn(int argc, char **argv)
     seL4_Wait(produce, NULL);
 }
 
+/* high_fn for the rounds of low_events_fn */
+void high_events_fn(int argc, char **argv)
+{
+    assert(argc == N_HIGH_ARGS);
+    seL4_CPtr produce = (seL4_CPtr) atol(argv[0]);
+    seL4_CPtr done_ep = (seL4_CPtr) atol(argv[1]);
+    seL4_CPtr consume = (seL4_CPtr) atol(argv[3]);
+
+    for (seL4_Word i = 0; i < pmu_ops(PMU_ROTATIONS); i++) {
+        DO_REAL_SIGNAL(produce);
+        DO_REAL_WAIT(consume);
+    }
+
+    /* signal completion */
+    seL4_Send(done_ep, seL4_MessageInfo_new(0, 0, 0, 0));
+    /* block */
+    seL4_Wait(produce, NULL);
+}
+
+/* the timed section of the prio benchmarks, see harness.h */
+static inline ALWAYS_INLINE void low_loop(harness_kind_t kind, harness_t *harness, seL4_CPtr produce,
+                                          volatile ccnt_t *start, seL4_CPtr consume)
+{
+    for (seL4_Word i = 0; harness_more(kind, harness, i); i++) {
+        ccnt_t end;
+        DO_REAL_WAIT(produce);
+        SEL4BENCH_READ_CCNT(end);
+        harness_collect(kind, harness, i, *start, end);
+        DO_REAL_SIGNAL(consume);
+    }
+}
+
 void low_fn(int argc, char **argv)
 {
     assert(argc == N_LOW_ARGS);
     seL4_CPtr produce = (seL4_CPtr) atol(argv[0]);
     volatile ccnt_t *start = (volatile ccnt_t *) atol(argv[1]);
-    ccnt_t *results = (ccnt_t *) atol(argv[2]);
+    harness_t *harness = (harness_t *) atol(argv[2]);
     seL4_CPtr done_ep = (seL4_CPtr) atol(argv[3]);
     seL4_CPtr consume = (seL4_CPtr) atol(argv[4]);
+    seL4_Word warmups = (seL4_Word) atol(argv[5]);
 
-    for (int i = 0; i < N_RUNS; i++) {
-        ccnt_t end;
+    /* the rounds high_fn runs before its timed ones */
+    for (seL4_Word i = 0; i < warmups; i++) {
         DO_REAL_WAIT(produce);
-        SEL4BENCH_READ_CCNT(end);
-        results[i] = (end - *start);
         DO_REAL_SIGNAL(consume);
     }
 
+    HARNESS_RUN(harness, low_loop, produce, start, consume);
+
     /* signal completion */
     seL4_Send(done_ep, seL4_MessageInfo_new(0, 0, 0, 0));
     /* block */
     seL4_Wait(produce, NULL);
 }
 
-void low_fn_ep(int argc, char **argv)
+/*
+ * The same as low_fn, but counts the events (see pmu.h) of a round with high_events_fn,
+ * into the pmu_results_t passed instead of a harness: both thread switches.
+ */
+void low_events_fn(int argc, char **argv)
 {
     assert(argc == N_LOW_ARGS);
     seL4_CPtr produce = (seL4_CPtr) atol(argv[0]);
-    volatile ccnt_t *start = (volatile ccnt_t *) atol(argv[1]);
-    ccnt_t overhead = (ccnt_t) atol(argv[2]);
-    ccnt_t *out_sum = (ccnt_t *) atol(argv[3]);
-    ccnt_t *out_sum2 = (ccnt_t *) atol(argv[4]);
-    ccnt_t *out_num = (ccnt_t *) atol(argv[5]);
-    seL4_CPtr done_ep = (seL4_CPtr) atol(argv[6]);
-    seL4_CPtr consume = (seL4_CPtr) atol(argv[7]);
-
-    ccnt_t sum = 0, sum2 = 0;
-    DATACOLLECT_INIT();
-    for (seL4_Word i = 0; i < N_RUNS; i++) {
-        ccnt_t end;
+    pmu_results_t *events = (pmu_results_t *) atol(argv[2]);
+    seL4_CPtr done_ep = (seL4_CPtr) atol(argv[3]);
+    seL4_CPtr consume = (seL4_CPtr) atol(argv[4]);
+
+    PMU_CAPTURE(events->counts, PMU_ROTATIONS, {
         DO_REAL_WAIT(produce);
-        SEL4BENCH_READ_CCNT(end);
-        DATACOLLECT_GET_SUMS(i, N_IGNORED, *start, end, overhead, sum, sum2);
         DO_REAL_SIGNAL(consume);
-    }
-
-    *out_sum = sum;
-    *out_sum2 = sum2;
-    *out_num = N_RUNS - N_IGNORED;
+    });
 
     /* signal completion */
     seL4_Send(done_ep, seL4_MessageInfo_new(0, 0, 0, 0));
@@ -119,54 +157,51 @@ static void yield_fn(int argc, char **argv)
     seL4_Call(ep, seL4_MessageInfo_new(0, 0, 0, 0));
 }
 
-static void benchmark_yield(seL4_CPtr ep, ccnt_t *results, volatile ccnt_t *end)
+/* yield_fn for the yields of benchmark_yield_events */
+static void yield_events_fn(int argc, char **argv)
 {
-    ccnt_t start;
-    /* run the benchmark */
-    for (int i = 0; i < N_RUNS; i++) {
-        SEL4BENCH_READ_CCNT(start);
+    assert(argc == N_YIELD_ARGS);
+
+    seL4_CPtr ep = (seL4_CPtr) atol(argv[0]);
+
+    for (seL4_Word i = 0; i < pmu_ops(PMU_ROTATIONS); i++) {
         seL4_Yield();
-        results[i] = (*end - start);
     }
 
-    benchmark_wait_children(ep, "yielder", 1);
+    /* Do a blocking call that doens't return: */
+    seL4_Call(ep, seL4_MessageInfo_new(0, 0, 0, 0));
 }
 
-static void benchmark_yield_ep(seL4_CPtr ep, ccnt_t overhead, ccnt_t *result_sum, ccnt_t *result_sum2,
-                               ccnt_t *result_num, volatile ccnt_t *end)
+/* the timed section of the yield benchmarks, see harness.h */
+static inline ALWAYS_INLINE void yield_loop(harness_kind_t kind, harness_t *harness, volatile ccnt_t *end)
 {
-    ccnt_t start, sum = 0, sum2 = 0;
-    DATACOLLECT_INIT();
-    /* run the benchmark */
-    for (seL4_Word i = 0; i < N_RUNS; i++) {
+    ccnt_t start;
+    for (seL4_Word i = 0; harness_more(kind, harness, i); i++) {
+        cache_state_prepare();
         SEL4BENCH_READ_CCNT(start);
         seL4_Yield();
-        DATACOLLECT_GET_SUMS(i, N_IGNORED, start, *end, overhead, sum, sum2);
+        harness_collect(kind, harness, i, start, *end);
     }
+}
 
-    *result_sum = sum;
-    *result_sum2 = sum2;
-    *result_num = N_RUNS - N_IGNORED;
+static void benchmark_yield(seL4_CPtr ep, harness_t *harness, volatile ccnt_t *end)
+{
+    /* run the benchmark */
+    HARNESS_RUN(harness, yield_loop, end);
 
     benchmark_wait_children(ep, "yielder", 1);
 }
 
-static void benchmark_yield_thread(env_t *env, seL4_CPtr ep, ccnt_t *results)
+/* count the events of a yield to the yielder and back (see pmu.h) */
+static void benchmark_yield_events(seL4_CPtr ep, pmu_results_t *events)
 {
-    sel4utils_thread_t thread;
-    volatile ccnt_t end;
-    char args_strings[N_YIELD_ARGS][WORD_STRING_SIZE];
-    char *argv[N_YIELD_ARGS];
-
-    benchmark_configure_thread(env, ep, seL4_MaxPrio, "yielder", &thread);
-    sel4utils_create_word_args(args_strings, argv, N_YIELD_ARGS, ep, (seL4_Word) &end);
-    sel4utils_start_thread(&thread, (sel4utils_thread_entry_fn) yield_fn, (void *) N_YIELD_ARGS, (void *) argv, 1);
+    PMU_CAPTURE(events->counts, PMU_ROTATIONS, seL4_Yield());
 
-    benchmark_yield(ep, results, &end);
-    seL4_TCB_Suspend(thread.tcb.cptr);
+    benchmark_wait_children(ep, "yielder", 1);
 }
 
-static void benchmark_yield_thread_ep(env_t *env, seL4_CPtr ep, scheduler_results_t *results)
+/* time yields with harness or, if events is not NULL, count their events into it */
+static void benchmark_yield_thread(env_t *env, seL4_CPtr ep, harness_t *harness, pmu_results_t *events)
 {
     sel4utils_thread_t thread;
     volatile ccnt_t end;
@@ -175,18 +210,23 @@ static void benchmark_yield_thread_ep(env_t *env, seL4_CPtr ep, scheduler_result
 
     benchmark_configure_thread(env, ep, seL4_MaxPrio, "yielder", &thread);
     sel4utils_create_word_args(args_strings, argv, N_YIELD_ARGS, ep, (seL4_Word) &end);
-    sel4utils_start_thread(&thread, (sel4utils_thread_entry_fn) yield_fn, (void *) N_YIELD_ARGS, (void *) argv, 1);
+    sel4utils_start_thread(&thread, (sel4utils_thread_entry_fn) (events ? yield_events_fn : yield_fn),
+                           (void *) N_YIELD_ARGS, (void *) argv, 1);
 
-    benchmark_yield_ep(ep, results->overhead_ccnt_min, &results->thread_yield_ep_sum, &results->thread_yield_ep_sum2,
-                       &results->thread_yield_ep_num, &end);
+    if (events) {
+        benchmark_yield_events(ep, events);
+    } else {
+        benchmark_yield(ep, harness, &end);
+    }
     seL4_TCB_Suspend(thread.tcb.cptr);
 }
 
-static void benchmark_yield_process(env_t *env, seL4_CPtr ep, ccnt_t *results)
+static void benchmark_yield_process(env_t *env, seL4_CPtr ep, harness_t *harness, pmu_results_t *events)
 {
     sel4utils_process_t process;
     void *start;
     void *remote_start;
+    size_t page_bits;
     seL4_CPtr remote_ep;
     char args_strings[N_YIELD_ARGS][WORD_STRING_SIZE];
     char *argv[N_YIELD_ARGS];
@@ -194,13 +234,13 @@ static void benchmark_yield_process(env_t *env, seL4_CPtr ep, ccnt_t *results)
     cspacepath_t path;
 
     /* allocate a page to share for the start cycle count */
-    start = vspace_new_pages(&env->vspace, seL4_AllRights, 1, seL4_PageBits);
+    start = shared_mem_alloc(&env->vspace, sizeof(ccnt_t), &page_bits);
     assert(start != NULL);
 
     benchmark_shallow_clone_process(env, &process, seL4_MaxPrio, yield_fn, "yield process");
 
     /* share memory for shared variable */
-    remote_start = vspace_share_mem(&env->vspace, &process.vspace, start, 1, seL4_PageBits,
+    remote_start = vspace_share_mem(&env->vspace, &process.vspace, start, 1, page_bits,
                                     seL4_AllRights, 1);
     assert(remote_start != NULL);
 
@@ -211,89 +251,69 @@ static void benchmark_yield_process(env_t *env, seL4_CPtr ep, ccnt_t *results)
 
     sel4utils_create_word_args(args_strings, argv, N_YIELD_ARGS, remote_ep, (seL4_Word) remote_start);
 
+    if (events) {
+        process.entry_point = yield_events_fn;
+    }
     error = benchmark_spawn_process(&process, &env->slab_vka, &env->vspace, N_YIELD_ARGS, argv, 1);
     assert(error == seL4_NoError);
 
-    benchmark_yield(ep, results, (volatile ccnt_t *) start);
+    if (events) {
+        benchmark_yield_events(ep, events);
+    } else {
+        shared_mem_prefault(start, sizeof(ccnt_t));
+        benchmark_yield(ep, harness, (volatile ccnt_t *) start);
+    }
     seL4_TCB_Suspend(process.thread.tcb.cptr);
 }
 
-static void benchmark_yield_process_ep(env_t *env, seL4_CPtr ep, scheduler_results_t *results)
+/*
+ * Where the samples of a prio benchmark at the i-th priority go: the raw results
+ * or, for early processing, their sums.
+ */
+static harness_t prio_harness(harness_kind_t kind, scheduler_results_t *results, bool process, int i)
 {
-    sel4utils_process_t process;
-    void *start;
-    void *remote_start;
-    seL4_CPtr remote_ep;
-    char args_strings[N_YIELD_ARGS][WORD_STRING_SIZE];
-    char *argv[N_YIELD_ARGS];
-    UNUSED int error;
-    cspacepath_t path;
-
-    /* allocate a page to share for the start cycle count */
-    start = vspace_new_pages(&env->vspace, seL4_AllRights, 1, seL4_PageBits);
-    assert(start != NULL);
-
-    benchmark_shallow_clone_process(env, &process, seL4_MaxPrio, yield_fn, "yield process");
-
-    /* share memory for shared variable */
-    remote_start = vspace_share_mem(&env->vspace, &process.vspace, start, 1, seL4_PageBits,
-                                    seL4_AllRights, 1);
-    assert(remote_start != NULL);
-
-    /* copy ep cap */
-    vka_cspace_make_path(&env->slab_vka, ep, &path);
-    remote_ep = sel4utils_copy_path_to_process(&process, path);
-    assert(remote_ep != seL4_CapNull);
-
-    sel4utils_create_word_args(args_strings, argv, N_YIELD_ARGS, remote_ep, (seL4_Word) remote_start);
-
-    error = benchmark_spawn_process(&process, &env->slab_vka, &env->vspace, N_YIELD_ARGS, argv, 1);
-    assert(error == seL4_NoError);
+    if (kind == HARNESS_RAW) {
+        return harness_raw(process ? results->process_results[i] : results->thread_results[i], N_RUNS);
+    }
 
-    benchmark_yield_ep(ep, results->overhead_ccnt_min, &results->process_yield_ep_sum, &results->process_yield_ep_sum2,
-                       &results->process_yield_ep_num, (volatile ccnt_t *) start);
-    seL4_TCB_Suspend(process.thread.tcb.cptr);
+    assert(kind == HARNESS_SUMS);
+    if (process) {
+        return harness_sums(results->overhead_signal_min, N_RUNS, N_IGNORED, &results->process_results_ep_sum[i],
+                            &results->process_results_ep_sum2[i], &results->process_results_ep_num[i]);
+    }
+    return harness_sums(results->overhead_signal_min, N_RUNS, N_IGNORED, &results->thread_results_ep_sum[i],
+                        &results->thread_results_ep_sum2[i], &results->thread_results_ep_num[i]);
 }
 
-static void benchmark_prio_threads(env_t *env, seL4_CPtr ep, seL4_CPtr produce, seL4_CPtr consume,
-                                   ccnt_t results[N_PRIOS][N_RUNS])
+/*
+ * Slices the samples of each priority are taken in: N_SLICES with ShuffleOrder, so
+ * that the priorities interleave, otherwise all at once. The events are counted in
+ * one round at each priority.
+ */
+static int prio_slices(pmu_results_t *events)
 {
-    sel4utils_thread_t high, low;
-    char high_args_strings[N_HIGH_ARGS][WORD_STRING_SIZE];
-    char *high_argv[N_HIGH_ARGS];
-    char low_args_strings[N_LOW_ARGS][WORD_STRING_SIZE];
-    char *low_argv[N_LOW_ARGS];
-    ccnt_t start;
-    UNUSED int error;
-
-    benchmark_configure_thread(env, ep, seL4_MinPrio, "high", &high);
-    benchmark_configure_thread(env, ep, seL4_MinPrio, "low", &low);
-
-    sel4utils_create_word_args(high_args_strings, high_argv, N_HIGH_ARGS, produce,
-                               ep, (seL4_Word) &start, consume);
-
-    for (int i = 0; i < N_PRIOS; i++) {
-        uint8_t prio = gen_next_prio(i);
-        error = seL4_TCB_SetPriority(high.tcb.cptr, simple_get_tcb(&env->simple), prio);
-        assert(error == seL4_NoError);
-
-        sel4utils_create_word_args(low_args_strings, low_argv, N_LOW_ARGS, produce,
-                                   (seL4_Word) &start, (seL4_Word) &results[i], ep, consume);
-
-        error = sel4utils_start_thread(&low, (sel4utils_thread_entry_fn) low_fn, (void *) N_LOW_ARGS, (void *) low_argv, 1);
-        assert(error == seL4_NoError);
-        error = sel4utils_start_thread(&high, (sel4utils_thread_entry_fn) high_fn, (void *) N_HIGH_ARGS, (void *) high_argv, 1);
-        assert(error == seL4_NoError);
-
-        benchmark_wait_children(ep, "children of scheduler benchmark", 2);
-    }
+    return events == NULL && config_set(CONFIG_SHUFFLE_ORDER) ? N_SLICES : 1;
+}
 
-    seL4_TCB_Suspend(high.tcb.cptr);
-    seL4_TCB_Suspend(low.tcb.cptr);
+/* prio_harness, for the samples of the slice-th of slices only */
+static harness_t prio_slice_harness(harness_kind_t kind, scheduler_results_t *results, bool process, int i,
+                                    int slice, int slices)
+{
+    seL4_Word runs = N_RUNS / slices;
+    return harness_slice(prio_harness(kind, results, process, i), slice * runs, runs);
 }
 
-static void benchmark_prio_threads_ep(env_t *env, seL4_CPtr ep, seL4_CPtr produce, seL4_CPtr consume,
-                                      scheduler_results_t *results)
+/*
+ * Time the switch to a thread of each priority with a harness of kind or, if events is
+ * not NULL, count the events of a round at the i-th priority into events[i]. With
+ * ShuffleOrder, the samples of each priority are taken in slices, going through the
+ * priorities in a new order for each slice (see shuffle.h). Every slice after the
+ * first runs N_IGNORED rounds before it, which are not timed, as the ignored samples
+ * of the first one are dropped.
+ */
+static void benchmark_prio_threads(env_t *env, seL4_CPtr ep, seL4_CPtr produce, seL4_CPtr consume,
+                                   harness_kind_t kind, scheduler_results_t *results, shuffle_t *shuffle,
+                                   pmu_results_t *events)
 {
     sel4utils_thread_t high, low;
     char high_args_strings[N_HIGH_ARGS][WORD_STRING_SIZE];
@@ -301,106 +321,52 @@ static void benchmark_prio_threads_ep(env_t *env, seL4_CPtr ep, seL4_CPtr produc
     char low_args_strings[N_LOW_ARGS][WORD_STRING_SIZE];
     char *low_argv[N_LOW_ARGS];
     ccnt_t start;
+    harness_t harness;
     UNUSED int error;
 
     benchmark_configure_thread(env, ep, seL4_MinPrio, "high", &high);
     benchmark_configure_thread(env, ep, seL4_MinPrio, "low", &low);
 
-    sel4utils_create_word_args(high_args_strings, high_argv, N_HIGH_ARGS, produce,
-                               ep, (seL4_Word) &start, consume);
-
-    for (int i = 0; i < N_PRIOS; i++) {
-        uint8_t prio = gen_next_prio(i);
-        error = seL4_TCB_SetPriority(high.tcb.cptr, simple_get_tcb(&env->simple), prio);
-        assert(error == seL4_NoError);
-
-        sel4utils_create_word_args(low_args_strings, low_argv, N_LOW_ARGS, produce,
-                                   (seL4_Word) &start,
-                                   (seL4_Word) results->overhead_ccnt_min,
-                                   (seL4_Word) &results->thread_results_ep_sum[i],
-                                   (seL4_Word) &results->thread_results_ep_sum2[i],
-                                   (seL4_Word) &results->thread_results_ep_num[i],
-                                   ep, consume);
-
-        error = sel4utils_start_thread(&low, (sel4utils_thread_entry_fn) low_fn_ep, (void *) N_LOW_ARGS, (void *) low_argv, 1);
-        assert(error == seL4_NoError);
-        error = sel4utils_start_thread(&high, (sel4utils_thread_entry_fn) high_fn, (void *) N_HIGH_ARGS, (void *) high_argv, 1);
-        assert(error == seL4_NoError);
-
-        benchmark_wait_children(ep, "children of scheduler benchmark", 2);
+    int slices = prio_slices(events);
+    for (int slice = 0; slice < slices; slice++) {
+        seL4_Word warmups = slice > 0 ? N_IGNORED : 0;
+        sel4utils_create_word_args(high_args_strings, high_argv, N_HIGH_ARGS, produce,
+                                   ep, (seL4_Word) &start, consume, N_RUNS / slices, warmups);
+
+        size_t order[N_PRIOS];
+        shuffle_order(shuffle, N_PRIOS, order);
+        for (int k = 0; k < N_PRIOS; k++) {
+            int i = order[k];
+            uint8_t prio = gen_next_prio(i);
+            error = seL4_TCB_SetPriority(high.tcb.cptr, simple_get_tcb(&env->simple), prio);
+            assert(error == seL4_NoError);
+
+            if (!events) {
+                harness = prio_slice_harness(kind, results, false, i, slice, slices);
+            }
+            sel4utils_create_word_args(low_args_strings, low_argv, N_LOW_ARGS, produce, (seL4_Word) &start,
+                                       events ? (seL4_Word) &events[i] : (seL4_Word) &harness, ep, consume,
+                                       warmups);
+
+            error = sel4utils_start_thread(&low, (sel4utils_thread_entry_fn) (events ? low_events_fn : low_fn),
+                                           (void *) N_LOW_ARGS, (void *) low_argv, 1);
+            assert(error == seL4_NoError);
+            error = sel4utils_start_thread(&high, (sel4utils_thread_entry_fn) (events ? high_events_fn : high_fn),
+                                           (void *) N_HIGH_ARGS, (void *) high_argv, 1);
+            assert(error == seL4_NoError);
+
+            benchmark_wait_children(ep, "children of scheduler benchmark", 2);
+        }
     }
 
     seL4_TCB_Suspend(high.tcb.cptr);
     seL4_TCB_Suspend(low.tcb.cptr);
 }
 
+/* benchmark_prio_threads, with the thread of each priority in a process of its own */
 static void benchmark_prio_processes(env_t *env, seL4_CPtr ep, seL4_CPtr produce, seL4_CPtr consume,
-                                     ccnt_t results[N_PRIOS][N_RUNS])
-{
-    sel4utils_process_t high;
-    sel4utils_thread_t low;
-    char high_args_strings[N_HIGH_ARGS][WORD_STRING_SIZE];
-    char *high_argv[N_HIGH_ARGS];
-    char low_args_strings[N_LOW_ARGS][WORD_STRING_SIZE];
-    char *low_argv[N_LOW_ARGS];
-    void *start, *remote_start;
-    seL4_CPtr remote_ep, remote_produce, remote_consume;
-    UNUSED int error;
-    cspacepath_t path;
-
-    /* allocate a page to share for the start cycle count */
-    start = vspace_new_pages(&env->vspace, seL4_AllRights, 1, seL4_PageBits);
-    assert(start != NULL);
-
-    benchmark_shallow_clone_process(env, &high, seL4_MinPrio, high_fn, "high");
-    /* run low in the same thread as us so we don't have to copy the results across */
-    benchmark_configure_thread(env, ep, seL4_MinPrio, "low", &low);
-
-    /* share memory for shared variable */
-    remote_start = vspace_share_mem(&env->vspace, &high.vspace, start, 1, seL4_PageBits, seL4_AllRights, 1);
-    assert(remote_start != NULL);
-
-    /* copy ep cap */
-    vka_cspace_make_path(&env->slab_vka, ep, &path);
-    remote_ep = sel4utils_copy_path_to_process(&high, path);
-    assert(remote_ep != seL4_CapNull);
-
-    /* copy ntfn cap */
-    vka_cspace_make_path(&env->slab_vka, produce, &path);
-    remote_produce = sel4utils_copy_path_to_process(&high, path);
-    assert(remote_produce != seL4_CapNull);
-
-    /* copy ntfn cap */
-    vka_cspace_make_path(&env->slab_vka, consume, &path);
-    remote_consume = sel4utils_copy_path_to_process(&high, path);
-    assert(remote_consume != seL4_CapNull);
-
-    sel4utils_create_word_args(high_args_strings, high_argv, N_HIGH_ARGS, remote_produce,
-                               remote_ep, (seL4_Word) remote_start, remote_consume);
-
-    for (int i = 0; i < N_PRIOS; i++) {
-        uint8_t prio = gen_next_prio(i);
-        error = seL4_TCB_SetPriority(high.thread.tcb.cptr, simple_get_tcb(&env->simple), prio);
-        assert(error == 0);
-
-        sel4utils_create_word_args(low_args_strings, low_argv, N_LOW_ARGS, produce,
-                                   (seL4_Word) start, (seL4_Word) &results[i], ep, consume);
-
-        error = sel4utils_start_thread(&low, (sel4utils_thread_entry_fn) low_fn, (void *) N_LOW_ARGS, (void *) low_argv, 1);
-        assert(error == seL4_NoError);
-
-        error = benchmark_spawn_process(&high, &env->slab_vka, &env->vspace, N_HIGH_ARGS, high_argv, 1);
-        assert(error == seL4_NoError);
-
-        benchmark_wait_children(ep, "children of scheduler benchmark", 2);
-    }
-
-    seL4_TCB_Suspend(high.thread.tcb.cptr);
-    seL4_TCB_Suspend(low.tcb.cptr);
-}
-
-static void benchmark_prio_processes_ep(env_t *env, seL4_CPtr ep, seL4_CPtr produce, seL4_CPtr consume,
-                                        scheduler_results_t *results)
+                                     harness_kind_t kind, scheduler_results_t *results, shuffle_t *shuffle,
+                                     pmu_results_t *events)
 {
     sel4utils_process_t high;
     sel4utils_thread_t low;
@@ -409,20 +375,22 @@ static void benchmark_prio_processes_ep(env_t *env, seL4_CPtr ep, seL4_CPtr prod
     char low_args_strings[N_LOW_ARGS][WORD_STRING_SIZE];
     char *low_argv[N_LOW_ARGS];
     void *start, *remote_start;
+    size_t page_bits;
     seL4_CPtr remote_ep, remote_produce, remote_consume;
+    harness_t harness;
     UNUSED int error;
     cspacepath_t path;
 
     /* allocate a page to share for the start cycle count */
-    start = vspace_new_pages(&env->vspace, seL4_AllRights, 1, seL4_PageBits);
+    start = shared_mem_alloc(&env->vspace, sizeof(ccnt_t), &page_bits);
     assert(start != NULL);
 
-    benchmark_shallow_clone_process(env, &high, seL4_MinPrio, high_fn, "high");
+    benchmark_shallow_clone_process(env, &high, seL4_MinPrio, events ? high_events_fn : high_fn, "high");
     /* run low in the same thread as us so we don't have to copy the results across */
     benchmark_configure_thread(env, ep, seL4_MinPrio, "low", &low);
 
     /* share memory for shared variable */
-    remote_start = vspace_share_mem(&env->vspace, &high.vspace, start, 1, seL4_PageBits, seL4_AllRights, 1);
+    remote_start = vspace_share_mem(&env->vspace, &high.vspace, start, 1, page_bits, seL4_AllRights, 1);
     assert(remote_start != NULL);
 
     /* copy ep cap */
@@ -440,29 +408,37 @@ static void benchmark_prio_processes_ep(env_t *env, seL4_CPtr ep, seL4_CPtr prod
     remote_consume = sel4utils_copy_path_to_process(&high, path);
     assert(remote_consume != seL4_CapNull);
 
-    sel4utils_create_word_args(high_args_strings, high_argv, N_HIGH_ARGS, remote_produce,
-                               remote_ep, (seL4_Word) remote_start, remote_consume);
-
-    for (int i = 0; i < N_PRIOS; i++) {
-        uint8_t prio = gen_next_prio(i);
-        error = seL4_TCB_SetPriority(high.thread.tcb.cptr, simple_get_tcb(&env->simple), prio);
-        assert(error == 0);
-
-        sel4utils_create_word_args(low_args_strings, low_argv, N_LOW_ARGS, produce,
-                                   (seL4_Word) start,
-                                   (seL4_Word) results->overhead_ccnt_min,
-                                   (seL4_Word) &results->process_results_ep_sum[i],
-                                   (seL4_Word) &results->process_results_ep_sum2[i],
-                                   (seL4_Word) &results->process_results_ep_num[i],
-                                   ep, consume);
+    int slices = prio_slices(events);
+    for (int slice = 0; slice < slices; slice++) {
+        seL4_Word warmups = slice > 0 ? N_IGNORED : 0;
+        sel4utils_create_word_args(high_args_strings, high_argv, N_HIGH_ARGS, remote_produce,
+                                   remote_ep, (seL4_Word) remote_start, remote_consume, N_RUNS / slices, warmups);
+
+        size_t order[N_PRIOS];
+        shuffle_order(shuffle, N_PRIOS, order);
+        for (int k = 0; k < N_PRIOS; k++) {
+            int i = order[k];
+            uint8_t prio = gen_next_prio(i);
+            error = seL4_TCB_SetPriority(high.thread.tcb.cptr, simple_get_tcb(&env->simple), prio);
+            assert(error == 0);
+
+            if (!events) {
+                harness = prio_slice_harness(kind, results, true, i, slice, slices);
+                shared_mem_prefault(start, sizeof(ccnt_t));
+            }
+            sel4utils_create_word_args(low_args_strings, low_argv, N_LOW_ARGS, produce, (seL4_Word) start,
+                                       events ? (seL4_Word) &events[i] : (seL4_Word) &harness, ep, consume,
+                                       warmups);
 
-        error = sel4utils_start_thread(&low, (sel4utils_thread_entry_fn) low_fn_ep, (void *) N_LOW_ARGS, (void *) low_argv, 1);
-        assert(error == seL4_NoError);
+            error = sel4utils_start_thread(&low, (sel4utils_thread_entry_fn) (events ? low_events_fn : low_fn),
+                                           (void *) N_LOW_ARGS, (void *) low_argv, 1);
+            assert(error == seL4_NoError);
 
-        error = benchmark_spawn_process(&high, &env->slab_vka, &env->vspace, N_HIGH_ARGS, high_argv, 1);
-        assert(error == seL4_NoError);
+            error = benchmark_spawn_process(&high, &env->slab_vka, &env->vspace, N_HIGH_ARGS, high_argv, 1);
+            assert(error == seL4_NoError);
 
-        benchmark_wait_children(ep, "children of scheduler benchmark", 2);
+            benchmark_wait_children(ep, "children of scheduler benchmark", 2);
+        }
     }
 
     seL4_TCB_Suspend(high.thread.tcb.cptr);
@@ -492,48 +468,13 @@ void measure_yield_overhead(ccnt_t *results)
 
 void benchmark_set_prio_average(ccnt_t results[N_RUNS][NUM_AVERAGE_EVENTS], seL4_CPtr auth)
 {
-    seL4_Word n_counters = sel4bench_get_num_counters();
-    ccnt_t start = 0;
-    ccnt_t end = 0;
-
-    for (int j = 0; j < N_RUNS; j++) {
-        for (seL4_Word chunk = 0; chunk < sel4bench_get_num_generic_counter_chunks(n_counters); chunk++) {
-            COMPILER_MEMORY_FENCE();
-            counter_bitfield_t mask = sel4bench_enable_generic_counters(chunk, n_counters);
-            SEL4BENCH_READ_CCNT(start);
-            for (int i = 0; i < AVERAGE_RUNS; i++) {
-                /* set prio on self always triggers a reschedule */
-                seL4_TCB_SetPriority(SEL4UTILS_TCB_SLOT, auth, seL4_MaxPrio);
-            }
-            SEL4BENCH_READ_CCNT(end);
-            sel4bench_read_and_stop_counters(mask, chunk, n_counters, results[j]);
-            COMPILER_MEMORY_FENCE();
-            results[j][CYCLE_COUNT_EVENT] = end - start;
-        }
-    }
-
+    /* set prio on self always triggers a reschedule */
+    PMU_CAPTURE(results, N_RUNS, seL4_TCB_SetPriority(SEL4UTILS_TCB_SLOT, auth, seL4_MaxPrio));
 }
 
 void benchmark_yield_average(ccnt_t results[N_RUNS][NUM_AVERAGE_EVENTS])
 {
-    seL4_Word n_counters = sel4bench_get_num_counters();
-    ccnt_t start = 0;
-    ccnt_t end = 0;
-
-    for (int j = 0; j < N_RUNS; j++) {
-        for (seL4_Word chunk = 0; chunk < sel4bench_get_num_generic_counter_chunks(n_counters); chunk++) {
-            COMPILER_MEMORY_FENCE();
-            counter_bitfield_t mask = sel4bench_enable_generic_counters(chunk, n_counters);
-            SEL4BENCH_READ_CCNT(start);
-            for (int i = 0; i < AVERAGE_RUNS; i++) {
-                seL4_Yield();
-            }
-            SEL4BENCH_READ_CCNT(end);
-            sel4bench_read_and_stop_counters(mask, chunk, n_counters, results[j]);
-            COMPILER_MEMORY_FENCE();
-            results[j][CYCLE_COUNT_EVENT] = end - start;
-        }
-    }
+    PMU_CAPTURE(results, N_RUNS, seL4_Yield());
 }
 
 int main(int argc, char **argv)
@@ -571,22 +512,40 @@ int main(int argc, char **argv)
     measure_signal_overhead(produce.cptr, results->overhead_signal);
     measure_yield_overhead(results->overhead_ccnt);
 
-    /* extract the minimum overhead for early processing benchmarks */
-    results->overhead_ccnt_min = getMinOverhead(results->overhead_ccnt, N_RUNS);
-
-    benchmark_prio_threads(env, done_ep.cptr, produce.cptr, consume.cptr,
-                           results->thread_results);
-    benchmark_prio_threads_ep(env, done_ep.cptr, produce.cptr, consume.cptr, results);
-    benchmark_prio_processes(env, done_ep.cptr, produce.cptr, consume.cptr,
-                             results->process_results);
-    benchmark_prio_processes_ep(env, done_ep.cptr, produce.cptr, consume.cptr, results);
+    /* subtract the overheads calibrated by the root task */
+    results->calibration = env->args->calibration;
+    results->overhead_signal_min = results->calibration.overheads[CALIBRATION_SIGNAL].value;
+    results->overhead_ccnt_min = results->calibration.overheads[CALIBRATION_CCNT].value;
+
+    /* each pass over the priorities goes in a random order with ShuffleOrder */
+    shuffle_t shuffle = shuffle_new(env->args->order_seed);
+    benchmark_prio_threads(env, done_ep.cptr, produce.cptr, consume.cptr, HARNESS_RAW, results, &shuffle, NULL);
+    benchmark_prio_threads(env, done_ep.cptr, produce.cptr, consume.cptr, HARNESS_SUMS, results, &shuffle, NULL);
+    benchmark_prio_processes(env, done_ep.cptr, produce.cptr, consume.cptr, HARNESS_RAW, results, &shuffle, NULL);
+    benchmark_prio_processes(env, done_ep.cptr, produce.cptr, consume.cptr, HARNESS_SUMS, results, &shuffle, NULL);
+    if (config_set(CONFIG_PMU_EVENTS)) {
+        benchmark_prio_threads(env, done_ep.cptr, produce.cptr, consume.cptr, HARNESS_RAW, results, &shuffle,
+                               results->thread_events);
+        benchmark_prio_processes(env, done_ep.cptr, produce.cptr, consume.cptr, HARNESS_RAW, results, &shuffle,
+                                 results->process_events);
+    }
     benchmark_set_prio_average(results->set_prio_average, simple_get_tcb(&env->simple));
 
     /* thread yield benchmarks */
-    benchmark_yield_thread(env, done_ep.cptr, results->thread_yield);
-    benchmark_yield_thread_ep(env, done_ep.cptr, results);
-    benchmark_yield_process(env, done_ep.cptr, results->process_yield);
-    benchmark_yield_process_ep(env, done_ep.cptr, results);
+    harness_t harness = harness_raw(results->thread_yield, N_RUNS);
+    benchmark_yield_thread(env, done_ep.cptr, &harness, NULL);
+    harness = harness_sums(results->overhead_ccnt_min, N_RUNS, N_IGNORED, &results->thread_yield_ep_sum,
+                           &results->thread_yield_ep_sum2, &results->thread_yield_ep_num);
+    benchmark_yield_thread(env, done_ep.cptr, &harness, NULL);
+    harness = harness_raw(results->process_yield, N_RUNS);
+    benchmark_yield_process(env, done_ep.cptr, &harness, NULL);
+    harness = harness_sums(results->overhead_ccnt_min, N_RUNS, N_IGNORED, &results->process_yield_ep_sum,
+                           &results->process_yield_ep_sum2, &results->process_yield_ep_num);
+    benchmark_yield_process(env, done_ep.cptr, &harness, NULL);
+    if (config_set(CONFIG_PMU_EVENTS)) {
+        benchmark_yield_thread(env, done_ep.cptr, NULL, &results->thread_yield_events);
+        benchmark_yield_process(env, done_ep.cptr, NULL, &results->process_yield_events);
+    }
     benchmark_yield_average(results->average_yield);
 
     /* done -> results are stored in shared memory so we can now return */
@@ -16,10 +16,13 @@
 #include <smp/gen_config.h>
 #include <sel4benchsync/gen_config.h>
 #include <sel4benchvcpu/gen_config.h>
+#include <sel4benchsupport/gen_config.h>
+#include <benchmark_types.h>
 #include <jansson.h>
 #include <sel4bench/sel4bench.h>
 #include <sel4utils/process.h>
 #include <simple/simple.h>
+#include <sys/types.h>
 #include <vka/vka.h>
 
 typedef struct benchmark {
@@ -27,6 +30,17 @@ typedef struct benchmark {
     char *name;
     /* should we run this benchmark */
     bool enabled;
+    /* does the benchmark loop on benchmark_iteration_done, so that its process
+     * can be kept for all iterations */
+    bool persistent;
+    /* does the benchmark run threads on every core, so that nothing else (e.g.
+     * pipelined processing) may run alongside it */
+    bool all_cores;
+    /* can the benchmark run on any single core, so that PerCoreRuns runs it on
+     * each in turn */
+    bool per_core;
+    /* sweep override from the parameter file, passed on to the benchmark */
+    param_override_t params;
     /* size of data structure required to store results */
     size_t results_pages;
     /*
@@ -36,8 +50,28 @@ typedef struct benchmark {
     json_t *(*process)(void *results);
     /* carry out any extra init for this process */
     void (*init)(vka_t *vka, simple_t *simple, sel4utils_process_t *process);
+    /* size of the sample ring to share with the benchmark, 0 if it does not use one */
+    size_t ring_pages;
+    /*
+     * Consume samples from the sample ring. Called whenever the benchmark asks
+     * for the ring to be drained, and once more when it has finished. Never while an
+     * earlier run of the benchmark is processed, so drain may accumulate the samples
+     * in static state that process then reads and resets.
+     *
+     * @param results the results of the benchmark, as passed to process.
+     * @param stream  the stream the benchmark set for these samples.
+     * @param n       number of samples.
+     * @param samples samples to consume, only valid for the duration of the call.
+     */
+    void (*drain)(void *results, seL4_Word stream, size_t n, ccnt_t samples[n]);
 } benchmark_t;
 
+/* number of percentiles in CONFIG_TAIL_PERCENTILES */
+#define N_TAIL_PERCENTILES (sizeof((double[]) { CONFIG_TAIL_PERCENTILES }) / sizeof(double))
+
+/* the percentiles in CONFIG_TAIL_PERCENTILES */
+extern const double tail_percentiles[N_TAIL_PERCENTILES];
+
 /* generic result type */
 typedef struct {
     double variance;
@@ -49,8 +83,33 @@ typedef struct {
     double median;
     double first_quantile;
     double third_quantile;
+    /* the tail_percentiles percentiles */
+    double tail[N_TAIL_PERCENTILES];
+    /* index of the max sample in raw_data, -1 if not known */
+    ssize_t max_index;
     size_t samples;
     ccnt_t *raw_data;
+    /* half-width of the 95% confidence interval of the mean and median, relative to them */
+    double mean_ci;
+    double median_ci;
+    /* bootstrap 95% confidence intervals of the mean and median, NAN if not computed */
+    double mean_bootstrap_low;
+    double mean_bootstrap_high;
+    double median_bootstrap_low;
+    double median_bootstrap_high;
+    /* samples beyond Tukey's inner fences (1.5 IQR outside the quartiles), but
+     * within the outer fences (3 IQR), and samples beyond the outer fences */
+    size_t mild_outliers;
+    size_t severe_outliers;
+    /* the benchmark sampled adaptively (see adaptive.h), and whether it reached the target
+     * precision before running out of space for samples */
+    bool adaptive;
+    bool converged;
+    /* the warm-up was detected in the samples (WarmupDetection, see results_warmup), the
+     * number of samples dropped as warm-up, and whether they reached a steady state */
+    bool warmup_detected;
+    size_t warmup;
+    bool steady;
 } result_t;
 
 typedef struct {
@@ -80,17 +139,21 @@ typedef struct {
     result_t *results;
     /* number of results in this set */
     int n_results;
+    /* NUM_AVERAGE_EVENTS results for each result, the events counted for it (see pmu.h),
+     * or NULL */
+    result_t *events;
+    /* the results are corrected by an overhead that is not stable (see calibration.h) */
+    bool overhead_estimated;
 } result_set_t;
 
 /* description of how to process a result */
 typedef struct {
-    /* error if result should be stable */
-    bool stable;
     /* name of result */
     const char *name;
     /* overhead to subtract from each result before calculations */
     ccnt_t overhead;
-    /* number of samples to ignore (for cold cache values). */
+    /* number of samples to ignore (for cold cache values). With WarmupDetection, the
+     * detected warm-up is ignored instead */
     int ignored;
 } result_desc_t;
 
@@ -0,0 +1,78 @@
+/*
+ * Copyright 2020, Data61, CSIRO (ABN 41 687 119 230)
+ *
+ * SPDX-License-Identifier: GPL-2.0-only
+ */
+#include <assert.h>
+#include "compact.h"
+
+static const char base64_alphabet[] =
+    "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789+/";
+
+/* only the root task processes results, so a single scratch buffer is enough */
+static uint8_t block_bytes[COMPACT_BLOCK_MAX_BYTES];
+
+static uint32_t crc32(const uint8_t *data, size_t len)
+{
+    uint32_t crc = 0xFFFFFFFFu;
+    for (size_t i = 0; i < len; i++) {
+        crc ^= data[i];
+        for (int bit = 0; bit < 8; bit++) {
+            crc = (crc >> 1) ^ (0xEDB88320u & -(crc & 1));
+        }
+    }
+    return ~crc;
+}
+
+static size_t put_varint(uint8_t *out, uint64_t value)
+{
+    size_t len = 0;
+    while (value >= 0x80) {
+        out[len++] = (uint8_t)(value | 0x80);
+        value >>= 7;
+    }
+    out[len++] = (uint8_t) value;
+    return len;
+}
+
+static void base64_encode(const uint8_t *in, size_t len, char *out)
+{
+    size_t i;
+    for (i = 0; i + 2 < len; i += 3) {
+        uint32_t triple = (in[i] << 16) | (in[i + 1] << 8) | in[i + 2];
+        *out++ = base64_alphabet[(triple >> 18) & 0x3F];
+        *out++ = base64_alphabet[(triple >> 12) & 0x3F];
+        *out++ = base64_alphabet[(triple >> 6) & 0x3F];
+        *out++ = base64_alphabet[triple & 0x3F];
+    }
+    if (i < len) {
+        uint32_t triple = in[i] << 16;
+        if (i + 1 < len) {
+            triple |= in[i + 1] << 8;
+        }
+        *out++ = base64_alphabet[(triple >> 18) & 0x3F];
+        *out++ = base64_alphabet[(triple >> 12) & 0x3F];
+        *out++ = (i + 1 < len) ? base64_alphabet[(triple >> 6) & 0x3F] : '=';
+        *out++ = '=';
+    }
+    *out = '\0';
+}
+
+size_t compact_encode_block(size_t n, const ccnt_t samples[n], char *out, uint32_t *crc)
+{
+    assert(n <= COMPACT_BLOCK_SAMPLES);
+
+    size_t len = 0;
+    uint64_t prev = 0;
+    for (size_t i = 0; i < n; i++) {
+        int64_t delta = (int64_t)((uint64_t) samples[i] - prev);
+        /* zigzag: 0, -1, 1, -2, 2 ... -> 0, 1, 2, 3, 4 ... */
+        uint64_t zigzag = ((uint64_t) delta << 1) ^ (uint64_t)(delta >> 63);
+        len += put_varint(&block_bytes[len], zigzag);
+        prev = samples[i];
+    }
+
+    *crc = crc32(block_bytes, len);
+    base64_encode(block_bytes, len, out);
+    return len;
+}
@@ -0,0 +1,43 @@
+/*
+ * Copyright 2020, Data61, CSIRO (ABN 41 687 119 230)
+ *
+ * SPDX-License-Identifier: GPL-2.0-only
+ */
+
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+#include <sel4bench/sel4bench.h>
+
+/*
+ * Compact encoding of raw samples, used instead of one JSON integer per sample
+ * when CONFIG_RAW_RESULTS_COMPACT is set. tools/decode_results.py turns it back
+ * into the usual "Raw results" array.
+ *
+ * Samples are split into blocks of at most COMPACT_BLOCK_SAMPLES. Within a block,
+ * each sample is stored as the difference to the previous one (the first one as
+ * the difference to 0), zigzag encoded so that small negative deltas stay small,
+ * and written out as an unsigned LEB128 varint. The resulting bytes are base64
+ * encoded, and a CRC-32 (as used by zlib) of the unencoded bytes is kept so that
+ * corruption on the serial line can be detected. Blocks do not depend on each
+ * other, so a corrupted block only loses the samples within it.
+ */
+#define COMPACT_ENCODING_NAME "delta-zigzag-leb128-base64"
+#define COMPACT_BLOCK_SAMPLES 1024
+/* a 64 bit value takes at most 10 bytes as a varint */
+#define COMPACT_BLOCK_MAX_BYTES (COMPACT_BLOCK_SAMPLES * 10)
+/* base64 expands every 3 bytes to 4 characters, plus a NUL terminator */
+#define COMPACT_BLOCK_MAX_CHARS (((COMPACT_BLOCK_MAX_BYTES + 2) / 3) * 4 + 1)
+
+/*
+ * Encode a single block of samples.
+ *
+ * @param n       number of samples, at most COMPACT_BLOCK_SAMPLES.
+ * @param samples samples to encode.
+ * @param out     buffer of at least COMPACT_BLOCK_MAX_CHARS, receives the NUL
+ *                terminated base64 string.
+ * @param crc     receives the CRC-32 of the encoded bytes.
+ * @return the number of bytes encoded (before base64).
+ */
+size_t compact_encode_block(size_t n, const ccnt_t samples[n], char *out, uint32_t *crc);
@@ -14,6 +14,7 @@
 #include <vka/object.h>
 #include <vspace/vspace.h>
 #include <utils/util.h>
+#include <sel4benchapp/gen_config.h>
 
 /* Contains information about the benchmark environment. */
 typedef struct env {
@@ -22,7 +23,8 @@ typedef struct env {
     simple_t simple;
     vspace_t vspace;
     /* regular untyped memory to pass to benchmark apps */
-    vka_object_t untyped;
+    size_t n_untypeds;
+    vka_object_t untypeds[CONFIG_CHILD_UNTYPEDS];
     timer_objects_t to;
     ps_io_ops_t ops;
 } env_t;
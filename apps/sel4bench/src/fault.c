@@ -13,14 +13,17 @@
 static json_t *fault_process(void *results)
 {
     fault_results_t *raw_results = results;
+    const calibration_t *calibration = &raw_results->calibration;
+    ZF_LOGF_IF(!calibration->valid, "fault benchmark did not record its overheads");
+    const overhead_t *reply_recv = &calibration->overheads[CALIBRATION_REPLY_RECV_1];
+    const overhead_t *ccnt = &calibration->overheads[CALIBRATION_CCNT];
 
     result_desc_t desc = {
-        .stable = true,
         .name = "fault overhead",
         .ignored = N_IGNORED
     };
 
-    /* calculate overhead of reply_recv */
+    /* overhead of reply_recv the benchmark measured itself, for reference */
     result_t result = process_result(N_RUNS, raw_results->reply_recv_overhead, desc);
 
     result_set_t set = {
@@ -33,12 +36,18 @@ static json_t *fault_process(void *results)
     json_t *array = json_array();
     json_array_append_new(array, result_set_to_json(set));
 
-    desc.stable = false;
-    desc.overhead = result.min;
+    desc.overhead = reply_recv->value;
+    set.overhead_estimated = !reply_recv->stable;
 
     set.name = "fault round trip";
     result = process_result(N_RUNS, raw_results->round_trip, desc);
+    result_t events[NUM_AVERAGE_EVENTS];
+    if (config_set(CONFIG_PMU_EVENTS)) {
+        process_average_results(PMU_ROTATIONS, NUM_AVERAGE_EVENTS, raw_results->round_trip_events.counts, events);
+        set.events = events;
+    }
     json_array_append_new(array, result_set_to_json(set));
+    set.events = NULL;
 
     set.name = "fault round trip (early processing)";
     result = process_result_early_proc(raw_results->round_trip_ep_num, raw_results->round_trip_ep_sum,
@@ -54,19 +63,19 @@ static json_t *fault_process(void *results)
                                        raw_results->fault_ep_sum2);
     json_array_append_new(array, result_set_to_json(set));
 
-    /* calculate the overhead of reading the cycle count (fault handler -> faulter path
+    /* the overhead of reading the cycle count (fault handler -> faulter path
      * does not include a call to seL4_ReplyRecv_ */
 
     set.name = "read ccnt overhead";
-    desc.stable = true;
+    set.overhead_estimated = false;
     desc.overhead = 0;
     result = process_result(N_RUNS, raw_results->ccnt_overhead, desc);
     json_array_append_new(array, result_set_to_json(set));
 
     /* fault to fault handler does not */
     set.name = "fault handler -> faulter";
-    desc.stable = false;
-    desc.overhead = result.min;
+    desc.overhead = ccnt->value;
+    set.overhead_estimated = !ccnt->stable;
     result = process_result(N_RUNS, raw_results->fault_reply, desc);
     json_array_append_new(array, result_set_to_json(set));
 
@@ -82,6 +91,8 @@ static json_t *fault_process(void *results)
 static benchmark_t fault_benchmark = {
     .name = "fault",
     .enabled = config_set(CONFIG_APP_FAULTBENCH),
+    .persistent = true,
+    .per_core = true,
     .results_pages = BYTES_TO_SIZE_BITS_PAGES(sizeof(fault_results_t), seL4_PageBits),
     .process = fault_process,
     .init = blank_init
@@ -10,40 +10,77 @@
 #include <hardware.h>
 #include <stdio.h>
 
+/* null syscall samples received through the sample ring. The pipeline is flushed
+ * before a benchmark with a ring runs, so the worker is done with the last run's */
+static result_accumulator_t ring_nullsyscall;
+
+static void hardware_drain(void *results, seL4_Word stream, size_t n, ccnt_t samples[n])
+{
+    ZF_LOGF_IF(stream != HARDWARE_RING_NULLSYSCALL, "Unknown sample stream %lu", (unsigned long) stream);
+    result_accumulate(&ring_nullsyscall, n, samples);
+}
+
 static json_t *hardware_process(void *results)
 {
     hardware_results_t *raw_results = results;
+    ZF_LOGF_IF(!raw_results->calibration.valid, "hardware benchmark did not record its overheads");
+    const overhead_t *overhead = &raw_results->calibration.overheads[CALIBRATION_NULLSYSCALL];
 
     result_desc_t desc = {
-        .stable = false,
         .name = "Nop syscall overhead",
         .ignored = N_IGNORED
     };
 
+    /* the overhead the benchmark measured itself, for reference */
     result_t nopnulsyscall_result = process_result(N_RUNS, raw_results->nullSyscall_overhead, desc);
 
     /* Execlude ccnt, user-level and loop overheads */
-    desc.overhead = nopnulsyscall_result.min;
+    desc.overhead = overhead->value;
 
-    result_t result = process_result(N_RUNS, raw_results->nullSyscall_results, desc);
+    result_t result = process_result(raw_results->nullSyscall_runs, raw_results->nullSyscall_results, desc);
+    result.adaptive = config_set(CONFIG_ADAPTIVE_SAMPLING);
+    result.converged = raw_results->nullSyscall_converged;
 
     result_set_t set = {
         .name = "Hardware null_syscall thread",
         .n_results = 1,
         .n_extra_cols = 0,
-        .results = &result
+        .results = &result,
+        .overhead_estimated = !overhead->stable
     };
 
+    result_t events[NUM_AVERAGE_EVENTS];
+    if (config_set(CONFIG_PMU_EVENTS)) {
+        process_average_results(PMU_ROTATIONS, NUM_AVERAGE_EVENTS, raw_results->nullSyscall_events.counts, events);
+        set.events = events;
+    }
+
     json_t *array = json_array();
     json_array_append_new(array, result_set_to_json(set));
+    set.events = NULL;
 
     set.name = "Hardware null_syscall thread (early processing)";
     result = process_result_early_proc(raw_results->nullSyscall_ep_num, raw_results->nullSyscall_ep_sum,
                                        raw_results->nullSyscall_ep_sum2);
     json_array_append_new(array, result_set_to_json(set));
 
+    set.name = "Hardware null_syscall thread (histogram)";
+    result = process_result_histogram(&raw_results->nullSyscall_histogram);
+    json_array_append_new(array, result_set_to_json(set));
+
+    if (CONFIG_HARDWARE_RING_SAMPLES > 0) {
+        set.name = "Hardware null_syscall thread (sample ring)";
+        result = process_result_accumulated(&ring_nullsyscall, desc.overhead);
+        json_array_append_new(array, result_set_to_json(set));
+        /* start afresh for the next iteration */
+        ring_nullsyscall = (result_accumulator_t) {
+            0
+        };
+    }
+
     set.name = "Nop syscall overhead";
     set.results = &nopnulsyscall_result;
+    set.overhead_estimated = false;
     json_array_append_new(array, result_set_to_json(set));
 
     return array;
@@ -52,9 +89,13 @@ static json_t *hardware_process(void *results)
 static benchmark_t hardware_benchmark = {
     .name = "hardware",
     .enabled = config_set(CONFIG_APP_HARDWAREBENCH),
+    .persistent = true,
+    .per_core = true,
     .results_pages = BYTES_TO_SIZE_BITS_PAGES(sizeof(hardware_results_t), seL4_PageBits),
     .process = hardware_process,
-    .init = blank_init
+    .init = blank_init,
+    .ring_pages = CONFIG_HARDWARE_RING_SAMPLES > 0 ? HARDWARE_RING_PAGES : 0,
+    .drain = hardware_drain
 };
 
 benchmark_t *hardware_benchmark_new(void)
@@ -7,6 +7,7 @@
 #include <ipc.h>
 #include <jansson.h>
 #include <sel4bench/sel4bench.h>
+#include <stdlib.h>
 #include <utils/util.h>
 
 #include "benchmark.h"
@@ -18,68 +19,24 @@
 static json_t *process_ipc_results(void *r)
 {
     ipc_results_t *raw_results = r;
-    ccnt_t overheads[NUM_OVERHEAD_BENCHMARKS];
+    const calibration_t *calibration = &raw_results->calibration;
+    ZF_LOGF_IF(!calibration->valid, "ipc benchmark did not record its overheads");
 
-    /* check overheads */
-    for (int i = 0; i < NUM_OVERHEAD_BENCHMARKS; i++) {
-        if (!results_stable(&raw_results->overhead_benchmarks[i][1], RUNS - 1)) {
-            if (!config_set(CONFIG_ALLOW_UNSTABLE_OVERHEAD)) {
-                printf("Benchmarking overhead of a %s is not stable! Cannot continue\n",
-                       overhead_benchmark_params[i].name);
-                print_all(RUNS, raw_results->overhead_benchmarks[i]);
-                return NULL;
-            }
-        }
-        result_desc_t desc = {
-            .stable = false,
-            .name = "overhead",
-            .ignored = 0,
-            .overhead = 0
-        };
-        result_t overhead_result;
-        overhead_result = process_result(RUNS - 1, raw_results->overhead_benchmarks[i], desc);
-        overheads[i] = overhead_result.min;
-    }
-
-    int n = ARRAY_SIZE(benchmark_params);
-    char *functions[n];
+    int n = raw_results->n_benchmarks;
+    size_t points[n];
     char *directions[n];
-    json_int_t client_prios[n];
-    json_int_t server_prios[n];
-    bool same_vspace[n];
-    json_int_t length[n];
+    for (int i = 0; i < n; i++) {
+        points[i] = raw_results->benchmarks[i].point;
+    }
 
-    column_t extra_cols[] = {
-        {
-            .header = "Function",
-            .type = JSON_STRING,
-            .string_array = &functions[0]
-        },
-        {
-            .header = "Direction",
-            .type = JSON_STRING,
-            .string_array = &directions[0],
-        },
-        {
-            .header = "Client Prio",
-            .type = JSON_INTEGER,
-            .integer_array = &client_prios[0]
-        },
-        {
-            .header = "Server Prio",
-            .type = JSON_INTEGER,
-            .integer_array = &server_prios[0]
-        },
-        {
-            .header = "Same vspace?",
-            .type = JSON_TRUE,
-            .bool_array = &same_vspace[0]
-        },
-        {
-            .header = "IPC length",
-            .type = JSON_INTEGER,
-            .integer_array = &length[0]
-        }
+    /* a column for each axis of the sweep, and the direction, which follows from the function */
+    column_t extra_cols[IPC_N_AXES + 1];
+    sweep_cell_t cells[n * IPC_N_AXES];
+    sweep_to_columns(&ipc_sweep, n, points, extra_cols, cells);
+    extra_cols[IPC_N_AXES] = (column_t) {
+        .header = "Direction",
+        .type = JSON_STRING,
+        .string_array = &directions[0],
     };
 
     result_t results[n];
@@ -94,36 +51,51 @@ static json_t *process_ipc_results(void *r)
 
     /* now calculate the results */
     for (int i = 0; i < n; i++) {
+        ipc_benchmark_results_t *benchmark = &raw_results->benchmarks[i];
+        const benchmark_params_t params = ipc_benchmark_params(benchmark->point);
         result_desc_t desc = {
-            .name = benchmark_params[i].name,
-            .overhead = overheads[benchmark_params[i].overhead_id],
+            .name = params.name,
+            .overhead = calibration->overheads[params.overhead_id].value,
         };
+        /* some results are corrected by the minimum of unstable overhead samples */
+        result_set.overhead_estimated = result_set.overhead_estimated ||
+                                        !calibration->overheads[params.overhead_id].stable;
 
-        functions[i] = (char *) benchmark_params[i].name;
-        directions[i] = benchmark_params[i].direction == DIR_TO ? "client->server" :
+        directions[i] = params.direction == DIR_TO ? "client->server" :
                         "server->client";
-        client_prios[i] = benchmark_params[i].client_prio;
-        server_prios[i] = benchmark_params[i].server_prio;
-        same_vspace[i] = benchmark_params[i].same_vspace;
-        length[i] = benchmark_params[i].length;
 
-        results[i] = process_result(RUNS, raw_results->benchmarks[i], desc);
+        results[i] = process_result(benchmark->runs, benchmark->samples, desc);
+        results[i].adaptive = config_set(CONFIG_ADAPTIVE_SAMPLING);
+        results[i].converged = benchmark->converged;
+    }
+
+#ifdef CONFIG_PMU_EVENTS
+    result_set.events = malloc(n * NUM_AVERAGE_EVENTS * sizeof(result_t));
+    ZF_LOGF_IF(result_set.events == NULL, "Failed to allocate events");
+    for (int i = 0; i < n; i++) {
+        process_average_results(PMU_ROTATIONS, NUM_AVERAGE_EVENTS, raw_results->benchmarks[i].events.counts,
+                                &result_set.events[i * NUM_AVERAGE_EVENTS]);
     }
+#endif
 
     json_t *array = json_array();
     json_array_append_new(array, result_set_to_json(result_set));
+    free(result_set.events);
     return array;
 }
 
 static benchmark_t ipc_benchmark = {
     .name = "ipc",
     .enabled = config_set(CONFIG_APP_IPCBENCH),
-    .results_pages = BYTES_TO_SIZE_BITS_PAGES(sizeof(ipc_results_t), seL4_PageBits),
+    .persistent = true,
+    .per_core = true,
     .process = process_ipc_results,
     .init = blank_init
 };
 
 benchmark_t *ipc_benchmark_new(void)
 {
+    /* the size of the sweep is only known at run time */
+    ipc_benchmark.results_pages = BYTES_TO_SIZE_BITS_PAGES(IPC_RESULTS_SIZE, seL4_PageBits);
     return &ipc_benchmark;
 }
@@ -0,0 +1,353 @@
+/*
+ * Copyright 2020, Data61, CSIRO (ABN 41 687 119 230)
+ *
+ * SPDX-License-Identifier: GPL-2.0-only
+ */
+
+#include <autoconf.h>
+#include <sel4benchapp/gen_config.h>
+#include <assert.h>
+#include <math.h>
+#include <stdlib.h>
+#include <string.h>
+#include <utils/util.h>
+
+#include "iterations.h"
+#include "math.h"
+#include "processing.h"
+
+/* what is kept of a result in one run */
+typedef struct {
+    size_t samples;
+    double mean;
+    double variance;
+    double median;
+    bool has_median;
+    /* mean of the raw samples, not rounded, and the bootstrap 95% confidence interval
+     * around it, NAN if not known */
+    double raw_mean;
+    double mean_bootstrap_low;
+    double mean_bootstrap_high;
+    ccnt_t min;
+    ccnt_t max;
+    bool adaptive;
+    bool converged;
+    bool warmup_detected;
+    size_t warmup;
+    bool steady;
+} run_summary_t;
+
+/* what is kept of a row of a result set over the runs */
+typedef struct {
+    run_summary_t runs[CONFIG_ITERATIONS];
+    /* the raw data of every run so far one after the other, NULL once a run had none */
+    ccnt_t *raw_data;
+    size_t n_raw;
+} row_runs_t;
+
+typedef struct {
+    int n_rows;
+    row_runs_t *rows;
+} set_runs_t;
+
+static struct {
+    /* run being processed */
+    int run;
+    /* index of the next result set of the run */
+    size_t next_set;
+    /* result sets of the benchmark, as output by its first run */
+    size_t n_sets;
+    set_runs_t *sets;
+} iterations;
+
+/* free all the sets kept */
+static void iterations_reset(void)
+{
+    for (size_t s = 0; s < iterations.n_sets; s++) {
+        for (int r = 0; r < iterations.sets[s].n_rows; r++) {
+            free(iterations.sets[s].rows[r].raw_data);
+        }
+        free(iterations.sets[s].rows);
+    }
+    free(iterations.sets);
+    iterations.sets = NULL;
+    iterations.n_sets = 0;
+}
+
+bool iterations_merging(void)
+{
+    return config_set(CONFIG_MERGE_ITERATIONS) && CONFIG_ITERATIONS > 1;
+}
+
+void iterations_begin(int run)
+{
+    if (run == 0) {
+        /* a new benchmark */
+        iterations_reset();
+    }
+    iterations.run = run;
+    iterations.next_set = 0;
+}
+
+bool iterations_last_run(void)
+{
+    return iterations.run == CONFIG_ITERATIONS - 1;
+}
+
+/* copy the raw data of a run after that of the previous runs */
+static void row_add_raw_data(row_runs_t *row, const result_t *result)
+{
+    if (iterations.run > 0 && row->raw_data == NULL) {
+        /* an earlier run had none */
+        return;
+    }
+
+    if (result->raw_data == NULL || result->samples == 0) {
+        free(row->raw_data);
+        row->raw_data = NULL;
+        return;
+    }
+
+    ccnt_t *raw_data = realloc(row->raw_data, (row->n_raw + result->samples) * sizeof(ccnt_t));
+    if (raw_data == NULL) {
+        /* not enough memory to keep them all, the row is merged from summaries */
+        free(row->raw_data);
+        row->raw_data = NULL;
+        return;
+    }
+    memcpy(&raw_data[row->n_raw], result->raw_data, result->samples * sizeof(ccnt_t));
+    row->raw_data = raw_data;
+    row->n_raw += result->samples;
+}
+
+static double raw_mean(const result_t *result)
+{
+    if (result->raw_data == NULL || result->samples == 0) {
+        return NAN;
+    }
+    long double total = 0;
+    for (size_t i = 0; i < result->samples; i++) {
+        total += result->raw_data[i];
+    }
+    return total / result->samples;
+}
+
+void iterations_add(const result_set_t *set)
+{
+    if (iterations.run == 0) {
+        set_runs_t *sets = realloc(iterations.sets, (iterations.n_sets + 1) * sizeof(set_runs_t));
+        ZF_LOGF_IF(sets == NULL, "Failed to keep results of %s", set->name);
+        iterations.sets = sets;
+        iterations.sets[iterations.n_sets] = (set_runs_t) {
+            .n_rows = set->n_results,
+            .rows = calloc(set->n_results, sizeof(row_runs_t)),
+        };
+        ZF_LOGF_IF(set->n_results > 0 && iterations.sets[iterations.n_sets].rows == NULL,
+                   "Failed to keep results of %s", set->name);
+        iterations.n_sets++;
+    }
+
+    ZF_LOGF_IF(iterations.next_set >= iterations.n_sets, "%s: run %d has more result sets than run 0",
+               set->name, iterations.run);
+    set_runs_t *runs = &iterations.sets[iterations.next_set];
+    ZF_LOGF_IF(runs->n_rows != set->n_results, "%s: run %d has %d results, run 0 had %d",
+               set->name, iterations.run, set->n_results, runs->n_rows);
+    iterations.next_set++;
+
+    for (int i = 0; i < set->n_results; i++) {
+        const result_t *result = &set->results[i];
+        row_runs_t *row = &runs->rows[i];
+        row->runs[iterations.run] = (run_summary_t) {
+            .samples = result->samples,
+            .mean = result->mean,
+            .variance = result->variance,
+            .median = result->median,
+            /* results without order statistics have no median CI */
+            .has_median = result->raw_data != NULL || !isnan(result->median_ci),
+            .raw_mean = raw_mean(result),
+            .mean_bootstrap_low = result->mean_bootstrap_low,
+            .mean_bootstrap_high = result->mean_bootstrap_high,
+            .min = result->min,
+            .max = result->max,
+            .adaptive = result->adaptive,
+            .converged = result->converged,
+            .warmup_detected = result->warmup_detected,
+            .warmup = result->warmup,
+            .steady = result->steady,
+        };
+        row_add_raw_data(row, result);
+    }
+}
+
+/* pooled results from the summaries of the runs, when not all of them have raw data */
+static result_t merge_summaries(const row_runs_t *row, const run_statistics_t *stats, size_t total)
+{
+    result_t result = results_empty();
+
+    if (total == 0) {
+        return result;
+    }
+
+    double mean = 0;
+    for (size_t r = 0; r < stats->runs; r++) {
+        mean += row->runs[r].mean * row->runs[r].samples;
+    }
+    mean /= total;
+
+    /* the total sum of squares is the sum of those within and between the runs */
+    double ss = 0;
+    result.min = row->runs[0].min;
+    result.max = row->runs[0].max;
+    for (size_t r = 0; r < stats->runs; r++) {
+        const run_summary_t *run = &row->runs[r];
+        ss += run->samples * (run->variance + (run->mean - mean) * (run->mean - mean));
+        result.min = MIN(result.min, run->min);
+        result.max = MAX(result.max, run->max);
+    }
+
+    result.samples = total;
+    result.mean = mean;
+    result.variance = ss / total;
+    result.stddev = total > 1 ? sqrt(ss / (total - 1)) : 0;
+    result.mean_ci = results_mean_ci(total, result.mean, result.stddev);
+    /* the median, percentiles and worst sample stay unknown without the samples */
+
+    return result;
+}
+
+/*
+ * Bootstrap interval of the pooled mean from those of the runs, as if the samples of
+ * each run were resampled on their own (stratified bootstrap) rather than resampling
+ * all samples again. The pooled mean is the mean of the runs' means weighted by their
+ * samples, so its spread either side of it is that of the runs' means, weighted the
+ * same way and added in quadrature. The median has no such combination, so its
+ * bootstrap is not known.
+ */
+static void merge_mean_bootstrap(const row_runs_t *row, size_t runs, size_t total, result_t *result)
+{
+    double mean = 0;
+    double low = 0;
+    double high = 0;
+    for (size_t r = 0; r < runs; r++) {
+        const run_summary_t *run = &row->runs[r];
+        if (isnan(run->raw_mean) || isnan(run->mean_bootstrap_low)) {
+            return;
+        }
+        double weight = (double) run->samples / total;
+        double below = run->raw_mean - run->mean_bootstrap_low;
+        double above = run->mean_bootstrap_high - run->raw_mean;
+        mean += weight * run->raw_mean;
+        low += weight * weight * below * below;
+        high += weight * weight * above * above;
+    }
+    result->mean_bootstrap_low = mean - sqrt(low);
+    result->mean_bootstrap_high = mean + sqrt(high);
+}
+
+/* one way analysis of variance of the runs of a row, see run_statistics_t */
+static run_statistics_t run_statistics(const row_runs_t *row, size_t *total)
+{
+    run_statistics_t stats = {
+        .runs = CONFIG_ITERATIONS,
+        .has_medians = true,
+    };
+
+    size_t n = 0;
+    double sum_squared_n = 0;
+    double mean = 0;
+    for (size_t r = 0; r < stats.runs; r++) {
+        const run_summary_t *run = &row->runs[r];
+        n += run->samples;
+        sum_squared_n += (double) run->samples * run->samples;
+        mean += run->mean * run->samples;
+        stats.means[r] = run->mean;
+        stats.medians[r] = run->median;
+        stats.has_medians = stats.has_medians && run->has_median;
+    }
+    *total = n;
+    mean = n > 0 ? mean / n : 0;
+
+    double ss_within = 0;
+    double ss_between = 0;
+    for (size_t r = 0; r < stats.runs; r++) {
+        const run_summary_t *run = &row->runs[r];
+        ss_within += run->samples * run->variance;
+        ss_between += run->samples * (run->mean - mean) * (run->mean - mean);
+    }
+
+    size_t k = stats.runs;
+    double ms_within = n > k ? ss_within / (n - k) : NAN;
+    double ms_between = ss_between / (k - 1);
+    /* the number of samples per run, adjusted for runs of different sizes */
+    double n0 = n > 0 ? (n - sum_squared_n / n) / (k - 1) : 0;
+
+    stats.within_variance = ms_within;
+    stats.between_variance = n0 > 0 ? MAX(0, (ms_between - ms_within) / n0) : NAN;
+    stats.between_fraction = stats.between_variance / (stats.between_variance + stats.within_variance);
+
+    if (stats.has_medians) {
+        double median_mean = 0;
+        stats.median_min = stats.medians[0];
+        stats.median_max = stats.medians[0];
+        for (size_t r = 0; r < k; r++) {
+            median_mean += stats.medians[r];
+            stats.median_min = MIN(stats.median_min, stats.medians[r]);
+            stats.median_max = MAX(stats.median_max, stats.medians[r]);
+        }
+        median_mean /= k;
+
+        double ss_medians = 0;
+        for (size_t r = 0; r < k; r++) {
+            ss_medians += (stats.medians[r] - median_mean) * (stats.medians[r] - median_mean);
+        }
+        stats.median_stddev = sqrt(ss_medians / (k - 1));
+    }
+
+    return stats;
+}
+
+void iterations_merge(size_t n, result_t pooled[n], run_statistics_t stats[n])
+{
+    assert(iterations_last_run() && iterations.next_set > 0);
+    set_runs_t *runs = &iterations.sets[iterations.next_set - 1];
+    assert(runs->n_rows == n);
+
+    for (size_t i = 0; i < n; i++) {
+        row_runs_t *row = &runs->rows[i];
+        size_t total;
+        stats[i] = run_statistics(row, &total);
+
+        stats[i].from_summaries = row->raw_data == NULL;
+        if (row->raw_data != NULL) {
+            /* the overhead and warm-up were taken off each run's samples already */
+            pooled[i] = process_result_pooled(row->n_raw, row->raw_data);
+            merge_mean_bootstrap(row, stats[i].runs, total, &pooled[i]);
+        } else {
+            pooled[i] = merge_summaries(row, &stats[i], total);
+        }
+
+        pooled[i].adaptive = false;
+        pooled[i].converged = true;
+        /* the warm-up dropped from all runs, and whether every run settled */
+        pooled[i].warmup_detected = false;
+        pooled[i].warmup = 0;
+        pooled[i].steady = true;
+        for (size_t r = 0; r < stats[i].runs; r++) {
+            pooled[i].adaptive = pooled[i].adaptive || row->runs[r].adaptive;
+            pooled[i].converged = pooled[i].converged && row->runs[r].converged;
+            pooled[i].warmup_detected = pooled[i].warmup_detected || row->runs[r].warmup_detected;
+            pooled[i].warmup += row->runs[r].warmup;
+            pooled[i].steady = pooled[i].steady && row->runs[r].steady;
+        }
+    }
+}
+
+void iterations_release(void)
+{
+    assert(iterations.next_set > 0);
+    set_runs_t *runs = &iterations.sets[iterations.next_set - 1];
+    for (int i = 0; i < runs->n_rows; i++) {
+        free(runs->rows[i].raw_data);
+        runs->rows[i].raw_data = NULL;
+    }
+}
@@ -0,0 +1,77 @@
+/*
+ * Copyright 2020, Data61, CSIRO (ABN 41 687 119 230)
+ *
+ * SPDX-License-Identifier: GPL-2.0-only
+ */
+
+#pragma once
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <sel4benchapp/gen_config.h>
+
+#include "benchmark.h"
+
+/*
+ * Merging the ITERATIONS runs of a benchmark (see MergeIterations).
+ *
+ * The results of each run are kept, row by row, until the last run, which outputs
+ * a single row for each of them. A row of the n-th result set a run outputs is
+ * assumed to measure the same thing as the same row of the n-th set of the other
+ * runs. The merged row has the statistics of the samples of all runs pooled, and
+ * the statistics of the runs in run_statistics_t.
+ *
+ * Only result_set_to_json (see json.c) needs this, main marks the start of each run
+ * with iterations_begin.
+ */
+
+typedef struct {
+    /* number of runs merged */
+    size_t runs;
+    /* variance of the samples around the mean of their run (one way ANOVA mean squares) */
+    double within_variance;
+    /* variance of the true means of the runs, the mean squares estimate, at least 0 */
+    double between_variance;
+    /* share of between_variance in the total (intraclass correlation), NAN if both are 0 */
+    double between_fraction;
+    /* mean and, if known, median of each run */
+    double means[CONFIG_ITERATIONS];
+    double medians[CONFIG_ITERATIONS];
+    /* are the medians known, i.e. did every run have order statistics */
+    bool has_medians;
+    /* spread of the medians of the runs */
+    double median_min;
+    double median_max;
+    double median_stddev;
+    /* merged from the summaries of the runs, as not all of their raw samples were kept */
+    bool from_summaries;
+} run_statistics_t;
+
+/* Are runs being merged, i.e. is MergeIterations set and ITERATIONS greater than 1? */
+bool iterations_merging(void);
+
+/* Mark the start of the processing of run run of a benchmark */
+void iterations_begin(int run);
+
+/* Is the run being processed the last one, whose output has the merged results? */
+bool iterations_last_run(void);
+
+/*
+ * Keep the results of a result set of the run being processed. Any raw data is
+ * copied, so need not outlive the call.
+ */
+void iterations_add(const result_set_t *set);
+
+/*
+ * Merge the results of the last set added with those of the same set in the
+ * previous runs. Call in the last run only.
+ *
+ * @param n      number of results in the set.
+ * @param pooled the results of the samples of all runs, which may point to raw data
+ *               kept until iterations_release.
+ * @param stats  statistics of the runs of each result.
+ */
+void iterations_merge(size_t n, result_t pooled[n], run_statistics_t stats[n]);
+
+/* Free what is kept of the last set added, once its merged results have been output */
+void iterations_release(void);
@@ -6,6 +6,10 @@
 #include <autoconf.h>
 #include <benchmark.h>
 #include <math.h>
+#include <stdio.h>
+#include <utils/util.h>
+#include "compact.h"
+#include "iterations.h"
 #include "json.h"
 
 static inline double round_to_3_decimal_places(double val)
@@ -22,6 +26,50 @@ static inline json_t *json_real_check(double val)
     return real;
 }
 
+static json_t *raw_results_to_compact_json(size_t n, ccnt_t *data)
+{
+    static char encoded[COMPACT_BLOCK_MAX_CHARS];
+    UNUSED int error;
+
+    json_t *object = json_object();
+    assert(object != NULL);
+
+    error = json_object_set_new(object, "Encoding", json_string(COMPACT_ENCODING_NAME));
+    assert(error == 0);
+
+    error = json_object_set_new(object, "Samples", json_integer(n));
+    assert(error == 0);
+
+    json_t *blocks = json_array();
+    assert(blocks != NULL);
+
+    for (size_t start = 0; start < n; start += COMPACT_BLOCK_SAMPLES) {
+        size_t count = MIN(n - start, COMPACT_BLOCK_SAMPLES);
+        uint32_t crc;
+        compact_encode_block(count, &data[start], encoded, &crc);
+
+        json_t *block = json_object();
+        assert(block != NULL);
+
+        error = json_object_set_new(block, "Samples", json_integer(count));
+        assert(error == 0);
+
+        error = json_object_set_new(block, "CRC32", json_integer(crc));
+        assert(error == 0);
+
+        error = json_object_set_new(block, "Data", json_string(encoded));
+        assert(error == 0);
+
+        error = json_array_append_new(blocks, block);
+        assert(error == 0);
+    }
+
+    error = json_object_set_new(object, "Blocks", blocks);
+    assert(error == 0);
+
+    return object;
+}
+
 static void result_to_json(result_t result, json_t *j)
 {
     UNUSED int error = json_object_set_new(j, "Min", json_integer(result.min));
@@ -51,19 +99,77 @@ static void result_to_json(result_t result, json_t *j)
     error = json_object_set_new(j, "3rd quantile", json_real_check(result.third_quantile));
     assert(error == 0);
 
+    for (size_t i = 0; i < N_TAIL_PERCENTILES; i++) {
+        char key[32];
+        snprintf(key, sizeof(key), "p%g", tail_percentiles[i]);
+        error = json_object_set_new(j, key, json_real_check(result.tail[i]));
+        assert(error == 0);
+    }
+
+    if (result.max_index >= 0 && result.samples > 0) {
+        error = json_object_set_new(j, "Max index", json_integer(result.max_index));
+        assert(error == 0);
+    }
+
     error = json_object_set_new(j, "Samples", json_integer(result.samples));
     assert(error == 0);
 
-    json_t *raw_results = json_array();
-    assert(raw_results != NULL);
+    error = json_object_set_new(j, "Mean precision", json_real_check(result.mean_ci));
+    assert(error == 0);
 
-    if (config_set(CONFIG_OUTPUT_RAW_RESULTS) && result.raw_data != NULL) {
-        for (size_t i = 0; i < result.samples; i++) {
-            error = json_array_append_new(raw_results, json_integer(result.raw_data[i]));
+    error = json_object_set_new(j, "Median precision", json_real_check(result.median_ci));
+    assert(error == 0);
+
+    if (result.raw_data != NULL) {
+        if (!isnan(result.mean_bootstrap_low)) {
+            json_t *interval = json_pack("[ff]", result.mean_bootstrap_low, result.mean_bootstrap_high);
+            assert(interval != NULL);
+            error = json_object_set_new(j, "Mean bootstrap CI95", interval);
+            assert(error == 0);
+        }
+
+        if (!isnan(result.median_bootstrap_low)) {
+            json_t *interval = json_pack("[ff]", result.median_bootstrap_low, result.median_bootstrap_high);
+            assert(interval != NULL);
+            error = json_object_set_new(j, "Median bootstrap CI95", interval);
             assert(error == 0);
         }
-        json_object_set_new(j, "Raw results", raw_results);
+
+        error = json_object_set_new(j, "Mild outliers", json_integer(result.mild_outliers));
+        assert(error == 0);
+
+        error = json_object_set_new(j, "Severe outliers", json_integer(result.severe_outliers));
+        assert(error == 0);
+    }
+
+    if (result.adaptive) {
+        error = json_object_set_new(j, "Converged", json_boolean(result.converged));
+        assert(error == 0);
+    }
+
+    if (result.warmup_detected) {
+        error = json_object_set_new(j, "Warm-up samples", json_integer(result.warmup));
         assert(error == 0);
+
+        error = json_object_set_new(j, "Steady state", json_boolean(result.steady));
+        assert(error == 0);
+    }
+
+    if (config_set(CONFIG_OUTPUT_RAW_RESULTS) && result.raw_data != NULL) {
+        if (config_set(CONFIG_RAW_RESULTS_COMPACT)) {
+            error = json_object_set_new(j, "Raw results compact",
+                                        raw_results_to_compact_json(result.samples, result.raw_data));
+            assert(error == 0);
+        } else {
+            json_t *raw_results = json_array();
+            assert(raw_results != NULL);
+            for (size_t i = 0; i < result.samples; i++) {
+                error = json_array_append_new(raw_results, json_integer(result.raw_data[i]));
+                assert(error == 0);
+            }
+            error = json_object_set_new(j, "Raw results", raw_results);
+            assert(error == 0);
+        }
     }
 }
 
@@ -85,7 +191,76 @@ static json_t *get_json_cell(column_t column, size_t index)
     }
 }
 
-json_t *result_set_to_json(result_set_t set)
+static void run_statistics_to_json(run_statistics_t stats, json_t *j)
+{
+    UNUSED int error = json_object_set_new(j, "Iterations", json_integer(stats.runs));
+    assert(error == 0);
+
+    error = json_object_set_new(j, "Within-run variance", json_real_check(stats.within_variance));
+    assert(error == 0);
+
+    error = json_object_set_new(j, "Between-run variance", json_real_check(stats.between_variance));
+    assert(error == 0);
+
+    error = json_object_set_new(j, "Between-run fraction",
+                                json_real_check(round_to_3_decimal_places(stats.between_fraction)));
+    assert(error == 0);
+
+    if (stats.from_summaries) {
+        error = json_object_set_new(j, "Merged from summaries", json_true());
+        assert(error == 0);
+    }
+
+    json_t *means = json_array();
+    assert(means != NULL);
+    for (size_t r = 0; r < stats.runs; r++) {
+        error = json_array_append_new(means, json_real_check(stats.means[r]));
+        assert(error == 0);
+    }
+    error = json_object_set_new(j, "Run means", means);
+    assert(error == 0);
+
+    if (stats.has_medians) {
+        json_t *medians = json_array();
+        assert(medians != NULL);
+        for (size_t r = 0; r < stats.runs; r++) {
+            error = json_array_append_new(medians, json_real_check(stats.medians[r]));
+            assert(error == 0);
+        }
+        error = json_object_set_new(j, "Run medians", medians);
+        assert(error == 0);
+
+        json_t *range = json_pack("[ff]", stats.median_min, stats.median_max);
+        assert(range != NULL);
+        error = json_object_set_new(j, "Run median range", range);
+        assert(error == 0);
+
+        error = json_object_set_new(j, "Run median stddev",
+                                    json_real_check(round_to_3_decimal_places(stats.median_stddev)));
+        assert(error == 0);
+    }
+}
+
+static const char *average_event_name(int event)
+{
+    return event == CYCLE_COUNT_EVENT ? "Cycle counter" : GENERIC_EVENT_NAMES[event];
+}
+
+/* the mean count of each event per operation, see pmu.h */
+static json_t *events_to_json(result_t events[NUM_AVERAGE_EVENTS])
+{
+    json_t *object = json_object();
+    assert(object != NULL);
+
+    for (int i = 0; i < NUM_AVERAGE_EVENTS; i++) {
+        UNUSED int error = json_object_set_new(object, average_event_name(i), json_real_check(events[i].mean));
+        assert(error == 0);
+    }
+    return object;
+}
+
+/* @param stats statistics of the runs of each result if they were merged, or NULL */
+static json_t *result_rows_to_json(result_set_t set, run_statistics_t *stats)
 {
     UNUSED int error;
     json_t *object = json_object();
@@ -94,6 +269,11 @@ json_t *result_set_to_json(result_set_t set)
     error = json_object_set_new(object, "Benchmark", json_string(set.name));
     assert(error == 0);
 
+    if (set.overhead_estimated) {
+        error = json_object_set_new(object, "Overhead estimated", json_true());
+        assert(error == 0);
+    }
+
     json_t *rows = json_array();
     assert(rows != NULL);
 
@@ -112,6 +292,14 @@ json_t *result_set_to_json(result_set_t set)
 
         }
         result_to_json(set.results[i], row);
+        if (stats != NULL) {
+            run_statistics_to_json(stats[i], row);
+        }
+        if (set.events != NULL) {
+            /* those of the last run, if the runs were merged */
+            error = json_object_set_new(row, "Events", events_to_json(&set.events[i * NUM_AVERAGE_EVENTS]));
+            assert(error == 0);
+        }
 
         error = json_array_append_new(rows, row);
         assert(error == 0);
@@ -120,6 +308,70 @@ json_t *result_set_to_json(result_set_t set)
     return object;
 }
 
+json_t *result_set_to_json(result_set_t set)
+{
+    if (!iterations_merging()) {
+        return result_rows_to_json(set, NULL);
+    }
+
+    iterations_add(&set);
+    if (!iterations_last_run()) {
+        /* the rows are output, merged, by the last run */
+        json_t *object = json_object();
+        assert(object != NULL);
+        return object;
+    }
+
+    result_t pooled[set.n_results];
+    run_statistics_t stats[set.n_results];
+    iterations_merge(set.n_results, pooled, stats);
+    set.results = pooled;
+    json_t *object = result_rows_to_json(set, stats);
+    iterations_release();
+    return object;
+}
+
+void sweep_to_columns(const sweep_t *sweep, size_t n, const size_t points[n], column_t columns[],
+                      sweep_cell_t cells[])
+{
+    for (size_t a = 0; a < sweep->n_axes; a++) {
+        const sweep_axis_t *axis = &sweep->axes[a];
+        /* each column gets n cells, which are big enough for any type of value */
+        sweep_cell_t *column_cells = &cells[a * n];
+
+        columns[a].header = (char *) axis->name;
+        switch (axis->type) {
+        case SWEEP_INTEGER:
+            columns[a].type = JSON_INTEGER;
+            columns[a].integer_array = (json_int_t *) column_cells;
+            break;
+        case SWEEP_BOOL:
+            columns[a].type = JSON_TRUE;
+            columns[a].bool_array = (bool *) column_cells;
+            break;
+        case SWEEP_LABEL:
+            columns[a].type = JSON_STRING;
+            columns[a].string_array = (char **) column_cells;
+            break;
+        }
+
+        for (size_t i = 0; i < n; i++) {
+            size_t index = sweep_value_index(sweep, points[i], a);
+            switch (axis->type) {
+            case SWEEP_INTEGER:
+                columns[a].integer_array[i] = axis->values[index];
+                break;
+            case SWEEP_BOOL:
+                columns[a].bool_array[i] = axis->values[index];
+                break;
+            case SWEEP_LABEL:
+                columns[a].string_array[i] = (char *) axis->labels[axis->values[index]];
+                break;
+            }
+        }
+    }
+}
+
 json_t *average_counters_to_json(char *name, result_t results[NUM_AVERAGE_EVENTS])
 {
     json_t *obj = json_object();
@@ -137,7 +389,7 @@ json_t *average_counters_to_json(char *name, result_t results[NUM_AVERAGE_EVENTS
         json_t *row = json_object();
         assert(row != NULL);
 
-        error = json_object_set_new(row, "Event",  json_string(GENERIC_EVENT_NAMES[i]));
+        error = json_object_set_new(row, "Event",  json_string(average_event_name(i)));
         assert(error == 0);
 
         result_to_json(results[i], row);
@@ -148,7 +400,7 @@ json_t *average_counters_to_json(char *name, result_t results[NUM_AVERAGE_EVENTS
     json_t *row = json_object();
     assert(row != NULL);
 
-    error = json_object_set_new(row, "Event", json_string("Cycle counter"));
+    error = json_object_set_new(row, "Event", json_string(average_event_name(CYCLE_COUNT_EVENT)));
     assert(error == 0);
 
     result_to_json(results[CYCLE_COUNT_EVENT], row);
@@ -158,3 +410,72 @@ json_t *average_counters_to_json(char *name, result_t results[NUM_AVERAGE_EVENTS
 
     return obj;
 }
+
+json_t *calibration_to_json(const calibration_t *calibration)
+{
+    json_t *obj = json_object();
+    assert(obj != NULL);
+
+    UNUSED int error = json_object_set_new(obj, "Benchmark", json_string("Overhead calibration"));
+    assert(error == 0);
+
+    json_t *rows = json_array();
+    assert(rows != NULL);
+
+    error = json_object_set_new(obj, "Results", rows);
+    assert(error == 0);
+
+    for (int i = 0; i < CALIBRATION_N_OVERHEADS; i++) {
+        const overhead_t *overhead = &calibration->overheads[i];
+        json_t *row = json_pack("{sssIsisb}", "Overhead", calibration_names[i],
+                                "Cycles", (json_int_t) overhead->value,
+                                "Confidence", overhead->confidence,
+                                "Stable", overhead->stable);
+        assert(row != NULL);
+
+        error = json_array_append_new(rows, row);
+        assert(error == 0);
+    }
+
+    return obj;
+}
+
+void json_stream_begin(json_stream_t *stream, FILE *out, size_t flags)
+{
+    stream->out = out;
+    stream->flags = flags;
+    stream->n_elements = 0;
+
+    fputs("[\n", out);
+    fflush(out);
+}
+
+int json_stream_append(json_stream_t *stream, json_t *array)
+{
+    size_t idx;
+    json_t *element;
+    int error = 0;
+
+    json_array_foreach(array, idx, element) {
+        if (stream->n_elements > 0) {
+            fputs(",\n", stream->out);
+        }
+        error = json_dumpf(element, stream->out, stream->flags);
+        if (error) {
+            break;
+        }
+        stream->n_elements++;
+    }
+
+    /* push the element out now, so it survives a later failure of the suite */
+    fflush(stream->out);
+    json_decref(array);
+
+    return error;
+}
+
+void json_stream_end(json_stream_t *stream)
+{
+    fputs("\n]\n", stream->out);
+    fflush(stream->out);
+}
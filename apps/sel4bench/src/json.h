@@ -8,8 +8,62 @@
 
 #include "benchmark.h"
 #include <jansson.h>
+#include <stdio.h>
 #include <sel4bench/sel4bench.h>
 #include <benchmark.h>
+#include <calibration.h>
+#include <sweep.h>
+
+/* Writes a JSON array one element at a time, so that results can be emitted
+ * (and freed) as soon as they are produced. */
+typedef struct {
+    /* where to write the array */
+    FILE *out;
+    /* jansson flags to dump each element with */
+    size_t flags;
+    /* number of elements written so far */
+    size_t n_elements;
+} json_stream_t;
 
 json_t *result_set_to_json(result_set_t set);
+
+/* storage for the cells of the columns made by sweep_to_columns */
+typedef union {
+    char *string;
+    json_int_t integer;
+    bool boolean;
+} sweep_cell_t;
+
+/*
+ * Make a column for each axis of a sweep (see sweep.h), which labels each of n
+ * results with the values of the axes at the point of the sweep it was measured at.
+ *
+ * @param sweep   the sweep the results were measured over.
+ * @param n       number of results.
+ * @param points  point of the sweep of each result.
+ * @param columns sweep->n_axes columns to fill in.
+ * @param cells   storage for the n * sweep->n_axes cells of the columns, which must
+ *                live as long as the columns.
+ */
+void sweep_to_columns(const sweep_t *sweep, size_t n, const size_t points[n], column_t columns[],
+                      sweep_cell_t cells[]);
 json_t *average_counters_to_json(char *name, result_t counters[NUM_AVERAGE_EVENTS]);
+
+/*
+ * A result set with a row for each overhead of a calibration (see calibration.h): its
+ * value in cycles, the confidence of the estimate, and whether it was stable.
+ */
+json_t *calibration_to_json(const calibration_t *calibration);
+
+/* Open a JSON array on out. */
+void json_stream_begin(json_stream_t *stream, FILE *out, size_t flags);
+
+/*
+ * Write every element of array to the stream and release the array.
+ *
+ * @return 0 on success, -1 if an element could not be written.
+ */
+int json_stream_append(json_stream_t *stream, json_t *array);
+
+/* Close the JSON array opened by json_stream_begin. */
+void json_stream_end(json_stream_t *stream);
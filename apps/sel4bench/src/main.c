@@ -25,7 +25,10 @@
 #include <sel4rpc/server.h>
 #include <sel4utils/api.h>
 #include <sel4utils/stack.h>
+#include <sel4utils/thread.h>
+#include <sel4utils/thread_config.h>
 #include <stdio.h>
+#include <stdlib.h>
 #include <string.h>
 #include <utils/util.h>
 #include <vka/object.h>
@@ -34,9 +37,20 @@
 
 #include <ipc.h>
 #include <benchmark_types.h>
+#include <cache_colour.h>
+#include <cache_state.h>
+#include <calibration.h>
+#include <prng.h>
+#include <sample_ring.h>
+#include <shared_mem.h>
+#include <shuffle.h>
 
 #include "benchmark.h"
 #include "env.h"
+#include "iterations.h"
+#include "json.h"
+#include "params.h"
+#include "pipeline.h"
 #include "printing.h"
 #include "processing.h"
 
@@ -53,6 +67,15 @@ static sel4utils_alloc_data_t data;
 /* environment for the benchmark runner, set up in main() */
 static env_t global_env;
 
+/* measurement overheads on each core, passed to the benchmarks that run there */
+static calibration_t calibration[CONFIG_MAX_NUM_NODES];
+
+#define JSON_FLAGS (JSON_PRESERVE_ORDER | JSON_INDENT(CONFIG_JSON_INDENT) | JSON_REAL_PRECISION(16))
+
+/* where the results of each benchmark run go, see output_results */
+static json_stream_t output_stream;
+static json_t *output;
+
 static void setup_fault_handler(env_t *env)
 {
     int error;
@@ -96,59 +119,241 @@ static void setup_fault_handler(env_t *env)
     }
 }
 
-int run_benchmark(env_t *env, benchmark_t *benchmark, void *local_results_vaddr, benchmark_args_t *args)
+/* seed of the orders of the configurations of all runs (see shuffle.h), and the
+ * generator of the seed of each run */
+static uint64_t order_seed;
+static prng_t order_prng;
+
+static void order_init(void)
 {
-    int error;
+#ifdef CONFIG_SHUFFLE_ORDER
+    order_seed = CONFIG_SHUFFLE_SEED;
+    if (order_seed == 0) {
+        ccnt_t now;
+        sel4bench_init();
+        SEL4BENCH_READ_CCNT(now);
+        sel4bench_destroy();
+        order_seed = now;
+    }
+#endif
+    prng_seed(&order_prng, order_seed);
+}
+
+/* a calibration on a core other than 0, run by a thread pinned to it */
+typedef struct {
+    calibration_t *calibration;
+    /* signalled once the overheads have been measured */
+    seL4_CPtr done;
+    /* of the thread itself, to suspend once done */
+    seL4_CPtr tcb;
+} calibration_job_t;
+
+static void calibration_fn(void *arg0, UNUSED void *arg1, UNUSED void *ipc_buf)
+{
+    calibration_job_t *job = arg0;
+    calibration_measure(job->calibration);
+    seL4_Signal(job->done);
+    seL4_TCB_Suspend(job->tcb);
+}
+
+/* the number of cores benchmarks taking calibrated overheads run on */
+static int calibration_cores(env_t *env)
+{
+    return config_set(CONFIG_PER_CORE_RUNS) ? simple_get_core_count(&env->simple) : 1;
+}
+
+/*
+ * Measure the overheads on each core benchmarks run on, as they need not be the same
+ * on every core (e.g. on big.LITTLE boards). Core 0 is measured by the root task
+ * itself, the others by a thread pinned to each in turn.
+ */
+static void calibrate(env_t *env)
+{
+    calibration_measure(&calibration[0]);
+
+    int cores = calibration_cores(env);
+    if (cores < 2) {
+        return;
+    }
+
+    vka_object_t done;
+    int error = vka_alloc_notification(&env->vka, &done);
+    ZF_LOGF_IF(error, "Failed to allocate calibration notification");
+
+    for (int core = 1; core < cores; core++) {
+        sel4utils_thread_t thread;
+        sel4utils_thread_config_t config = thread_config_new(&env->simple);
+        config = thread_config_priority(config, seL4_MaxPrio);
+        config = thread_config_auth(config, simple_get_tcb(&env->simple));
+#ifdef CONFIG_KERNEL_MCS
+        config.sched_params = sched_params_round_robin(config.sched_params, &env->simple, core,
+                                                       CONFIG_BOOT_THREAD_TIME_SLICE * NS_IN_US);
+#else
+        config.sched_params.core = core;
+#endif
+        error = sel4utils_configure_thread_config(&env->vka, &env->vspace, &env->vspace, config, &thread);
+        ZF_LOGF_IF(error, "Failed to configure calibration thread");
+        NAME_THREAD(thread.tcb.cptr, "sel4bench-calibration");
+
+        error = sel4utils_set_sched_affinity(&thread, config.sched_params);
+        ZF_LOGF_IF(error, "Failed to move calibration thread to core %d", core);
+
+        calibration_job_t job = {
+            .calibration = &calibration[core],
+            .done = done.cptr,
+            .tcb = thread.tcb.cptr,
+        };
+        error = sel4utils_start_thread(&thread, calibration_fn, &job, NULL, true);
+        ZF_LOGF_IF(error, "Failed to start calibration thread");
+        seL4_Wait(done.cptr, NULL);
+
+        sel4utils_clean_up_thread(&env->vka, &env->vspace, &thread);
+        ZF_LOGF_IF(!calibration[core].valid, "Failed to calibrate core %d", core);
+    }
+
+    vka_free_object(&env->vka, &done);
+}
+
+/* state of a running benchmark process */
+typedef struct benchmark_process {
     sel4utils_process_t process;
     sel4rpc_server_env_t rpc_env;
+    /* args, in our vspace and in the benchmark's */
+    benchmark_args_t *args;
+    void *remote_args_vaddr;
+    /* results, in our vspace */
+    void *results;
+    /* sample ring, in our vspace. NULL if the benchmark does not use one */
+    sample_ring_t *ring;
+    /* size of the pages the results, args and ring are mapped with (see shared_mem.h) */
+    size_t results_page_bits;
+    size_t args_page_bits;
+    size_t ring_page_bits;
+    size_t num_fdt_pages;
+} benchmark_process_t;
+
+/* pass everything in the sample ring to the benchmark's drain function */
+static void drain_ring(benchmark_t *benchmark, benchmark_process_t *bp)
+{
+    ccnt_t *samples;
+    size_t n;
+
+    while ((n = sample_ring_peek(bp->ring, &samples)) != 0) {
+        benchmark->drain(bp->results, bp->ring->stream, n, samples);
+        sample_ring_consume(bp->ring, n);
+    }
+}
+
+/* create the process for a benchmark and its shared memory, and start it */
+static void start_benchmark(env_t *env, benchmark_t *benchmark, benchmark_process_t *bp, int core)
+{
+    int error;
+    sel4utils_process_t *process = &bp->process;
+
+    pipeline_lock();
+
+    /* reserve memory for the results */
+    bp->results = shared_mem_alloc(&env->vspace, benchmark->results_pages * PAGE_SIZE_4K, &bp->results_page_bits);
+    ZF_LOGF_IF(bp->results == NULL, "Failed to allocate pages for results");
+
+    /* reserve memory for args */
+    assert(sizeof(benchmark_args_t) < PAGE_SIZE_4K);
+    bp->args = shared_mem_alloc(&env->vspace, PAGE_SIZE_4K, &bp->args_page_bits);
+    ZF_LOGF_IF(bp->args == NULL, "Failed to allocate page for args");
+    benchmark_args_t *args = bp->args;
+
+    /* reserve memory for the sample ring */
+    bp->ring = NULL;
+    if (benchmark->ring_pages > 0) {
+        assert(benchmark->drain != NULL);
+        bp->ring = shared_mem_alloc(&env->vspace, benchmark->ring_pages * PAGE_SIZE_4K, &bp->ring_page_bits);
+        ZF_LOGF_IF(bp->ring == NULL, "Failed to allocate pages for sample ring");
+        sample_ring_init(bp->ring, benchmark->ring_pages * BIT(seL4_PageBits));
+    }
 
     /* configure benchmark process */
     sel4utils_process_config_t config = process_config_default_simple(&env->simple, benchmark->name,
                                                                       seL4_MaxPrio);
     config = process_config_mcp(config, seL4_MaxPrio);
-    error = sel4utils_configure_process_custom(&process, &env->vka, &env->vspace, config);
+    if (core != 0) {
+#ifdef CONFIG_KERNEL_MCS
+        config.sched_params = sched_params_round_robin(config.sched_params, &env->simple, core,
+                                                       CONFIG_BOOT_THREAD_TIME_SLICE * NS_IN_US);
+#else
+        config.sched_params.core = core;
+#endif
+    }
+    error = sel4utils_configure_process_custom(process, &env->vka, &env->vspace, config);
     ZF_LOGF_IFERR(error, "Failed to configure process for %s benchmark", benchmark->name);
+    if (core != 0) {
+        error = sel4utils_set_sched_affinity(&process->thread, config.sched_params);
+        ZF_LOGF_IF(error, "Failed to move %s benchmark to core %d", benchmark->name, core);
+    }
 
     /* initialise sched ctrl for benchmark environment */
     if (config_set(CONFIG_KERNEL_MCS)) {
         seL4_CPtr sched_ctrl = simple_get_sched_ctrl(&env->simple, 0);
-        args->sched_ctrl = sel4utils_copy_cap_to_process(&process, &env->vka, sched_ctrl);
+        args->sched_ctrl = sel4utils_copy_cap_to_process(process, &env->vka, sched_ctrl);
         for (int i = 1; i < CONFIG_MAX_NUM_NODES; i++) {
             sched_ctrl = simple_get_sched_ctrl(&env->simple, i);
-            sel4utils_copy_cap_to_process(&process, &env->vka, sched_ctrl);
+            sel4utils_copy_cap_to_process(process, &env->vka, sched_ctrl);
         }
     }
 
     /* copy serial to process */
-    args->serial_ep = serial_server_parent_mint_endpoint_to_process(&process);
+    args->serial_ep = serial_server_parent_mint_endpoint_to_process(process);
     ZF_LOGF_IF(args->serial_ep == 0, "Failed to copy rpc serial ep to process");
 
-    /* copy untyped to process */
-    args->untyped_cptr = sel4utils_copy_cap_to_process(&process, &env->vka, env->untyped.cptr);
+    /* copy untypeds to process, they get consecutive slots */
+    args->n_untypeds = env->n_untypeds;
+    for (size_t i = 0; i < env->n_untypeds; i++) {
+        seL4_CPtr slot = sel4utils_copy_cap_to_process(process, &env->vka, env->untypeds[i].cptr);
+        ZF_LOGF_IF(slot == seL4_CapNull, "Failed to copy untyped to process");
+        if (i == 0) {
+            args->untyped_cptr = slot;
+        }
+        assert(slot == args->untyped_cptr + i);
+        args->untyped_size_bits[i] = env->untypeds[i].size_bits;
+        args->untyped_paddr[i] = vka_utspace_paddr(&env->vka, env->untypeds[i].ut, seL4_UntypedObject,
+                                                   env->untypeds[i].size_bits);
+    }
     /* this is the last cap we copy - initialise the first free cap */
-    args->first_free = args->untyped_cptr + 1;
+    args->first_free = args->untyped_cptr + env->n_untypeds;
 
     args->stack_pages = CONFIG_SEL4UTILS_STACK_SIZE / SIZE_BITS_TO_BYTES(seL4_PageBits);
-    args->stack_vaddr = ((uintptr_t) process.thread.stack_top) - CONFIG_SEL4UTILS_STACK_SIZE;
+    args->stack_vaddr = ((uintptr_t) process->thread.stack_top) - CONFIG_SEL4UTILS_STACK_SIZE;
 
-    NAME_THREAD(process.thread.tcb.cptr, benchmark->name);
+    NAME_THREAD(process->thread.tcb.cptr, benchmark->name);
 
     /* set up shared memory for results */
-    args->results = vspace_share_mem(&env->vspace, &process.vspace, local_results_vaddr,
-                                     benchmark->results_pages, seL4_PageBits, seL4_AllRights, true);
+    args->results = vspace_share_mem(&env->vspace, &process->vspace, bp->results,
+                                     shared_mem_pages(benchmark->results_pages * PAGE_SIZE_4K, bp->results_page_bits),
+                                     bp->results_page_bits, seL4_AllRights, true);
+    ZF_LOGF_IF(args->results == NULL, "Failed to share the results");
+    args->results_page_bits = bp->results_page_bits;
+
+    /* set up shared memory for the sample ring */
+    args->ring_pages = benchmark->ring_pages;
+    if (benchmark->ring_pages > 0) {
+        args->ring = vspace_share_mem(&env->vspace, &process->vspace, bp->ring,
+                                      shared_mem_pages(benchmark->ring_pages * PAGE_SIZE_4K, bp->ring_page_bits),
+                                      bp->ring_page_bits, seL4_AllRights, true);
+        ZF_LOGF_IF(args->ring == NULL, "Failed to share the sample ring");
+        args->ring_page_bits = bp->ring_page_bits;
+    }
 
     /* do benchmark specific init */
-    benchmark->init(&env->vka, &env->simple, &process);
+    benchmark->init(&env->vka, &env->simple, process);
 
-    size_t num_fdt_pages = 0;
+    bp->num_fdt_pages = 0;
     if (config_set(CONFIG_ARCH_ARM)) {
         char *fdt_blob = ps_io_fdt_get(&env->ops.io_fdt);
         ZF_LOGF_IF(!fdt_blob, "Failed to get the FDT blob for sharing with the benchmark process");
         size_t fdt_size = fdt_totalsize(fdt_blob);
         /* perhaps optimise to use larger page sizes if possible? */
-        num_fdt_pages = DIV_ROUND_UP(fdt_size, BIT(seL4_PageBits));
+        bp->num_fdt_pages = DIV_ROUND_UP(fdt_size, BIT(seL4_PageBits));
         /* share the FDT with the benchmarking process */
-        args->fdt = vspace_share_mem(&env->vspace, &process.vspace, fdt_blob, num_fdt_pages,
+        args->fdt = vspace_share_mem(&env->vspace, &process->vspace, fdt_blob, bp->num_fdt_pages,
                                      seL4_PageBits, seL4_AllRights, true);
         ZF_LOGF_IF(!args->fdt, "Failed to share the FDT blob");
         /* offset the shared address if the address is page aligned */
@@ -158,13 +363,19 @@ int run_benchmark(env_t *env, benchmark_t *benchmark, void *local_results_vaddr,
     }
 
     /* set up arguments */
-    void *remote_args_vaddr = vspace_share_mem(&env->vspace, &process.vspace, args, 1,
-                                               seL4_PageBits, seL4_AllRights, true);
-    args->untyped_size_bits = env->untyped.size_bits;
+    bp->remote_args_vaddr = vspace_share_mem(&env->vspace, &process->vspace, args, 1,
+                                             bp->args_page_bits, seL4_AllRights, true);
+    ZF_LOGF_IF(bp->remote_args_vaddr == NULL, "Failed to share the args");
+    args->args_page_bits = bp->args_page_bits;
     args->nr_cores = simple_get_core_count(&env->simple);
+    args->core = core;
+    args->order_seed = prng_next(&order_prng);
+    args->params = benchmark->params;
+    assert(core < calibration_cores(env));
+    args->calibration = calibration[core];
 
     /* set up rpc server environment */
-    error = sel4rpc_server_init(&rpc_env, &env->vka, sel4rpc_default_handler, env, &process.thread.reply,
+    error = sel4rpc_server_init(&bp->rpc_env, &env->vka, sel4rpc_default_handler, env, &process->thread.reply,
                                 &env->simple);
     ZF_LOGF_IF(error, "Failed to initialise RPC server environment");
 
@@ -172,103 +383,384 @@ int run_benchmark(env_t *env, benchmark_t *benchmark, void *local_results_vaddr,
     seL4_Word argc = 1;
     char string_args[argc][WORD_STRING_SIZE];
     char *argv[argc];
-    sel4utils_create_word_args(string_args, argv, argc, remote_args_vaddr);
+    sel4utils_create_word_args(string_args, argv, argc, bp->remote_args_vaddr);
     /* start process */
-    error = sel4utils_spawn_process_v(&process, &env->vka, &env->vspace, argc, argv, 1);
+    error = sel4utils_spawn_process_v(process, &env->vka, &env->vspace, argc, argv, 1);
     ZF_LOGF_IF(error, "Failed to start benchmark process");
 
-    /* wait for it to finish */
+    pipeline_unlock();
+}
+
+/*
+ * Serve the benchmark until it reports that it has finished, either for good
+ * (benchmark_finished) or for this iteration (benchmark_iteration_done).
+ *
+ * @return the exit code of the benchmark.
+ */
+static int wait_benchmark(benchmark_t *benchmark, benchmark_process_t *bp)
+{
+    sel4utils_process_t *process = &bp->process;
     int result = SEL4BENCH_PROTOBUF_RPC;
-    while (result == SEL4BENCH_PROTOBUF_RPC) {
-        seL4_MessageInfo_t info = api_recv(process.fault_endpoint.cptr, NULL, process.thread.reply.cptr);
+
+    while (result == SEL4BENCH_PROTOBUF_RPC || result == SEL4BENCH_RING_DRAIN) {
+        seL4_MessageInfo_t info = api_recv(process->fault_endpoint.cptr, NULL, process->thread.reply.cptr);
         result = seL4_GetMR(0);
         if (seL4_MessageInfo_get_label(info) != seL4_Fault_NullFault) {
+            pipeline_lock();
             sel4utils_print_fault_message(info, benchmark->name);
-            sel4debug_dump_registers(process.thread.tcb.cptr);
+            sel4debug_dump_registers(process->thread.tcb.cptr);
+            pipeline_unlock();
             result = EXIT_FAILURE;
         } else if (result == SEL4BENCH_PROTOBUF_RPC) {
-            sel4rpc_server_recv(&rpc_env);
+            /* the benchmark asks us to allocate something for it */
+            pipeline_lock();
+            sel4rpc_server_recv(&bp->rpc_env);
+            pipeline_unlock();
+        } else if (result == SEL4BENCH_RING_DRAIN) {
+            ZF_LOGF_IF(benchmark->ring_pages == 0, "%s asked to drain a sample ring it does not have",
+                       benchmark->name);
+            drain_ring(benchmark, bp);
+            api_reply(process->thread.reply.cptr, seL4_MessageInfo_new(0, 0, 0, 0));
         } else if (result != EXIT_SUCCESS) {
+            pipeline_lock();
             ZF_LOGE("Benchmark failed, result %d\n", result);
-            sel4debug_dump_registers(process.thread.tcb.cptr);
+            sel4debug_dump_registers(process->thread.tcb.cptr);
+            pipeline_unlock();
         }
     }
 
+    if (result == EXIT_SUCCESS && bp->ring != NULL) {
+        /* anything the benchmark pushed after its last drain */
+        drain_ring(benchmark, bp);
+    }
+
+    return result;
+}
+
+/*
+ * Answer a persistent benchmark that is waiting in benchmark_iteration_done.
+ *
+ * @param again true to run another iteration, in which case the results are reset
+ *              first. false to make the benchmark clean up and exit.
+ */
+static void resume_benchmark(benchmark_t *benchmark, benchmark_process_t *bp, bool again)
+{
+    if (again) {
+        bp->args->order_seed = prng_next(&order_prng);
+        memset(bp->results, 0, benchmark->results_pages * BIT(seL4_PageBits));
+        if (bp->ring != NULL) {
+            sample_ring_init(bp->ring, benchmark->ring_pages * BIT(seL4_PageBits));
+        }
+    }
+
+    /* nothing but the benchmark has received on this thread since it called us,
+     * so the reply cap is still the one for the benchmark */
+    seL4_SetMR(0, again);
+    api_reply(bp->process.thread.reply.cptr, seL4_MessageInfo_new(0, 0, 0, 1));
+}
+
+/* tear down a benchmark process and its shared memory */
+static void destroy_benchmark(env_t *env, benchmark_t *benchmark, benchmark_process_t *bp)
+{
+    sel4utils_process_t *process = &bp->process;
+    benchmark_args_t *args = bp->args;
+
+    pipeline_lock();
+
     /* free results in target vspace (they will still be in ours) */
-    vspace_unmap_pages(&process.vspace, args->results, benchmark->results_pages, seL4_PageBits, VSPACE_FREE);
-    vspace_unmap_pages(&process.vspace, remote_args_vaddr, 1, seL4_PageBits, VSPACE_FREE);
+    vspace_unmap_pages(&process->vspace, args->results,
+                       shared_mem_pages(benchmark->results_pages * PAGE_SIZE_4K, bp->results_page_bits),
+                       bp->results_page_bits, VSPACE_FREE);
+    vspace_unmap_pages(&process->vspace, bp->remote_args_vaddr, 1, bp->args_page_bits, VSPACE_FREE);
+    if (benchmark->ring_pages > 0) {
+        vspace_unmap_pages(&process->vspace, args->ring,
+                           shared_mem_pages(benchmark->ring_pages * PAGE_SIZE_4K, bp->ring_page_bits),
+                           bp->ring_page_bits, VSPACE_FREE);
+    }
     if (config_set(CONFIG_ARCH_ARM)) {
         /* free the shared FDT, align it just in case we've offsetted the addr */
         void *aligned_fdt_addr = (void *) ALIGN_DOWN((uintptr_t) args->fdt, BIT(seL4_PageBits));
-        vspace_unmap_pages(&process.vspace, aligned_fdt_addr, num_fdt_pages, seL4_PageBits, VSPACE_FREE);
+        vspace_unmap_pages(&process->vspace, aligned_fdt_addr, bp->num_fdt_pages, seL4_PageBits, VSPACE_FREE);
     }
     /* clean up */
 
     /* revoke the untypeds so it's clean for the next benchmark */
-    cspacepath_t path;
-    vka_cspace_make_path(&env->vka, env->untyped.cptr, &path);
-    vka_cnode_revoke(&path);
+    for (size_t i = 0; i < env->n_untypeds; i++) {
+        cspacepath_t path;
+        vka_cspace_make_path(&env->vka, env->untypeds[i].cptr, &path);
+        vka_cnode_revoke(&path);
+    }
 
     /* destroy the process */
-    sel4utils_destroy_process(&process, &env->vka);
+    sel4utils_destroy_process(process, &env->vka);
 
-    return result;
-}
-
-json_t *launch_benchmark(benchmark_t *benchmark, env_t *env, int run)
-{
-    int title_len = printf("\n%s Benchmarks (iteration %d)\n", benchmark->name, run) - 2;
-    for (int i = 0; i < title_len; i++) {
-        putchar('=');
+    /* free results */
+    vspace_unmap_pages(&env->vspace, bp->results,
+                       shared_mem_pages(benchmark->results_pages * PAGE_SIZE_4K, bp->results_page_bits),
+                       bp->results_page_bits, VSPACE_FREE);
+    vspace_unmap_pages(&env->vspace, bp->args, 1, bp->args_page_bits, VSPACE_FREE);
+    if (bp->ring != NULL) {
+        vspace_unmap_pages(&env->vspace, bp->ring,
+                           shared_mem_pages(benchmark->ring_pages * PAGE_SIZE_4K, bp->ring_page_bits),
+                           bp->ring_page_bits, VSPACE_FREE);
     }
-    printf("\n\n");
 
-    /* reserve memory for the results */
-    void *results = vspace_new_pages(&env->vspace, seL4_AllRights, benchmark->results_pages, seL4_PageBits);
-    ZF_LOGF_IF(results == NULL, "Failed to allocate pages for results");
+    pipeline_unlock();
+}
 
-    /* reserve memory for args */
-    assert(sizeof(benchmark_args_t) < PAGE_SIZE_4K);
-    void *args = vspace_new_pages(&env->vspace, seL4_AllRights, 1, seL4_PageBits);
-    /* Run benchmark process */
-    int exit_code = run_benchmark(env, benchmark, results, args);
+/* the results of a benchmark run, to be processed and output by process_job */
+typedef struct results_job {
+    benchmark_t *benchmark;
+    int run;
+    /* core the benchmark ran on, -1 unless it was run on every core */
+    int core;
+    void *results;
+} results_job_t;
 
-    /* process & print results */
-    json_t *json = NULL;
-    if (exit_code == EXIT_SUCCESS) {
-        json = benchmark->process(results);
-    }
+static results_job_t job;
 
-    /* free results */
-    vspace_unmap_pages(&env->vspace, results, benchmark->results_pages, seL4_PageBits, VSPACE_FREE);
-    vspace_unmap_pages(&env->vspace, args, 1, seL4_PageBits, VSPACE_FREE);
+/*
+ * With pipelined processing, the worker processes a copy of the results while the
+ * benchmark writes the next run's into its results pages.
+ */
+static void *results_copy;
+static size_t results_copy_pages;
 
-    return json;
+static void *copy_results(benchmark_t *benchmark, benchmark_process_t *bp)
+{
+    if (benchmark->results_pages > results_copy_pages) {
+        pipeline_lock();
+        free(results_copy);
+        results_copy = malloc(benchmark->results_pages * BIT(seL4_PageBits));
+        ZF_LOGF_IF(results_copy == NULL, "Failed to allocate a copy of the results of %s", benchmark->name);
+        pipeline_unlock();
+        results_copy_pages = benchmark->results_pages;
+    }
+    memcpy(results_copy, bp->results, benchmark->results_pages * BIT(seL4_PageBits));
+    return results_copy;
 }
 
-void find_untyped(vka_t *vka, vka_object_t *untyped)
+/* the cache colours the benchmark's frames were allocated from (see cache_colour.h) */
+static json_t *cache_colours_to_json(void)
 {
-    int error = 0;
-
-    /* find  a large untyped */
-    for (uint8_t size_bits = seL4_MaxUntypedBits; size_bits > seL4_PageBits; size_bits--) {
-        error = vka_alloc_untyped(vka, size_bits, untyped);
-        if (error == 0) {
-            break;
+    json_t *colours = json_array();
+    ZF_LOGF_IF(colours == NULL, "Failed to create cache colours");
+#ifdef CONFIG_CACHE_COLOURING
+    for (int colour = 0; colour < CONFIG_CACHE_COLOURS; colour++) {
+        if ((CONFIG_CACHE_COLOUR_MASK >> colour) & 1) {
+            int error = json_array_append_new(colours, json_integer(colour));
+            ZF_LOGF_IF(error != 0, "Failed to add cache colour");
         }
     }
-    ZF_LOGF_IF(error, "Failed to find free untyped\n");
+#endif
+    return colours;
 }
 
-/* add iteration run number to each entry in the json result array */
+/*
+ * tag each entry in the json result array with the run number, or the number of
+ * runs if they were merged, and how it was processed
+ */
 static void add_iteration_tag(json_t *result, int run)
 {
     size_t idx;
     json_t *result_set;
     json_array_foreach(result, idx, result_set) {
         /* result_set points to entry at index idx in json array */
-        int error = json_object_set_new(result_set, "Iteration", json_integer(run));
+        int error;
+        if (iterations_merging()) {
+            error = json_object_set_new(result_set, "Iterations", json_integer(CONFIG_ITERATIONS));
+        } else {
+            error = json_object_set_new(result_set, "Iteration", json_integer(run));
+        }
         ZF_LOGF_IF(error != 0, "Failed to set iteration number");
+        if (cache_state_name() != NULL) {
+            error = json_object_set_new(result_set, "Cache state", json_string(cache_state_name()));
+            ZF_LOGF_IF(error != 0, "Failed to set cache state");
+        }
+        if (config_set(CONFIG_CACHE_COLOURING)) {
+            error = json_object_set_new(result_set, "Cache colours", cache_colours_to_json());
+            ZF_LOGF_IF(error != 0, "Failed to set cache colours");
+            /* the memory colouring the driver's frames wasted so far */
+            error = json_object_set_new(result_set, "Frames of other colours",
+                                        json_integer(cache_colour_rejected()));
+            ZF_LOGF_IF(error != 0, "Failed to set frames of other colours");
+        }
+        if (config_set(CONFIG_SHUFFLE_ORDER)) {
+            char seed[32];
+            snprintf(seed, sizeof(seed), "%#llx", (unsigned long long) order_seed);
+            error = json_object_set_new(result_set, "Order seed", json_string(seed));
+            ZF_LOGF_IF(error != 0, "Failed to set order seed");
+        }
+        if (pipeline_active()) {
+            /* processing alongside the benchmark may have perturbed it */
+            error = json_object_set_new(result_set, "Pipelined processing", json_true());
+            ZF_LOGF_IF(error != 0, "Failed to set pipelined processing");
+        }
+    }
+}
+
+/* add a column with the core the benchmark ran on to every row of the json result array */
+static void add_core_column(json_t *result, int core)
+{
+    size_t idx;
+    json_t *result_set;
+    json_array_foreach(result, idx, result_set) {
+        size_t row_idx;
+        json_t *row;
+        json_array_foreach(json_object_get(result_set, "Results"), row_idx, row) {
+            UNUSED int error = json_object_set_new(row, "Core", json_integer(core));
+            ZF_LOGF_IF(error != 0, "Failed to set core");
+        }
+    }
+}
+
+/* add the results of a benchmark run to the output */
+static void output_results(json_t *result)
+{
+    int error;
+
+    if (config_set(CONFIG_STREAM_JSON_OUTPUT)) {
+        error = json_stream_append(&output_stream, result);
+        ZF_LOGF_IF(error != 0, "Failed to output benchmark results");
+    } else {
+        error = json_array_extend(output, result);
+        ZF_LOGF_IF(error != 0, "Failed to add benchmark results");
+        json_decref(result);
+    }
+}
+
+/* process & output the results of a benchmark run */
+static void process_job(void *arg)
+{
+    results_job_t *job = arg;
+
+    iterations_begin(job->run);
+    json_t *result = job->benchmark->process(job->results);
+    ZF_LOGF_IF(result == NULL, "Failed to process results of benchmark %s", job->benchmark->name);
+    /* the raw data of the results has been copied into the JSON */
+    processing_release();
+
+    if (iterations_merging() && !iterations_last_run()) {
+        /* the results were kept, to be merged into the output of the last run */
+        json_decref(result);
+        return;
+    }
+
+    add_iteration_tag(result, job->run);
+    if (job->core >= 0) {
+        add_core_column(result, job->core);
+    }
+    output_results(result);
+}
+
+/* Is the benchmark run on every core in turn? */
+static bool run_per_core(benchmark_t *benchmark)
+{
+    return config_set(CONFIG_PER_CORE_RUNS) && benchmark->per_core;
+}
+
+/*
+ * Run a benchmark once on core and submit its results for processing.
+ *
+ * @return true if the benchmark succeeded.
+ */
+bool launch_benchmark(benchmark_t *benchmark, env_t *env, int run, int core)
+{
+    /* a persistent benchmark keeps its process between iterations */
+    static benchmark_process_t bp;
+    bool persistent = benchmark->persistent && !config_set(CONFIG_COLD_START_ITERATIONS);
+
+    /* nothing may run alongside the benchmark. Nor may the last run of a benchmark
+     * with a ring still be processed, as drain keeps the samples in state of the
+     * benchmark's own, which process reads */
+    if (benchmark->all_cores || benchmark->ring_pages > 0 || pipeline_on_core(core)) {
+        pipeline_flush();
+    }
+
+    if (!config_set(CONFIG_STREAM_JSON_OUTPUT)) {
+        /* the banner would end up in the middle of the streamed JSON array */
+        pipeline_lock();
+        int title_len;
+        if (run_per_core(benchmark)) {
+            title_len = printf("\n%s Benchmarks (core %d, iteration %d)\n", benchmark->name, core, run) - 2;
+        } else {
+            title_len = printf("\n%s Benchmarks (iteration %d)\n", benchmark->name, run) - 2;
+        }
+        for (int i = 0; i < title_len; i++) {
+            putchar('=');
+        }
+        printf("\n\n");
+        pipeline_unlock();
+    }
+
+    if (!persistent || run == 0) {
+        start_benchmark(env, benchmark, &bp, core);
+    } else {
+        resume_benchmark(benchmark, &bp, true);
+    }
+
+    int exit_code = wait_benchmark(benchmark, &bp);
+    bool success = exit_code == EXIT_SUCCESS;
+
+    if (success) {
+        /* the previous job may still be using the copy of the results */
+        pipeline_flush();
+        job = (results_job_t) {
+            .benchmark = benchmark,
+            .run = run,
+            .core = run_per_core(benchmark) ? core : -1,
+            .results = pipeline_active() ? copy_results(benchmark, &bp) : bp.results,
+        };
+        pipeline_submit(process_job, &job);
+    }
+
+    if (persistent && success) {
+        if (run < CONFIG_ITERATIONS - 1) {
+            /* keep the process for the next iteration */
+            return success;
+        }
+        /* let the benchmark clean up after itself */
+        resume_benchmark(benchmark, &bp, false);
+        exit_code = wait_benchmark(benchmark, &bp);
+        ZF_LOGE_IF(exit_code != EXIT_SUCCESS, "%s failed to exit cleanly", benchmark->name);
+    }
+
+    destroy_benchmark(env, benchmark, &bp);
+
+    return success;
+}
+
+/*
+ * Find the untypeds to pass to the benchmarks: the largest ones there are, up to
+ * CONFIG_CHILD_UNTYPEDS of them, keeping 2^CONFIG_ROOT_RESERVE_BITS bytes for ourselves.
+ */
+static void find_untypeds(env_t *env)
+{
+    compile_time_assert(child_untypeds_fit, CONFIG_CHILD_UNTYPEDS > 0 &&
+                        CONFIG_CHILD_UNTYPEDS <= SEL4BENCH_MAX_UNTYPEDS);
+
+    /* hold on to the reserve while we take the rest */
+    vka_object_t reserve = {0};
+    size_t max_untypeds = CONFIG_CHILD_UNTYPEDS;
+    int error = vka_alloc_untyped(&env->vka, CONFIG_ROOT_RESERVE_BITS, &reserve);
+    if (error) {
+        ZF_LOGW("Not enough memory to reserve 2^%d bytes, passing a single untyped to benchmarks",
+                CONFIG_ROOT_RESERVE_BITS);
+        max_untypeds = 1;
+    }
+
+    env->n_untypeds = 0;
+    for (uint8_t size_bits = seL4_MaxUntypedBits; size_bits > seL4_PageBits && env->n_untypeds < max_untypeds;) {
+        if (vka_alloc_untyped(&env->vka, size_bits, &env->untypeds[env->n_untypeds]) == 0) {
+            env->n_untypeds++;
+        } else {
+            size_bits--;
+        }
+    }
+    ZF_LOGF_IF(env->n_untypeds == 0, "Failed to find free untyped\n");
+
+    if (!error) {
+        vka_free_object(&env->vka, &reserve);
     }
 }
 
@@ -277,8 +769,13 @@ void *main_continued(void *arg)
 
     setup_fault_handler(&global_env);
 
-    /* find an untyped for the process to use */
-    find_untyped(&global_env.vka, &global_env.untyped);
+    /* find untypeds for the processes to use */
+    find_untypeds(&global_env);
+
+    if (config_set(CONFIG_CACHE_COLOURING)) {
+        /* the shared memory and the images of the benchmark processes */
+        cache_colour_vka(&global_env.vka);
+    }
 
     /* list of benchmarks */
     benchmark_t *benchmarks[] = {
@@ -298,26 +795,58 @@ void *main_continued(void *arg)
         NULL
     };
 
-    json_t *output = json_array();
-    assert(output != NULL);
+    params_load(benchmarks);
+
+    /* once for all benchmarks, before anything else runs */
+    calibrate(&global_env);
+    order_init();
+
+    pipeline_init(&global_env);
+
+    if (config_set(CONFIG_STREAM_JSON_OUTPUT)) {
+        printf("JSON OUTPUT\n");
+        json_stream_begin(&output_stream, stdout, JSON_FLAGS);
+    } else {
+        output = json_array();
+        assert(output != NULL);
+    }
+
     int error;
+    for (int core = 0; core < calibration_cores(&global_env); core++) {
+        json_t *calibration_json = json_array();
+        assert(calibration_json != NULL);
+        error = json_array_append_new(calibration_json, calibration_to_json(&calibration[core]));
+        ZF_LOGF_IF(error != 0, "Failed to output overhead calibration");
+        if (config_set(CONFIG_PER_CORE_RUNS)) {
+            add_core_column(calibration_json, core);
+        }
+        output_results(calibration_json);
+    }
 
-    /* run the benchmarks, each with ITERATIONS consecutive runs */
+    /* run the benchmarks, each with ITERATIONS consecutive runs, on each core in turn with PerCoreRuns */
     for (int i = 0; benchmarks[i] != NULL; i++) {
         if (benchmarks[i]->enabled) {
-            for (int run = 0; run < CONFIG_ITERATIONS; run++) {
-                json_t *result = launch_benchmark(benchmarks[i], &global_env, run);
-                ZF_LOGF_IF(result == NULL, "Failed to run benchmark %s", benchmarks[i]->name);
-                add_iteration_tag(result, run);
-                error = json_array_extend(output, result);
-                ZF_LOGF_IF(error != 0, "Failed to add benchmark results");
+            int cores = run_per_core(benchmarks[i]) ? simple_get_core_count(&global_env.simple) : 1;
+            for (int core = 0; core < cores; core++) {
+                for (int run = 0; run < CONFIG_ITERATIONS; run++) {
+                    bool success = launch_benchmark(benchmarks[i], &global_env, run, core);
+                    ZF_LOGF_IF(!success, "Failed to run benchmark %s on core %d", benchmarks[i]->name, core);
+                }
             }
         }
     }
 
-    printf("JSON OUTPUT\n");
-    error = json_dumpf(output, stdout, JSON_PRESERVE_ORDER | JSON_INDENT(CONFIG_JSON_INDENT) | JSON_REAL_PRECISION(16));
-    ZF_LOGF_IF(error, "Failed to dump output");
+    /* results of the last run may still be being processed */
+    pipeline_flush();
+
+    if (config_set(CONFIG_STREAM_JSON_OUTPUT)) {
+        json_stream_end(&output_stream);
+    } else {
+        printf("JSON OUTPUT\n");
+        error = json_dumpf(output, stdout, JSON_FLAGS);
+        ZF_LOGF_IF(error, "Failed to dump output");
+        json_decref(output);
+    }
 
     printf("END JSON OUTPUT\n");
     printf("All is well in the universe.\n");
@@ -8,40 +8,66 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <utils/util.h>
+#include <utils/zf_log.h>
 
 #include "benchmark.h"
 #include "math.h"
 
-/* these functions adapted from libgsl -- require code to be GPL */
-static double results_mean(const size_t n, const ccnt_t array[n])
-{
-    size_t i;
-    long double mean = 0;
-    /* Compute the arithmetic mean of a dataset using the recurrence relation
-     * mean_(n) = mean(n-1) + (data[n] - mean(n-1))/(n+1)   */
+const double tail_percentiles[N_TAIL_PERCENTILES] = { CONFIG_TAIL_PERCENTILES };
 
-    for (i = 0; i < n; i++) {
-        mean += (array[i] - mean) / (i + 1);
+/*
+ * Statistics that need a single pass over the samples, in their original order.
+ *
+ * The mean is Welford's running mean, and the variance comes from Welford's running
+ * sum of squared differences from it. Neither overflows like the sum of squares.
+ */
+typedef struct {
+    ccnt_t min;
+    ccnt_t max;
+    ssize_t max_index;
+    long double mean;
+    long double m2;
+} single_pass_t;
+
+static single_pass_t results_single_pass(const size_t n, const ccnt_t data[n])
+{
+    single_pass_t pass = {
+        .min = data[0],
+        .max = data[0],
+        .max_index = 0,
+    };
+
+    for (size_t i = 0; i < n; i++) {
+        if (data[i] < pass.min) {
+            pass.min = data[i];
+        }
+        if (data[i] > pass.max) {
+            pass.max = data[i];
+            pass.max_index = i;
+        }
+        const long double delta = data[i] - pass.mean;
+        pass.mean += delta / (i + 1);
+        pass.m2 += delta * (data[i] - pass.mean);
     }
-    return roundl(mean);
+
+    return pass;
 }
 
-static double results_variance(const size_t n, const ccnt_t array[n], const ccnt_t mean)
+/* these functions adapted from libgsl -- require code to be GPL */
+static double results_mean(const single_pass_t *pass)
 {
-    long double variance = 0;
-
-    size_t i;
-
-    /* find the sum of the squares */
-    for (i = 0; i < n; i++) {
-        const long double delta = (long double) array[i] - (long double) mean;
-        variance += (delta * delta - variance) / (i + 1);
-    }
+    return roundl(pass->mean);
+}
 
-    return round((double) variance);
+static double results_variance(const size_t n, const single_pass_t *pass, const ccnt_t mean)
+{
+    /* the variance about the rounded mean, as reported */
+    const long double offset = pass->mean - mean;
+    return round((double)(pass->m2 / n + offset * offset));
 }
 
-static double results_stddev(const size_t n, const ccnt_t array[n], const long double variance)
+static double results_stddev(const size_t n, const long double variance)
 {
     return sqrt(variance * ((double) n / (double)(n - 1.0f)));
 }
@@ -121,36 +147,210 @@ static ccnt_t results_mode(const size_t n, const ccnt_t sorted_data[n])
     return mode;
 }
 
-static int ccnt_compare_fn(const void *a, const void *b)
+/* z value of a two sided 95% confidence interval */
+#define Z95 1.96
+
+double results_mean_ci(const size_t n, const double mean, const double stddev)
+{
+    if (n < 2) {
+        return NAN;
+    }
+    return Z95 * stddev / sqrt(n) / mean;
+}
+
+/* MSER-5: batches of 5 samples, and the fewest batches to look for a warm-up in */
+#define MSER_BATCH 5
+#define MSER_MIN_BATCHES 10
+
+bool results_warmup(const size_t n, const ccnt_t data[n], size_t *warmup, bool *steady)
+{
+    size_t batches = n / MSER_BATCH;
+    if (batches < MSER_MIN_BATCHES) {
+        return false;
+    }
+
+    /* Go through the batches from the last, keeping the sums of the means of the batches
+     * after the cut and their squares, and evaluate every cut in the first half. Samples
+     * after the last full batch are left out. */
+    long double sum = 0;
+    long double sum2 = 0;
+    long double best = INFINITY;
+    size_t best_cut = 0;
+    for (size_t cut = batches; cut-- > 0;) {
+        long double batch_mean = 0;
+        for (size_t i = cut * MSER_BATCH; i < (cut + 1) * MSER_BATCH; i++) {
+            batch_mean += data[i];
+        }
+        batch_mean /= MSER_BATCH;
+        sum += batch_mean;
+        sum2 += batch_mean * batch_mean;
+
+        if (cut <= batches / 2) {
+            size_t kept = batches - cut;
+            /* sum of squared differences from their mean of the batch means kept, over kept^2 */
+            long double mser = (sum2 - sum * sum / kept) / ((long double) kept * kept);
+            /* earlier cuts win ties, they keep more samples */
+            if (mser <= best) {
+                best = mser;
+                best_cut = cut;
+            }
+        }
+    }
+
+    /* the best cut being as late as it can be means the samples were still settling */
+    *steady = best_cut < batches / 2;
+    *warmup = best_cut * MSER_BATCH;
+    return true;
+}
+
+/*
+ * The 95% confidence interval of the median is between the order statistics whose
+ * ranks are z * sqrt(n) / 2 either side of the median, which does not assume
+ * anything about the distribution. Find their 0-based ranks.
+ */
+static void results_median_ci_ranks(const size_t n, size_t *lhs, size_t *rhs)
+{
+    const double spread = Z95 * sqrt(n) / 2;
+    /* 1-based ranks of the lower and upper bound */
+    double lower = floor(n / 2.0 - spread);
+    double upper = ceil(1 + n / 2.0 + spread);
+    *lhs = lower < 1 ? 0 : (size_t) lower - 1;
+    *rhs = upper > n ? n - 1 : (size_t) upper - 1;
+}
+
+/* Half-width of the 95% confidence interval of the median, relative to the median */
+static double results_median_ci(const size_t n, const ccnt_t sorted_data[n], const double median)
 {
-    ccnt_t first = *((ccnt_t *) a);
-    ccnt_t second = *((ccnt_t *) b);
+    if (n < 2) {
+        return NAN;
+    }
+    size_t lhs, rhs;
+    results_median_ci_ranks(n, &lhs, &rhs);
+    return (sorted_data[rhs] - sorted_data[lhs]) / 2.0 / median;
+}
+
+/*
+ * Scratch memory for sorting the samples, kept between calls so that it is only
+ * allocated again when a larger set of samples comes along.
+ */
+static ccnt_t *sort_scratch;
+static size_t sort_scratch_size;
+
+static ccnt_t *results_scratch(size_t n)
+{
+    if (n > sort_scratch_size) {
+        free(sort_scratch);
+        sort_scratch = malloc(n * sizeof(ccnt_t));
+        ZF_LOGF_IF(sort_scratch == NULL, "Failed to allocate memory to sort %zu samples", n);
+        sort_scratch_size = n;
+    }
+    return sort_scratch;
+}
+
+#define RADIX_BITS 8
+#define RADIX_BUCKETS BIT(RADIX_BITS)
+#define RADIX_DIGITS (sizeof(ccnt_t) * 8 / RADIX_BITS)
+
+/*
+ * Sort the samples with a least significant digit first radix sort, which takes
+ * linear time. The counts of all digits are taken in one pass, and digits that are
+ * the same for all samples (the top ones, for the cycle counts we measure) are
+ * skipped.
+ *
+ * @return the sorted samples, either data itself if it needs no sorting, or scratch
+ *         memory that is valid until the next call.
+ */
+static const ccnt_t *results_sort(const size_t n, const ccnt_t data[n])
+{
+    static size_t counts[RADIX_DIGITS][RADIX_BUCKETS];
+
+    memset(counts, 0, sizeof(counts));
+    for (size_t i = 0; i < n; i++) {
+        for (size_t d = 0; d < RADIX_DIGITS; d++) {
+            counts[d][(data[i] >> (d * RADIX_BITS)) & (RADIX_BUCKETS - 1)]++;
+        }
+    }
+
+    const ccnt_t *src = data;
+    ccnt_t *scratch = results_scratch(2 * n);
+    ccnt_t *dst = scratch;
+
+    for (size_t d = 0; d < RADIX_DIGITS; d++) {
+        size_t shift = d * RADIX_BITS;
+        /* skip the digit if all samples have the same value for it */
+        if (counts[d][(data[0] >> shift) & (RADIX_BUCKETS - 1)] == n) {
+            continue;
+        }
+
+        /* turn the counts into the first index of each bucket */
+        size_t index = 0;
+        for (size_t b = 0; b < RADIX_BUCKETS; b++) {
+            size_t count = counts[d][b];
+            counts[d][b] = index;
+            index += count;
+        }
+
+        for (size_t i = 0; i < n; i++) {
+            dst[counts[d][(src[i] >> shift) & (RADIX_BUCKETS - 1)]++] = src[i];
+        }
+
+        src = dst;
+        dst = dst == scratch ? scratch + n : scratch;
+    }
 
-    return (first > second) - (first < second);
+    return src;
+}
+
+result_t results_empty(void)
+{
+    result_t result = {0};
+    result.max_index = -1;
+    result.mean_ci = NAN;
+    result.median_ci = NAN;
+    for (size_t i = 0; i < N_TAIL_PERCENTILES; i++) {
+        result.tail[i] = NAN;
+    }
+    result.mean_bootstrap_low = NAN;
+    result.mean_bootstrap_high = NAN;
+    result.median_bootstrap_low = NAN;
+    result.median_bootstrap_high = NAN;
+    result.steady = true;
+    return result;
 }
 
 result_t calculate_results(const size_t n, ccnt_t data[n])
 {
-    /* create a copy of the data to sort */
-    ccnt_t sorted_data[n];
-    memcpy(sorted_data, data, n * sizeof(ccnt_t));
+    if (n == 0) {
+        return results_empty();
+    }
 
-    /* sort the data */
-    qsort(sorted_data, n, sizeof(ccnt_t), ccnt_compare_fn);
+    single_pass_t pass = results_single_pass(n, data);
+    const ccnt_t *sorted_data = results_sort(n, data);
 
     result_t result;
-    result.min = sorted_data[0];
-    result.max = sorted_data[n - 1];
+    result.min = pass.min;
+    result.max = pass.max;
     assert(result.min <= result.max);
-    result.mean = results_mean(n, sorted_data);
-    result.variance = results_variance(n, sorted_data, result.mean);
-    result.stddev = results_stddev(n, sorted_data, result.variance);
+    result.mean = results_mean(&pass);
+    result.variance = results_variance(n, &pass, result.mean);
+    result.stddev = results_stddev(n, result.variance);
     result.median = results_median(n, sorted_data);
     result.first_quantile = results_quantile(n, sorted_data, 0.25f);
     result.third_quantile = results_quantile(n, sorted_data, 0.75f);
+    for (size_t i = 0; i < N_TAIL_PERCENTILES; i++) {
+        result.tail[i] = results_quantile(n, sorted_data, tail_percentiles[i] / 100.0);
+    }
+    result.max_index = pass.max_index;
     result.mode = results_mode(n, sorted_data);
+    result.mean_ci = results_mean_ci(n, result.mean, result.stddev);
+    result.median_ci = results_median_ci(n, sorted_data, result.median);
     result.raw_data = data;
     result.samples = n;
+    result.adaptive = false;
+    result.converged = false;
+    result.warmup_detected = false;
+    result.warmup = 0;
+    result.steady = true;
 
     return result;
 }
@@ -170,13 +370,103 @@ static double results_variance_early_proc(const size_t num, const ccnt_t sum,
 
 result_t calculate_results_early_proc(ccnt_t num, ccnt_t sum, ccnt_t sum2)
 {
-    result_t result;
+    /* the median, percentiles and worst sample are not known without the samples */
+    result_t result = results_empty();
+
+    if (num == 0) {
+        return result;
+    }
 
-    memset((void *)&result, 0, sizeof(result));
     result.mean = sum / num;
     result.variance = results_variance_early_proc(num, sum, sum2, result.mean);
     result.stddev = sqrt(result.variance * ((double) num / (double)(num - 1.0f)));;
+    result.mean_ci = results_mean_ci(num, result.mean, result.stddev);
     result.samples = num;
 
     return result;
 }
+
+/* Estimate of the samples in a histogram bucket: its middle, within the known min and max */
+static double histogram_bucket_value(const histogram_t *histogram, size_t index)
+{
+    double value = histogram_bucket_low(index) + (histogram_bucket_width(index) - 1) / 2.0;
+    return MIN(MAX(value, histogram->min), histogram->max);
+}
+
+/* Estimate of the sample with 0-based rank rank, were the samples sorted */
+static double histogram_rank_value(const histogram_t *histogram, uint64_t rank)
+{
+    uint64_t seen = 0;
+    for (size_t i = 0; i < HISTOGRAM_BUCKETS; i++) {
+        seen += histogram->counts[i];
+        if (seen > rank) {
+            return histogram_bucket_value(histogram, i);
+        }
+    }
+    return histogram->max;
+}
+
+/* As results_quantile, on the histogram rather than sorted samples */
+static double histogram_quantile(const histogram_t *histogram, const double quantile)
+{
+    const uint64_t n = histogram->total;
+    const double index = quantile * (n - 1);
+    const uint64_t lhs = index;
+    const double delta = index - lhs;
+
+    if (lhs == n - 1) {
+        return histogram_rank_value(histogram, lhs);
+    }
+    return (1 - delta) * histogram_rank_value(histogram, lhs) + delta * histogram_rank_value(histogram, lhs + 1);
+}
+
+result_t calculate_results_histogram(const histogram_t *histogram)
+{
+    /* the histogram does not know when the max happened */
+    result_t result = results_empty();
+    const uint64_t n = histogram->total;
+
+    if (n == 0) {
+        return result;
+    }
+
+    result.samples = n;
+    result.min = histogram->min;
+    result.max = histogram->max;
+    result.mean = (double) histogram->sum / n;
+
+    long double variance = 0;
+    uint32_t mode_count = 0;
+    for (size_t i = 0; i < HISTOGRAM_BUCKETS; i++) {
+        if (histogram->counts[i] == 0) {
+            continue;
+        }
+        long double delta = histogram_bucket_value(histogram, i) - result.mean;
+        variance += histogram->counts[i] * delta * delta;
+        if (histogram->counts[i] > mode_count) {
+            mode_count = histogram->counts[i];
+            result.mode = histogram_bucket_value(histogram, i);
+        }
+    }
+    result.variance = variance / n;
+    result.stddev = n > 1 ? sqrt(result.variance * ((double) n / (double)(n - 1.0f))) : 0;
+
+    result.median = histogram_quantile(histogram, 0.5);
+    result.first_quantile = histogram_quantile(histogram, 0.25);
+    result.third_quantile = histogram_quantile(histogram, 0.75);
+    for (size_t i = 0; i < N_TAIL_PERCENTILES; i++) {
+        result.tail[i] = histogram_quantile(histogram, tail_percentiles[i] / 100.0);
+    }
+
+    result.mean_ci = results_mean_ci(n, result.mean, result.stddev);
+    if (n > 1) {
+        size_t lhs, rhs;
+        results_median_ci_ranks(n, &lhs, &rhs);
+        result.median_ci = (histogram_rank_value(histogram, rhs) - histogram_rank_value(histogram, lhs))
+                           / 2.0 / result.median;
+    } else {
+        result.median_ci = NAN;
+    }
+
+    return result;
+}
@@ -7,6 +7,13 @@
 #pragma once
 
 #include "benchmark.h"
+#include <histogram.h>
+
+/*
+ * The result of no samples: every statistic is 0, apart from those that cannot be
+ * told from 0 cycles, the percentiles and intervals, which are NAN.
+ */
+result_t results_empty(void);
 
 result_t calculate_results(const size_t n, ccnt_t data[n]);
 
@@ -19,6 +26,39 @@ result_t calculate_results(const size_t n, ccnt_t data[n]);
  */
 result_t calculate_results_early_proc(ccnt_t num, ccnt_t sum, ccnt_t sum2);
 
+/*
+ * Half-width of the 95% confidence interval of the mean, relative to the mean
+ * @param n - number of samples
+ * @param mean - mean of the samples
+ * @param stddev - sample standard deviation
+ */
+double results_mean_ci(const size_t n, const double mean, const double stddev);
+
+/*
+ * Find the warm-up of a series of samples with MSER-5 (White's Marginal Standard Error
+ * Rule on the means of batches of 5 samples): the cut that minimises the squared
+ * standard error of the mean of the batches after it, looking at cuts in the first
+ * half of the series.
+ * @param n - number of samples
+ * @param data - samples, in the order they were taken
+ * @param warmup - set to the number of samples to drop from the start as warm-up
+ * @param steady - set to false if the best cut is the last one looked at, i.e. the
+ *                 series did not settle in its first half
+ * @return false, leaving warmup and steady alone, if the series is too short to tell,
+ *         fewer than 10 batches
+ */
+bool results_warmup(const size_t n, const ccnt_t data[n], size_t *warmup, bool *steady);
+
+/*
+ * The function calculates parameters of samples received from a benchmark which
+ * collected them in a histogram. Unlike early processing with sums, this gives
+ * min, max, median and quartiles. Apart from min, max and mean, which are exact,
+ * these are estimated from the histogram buckets, so are only as precise as
+ * HISTOGRAM_PRECISION_BITS.
+ * @param histogram - histogram of the samples
+ */
+result_t calculate_results_histogram(const histogram_t *histogram);
+
 /* The function calculates variance using sum, sum of squared values and mean
  * @param num - number of samples
  * @param sum - sum of samples
@@ -22,7 +22,6 @@ static json_t *process_mapping_results(void *r)
 
     /* check overheads */
     result_desc_t desc = {
-        .stable = false,
         .name = "overhead",
         .ignored = 1,
         .overhead = 0
@@ -33,18 +32,19 @@ static json_t *process_mapping_results(void *r)
 
     overhead = overhead_result.min;
 
-    int nline = TESTS * NPHASE;
+    int ntests = raw_results->n_tests;
+    int nline = ntests * NPHASE;
 
     char *phase_col[nline];
     json_int_t npage_col[nline];
     for (int i = 0; i < nline; i++) {
         phase_col[i] = phase_name[i % NPHASE];
-        npage_col[i] = page_mapping_benchmark_params[i / NPHASE].npage;
+        npage_col[i] = raw_results->npage[i / NPHASE];
     }
 
     column_t extra_cols[] = {
         {
-            .header = "Num of Page Mapped",
+            .header = (char *) page_mapping_axes[0].name,
             .type = JSON_INTEGER,
             .integer_array = npage_col,
         },
@@ -55,7 +55,7 @@ static json_t *process_mapping_results(void *r)
         },
     };
 
-    result_t results[TESTS][NPHASE];
+    result_t results[ntests][NPHASE];
 
     result_set_t result_set = {
         .name = "Mapping Benchmark",
@@ -66,10 +66,10 @@ static json_t *process_mapping_results(void *r)
     };
 
     /* now calculate the results */
-    for (int i = 0; i < TESTS; i++) {
+    for (int i = 0; i < ntests; i++) {
         for (int j = 0; j < NPHASE; j++) {
             result_desc_t desc = {
-                .name = page_mapping_benchmark_params[i].name,
+                .name = phase_name[j],
                 .overhead = overhead,
                 .ignored = 1,
             };
@@ -80,12 +80,19 @@ static json_t *process_mapping_results(void *r)
 
     json_t *array = json_array();
     json_array_append_new(array, result_set_to_json(result_set));
+
+    if (config_set(CONFIG_PMU_EVENTS)) {
+        result_t events[NUM_AVERAGE_EVENTS];
+        process_average_results(PMU_ROTATIONS, NUM_AVERAGE_EVENTS, raw_results->map_unmap_events.counts, events);
+        json_array_append_new(array, average_counters_to_json("Map and unmap a page", events));
+    }
     return array;
 }
 
 static benchmark_t page_mapping_benchmark = {
     .name = "page_mapping",
     .enabled = config_set(CONFIG_APP_PAGEMAPPINGBENCH),
+    .persistent = true,
     .results_pages = BYTES_TO_SIZE_BITS_PAGES(sizeof(page_mapping_results_t),
                                               seL4_PageBits),
     .process = process_mapping_results,
@@ -0,0 +1,156 @@
+/*
+ * Copyright 2020, Data61, CSIRO (ABN 41 687 119 230)
+ *
+ * SPDX-License-Identifier: GPL-2.0-only
+ */
+#include <autoconf.h>
+#include <cpio/cpio.h>
+#include <ctype.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <utils/util.h>
+#include <utils/zf_log.h>
+
+#include "params.h"
+
+#define SWEEP_SUFFIX ".sweep"
+#define MAX_LINE_LENGTH 256
+
+extern char _cpio_archive[];
+extern char _cpio_archive_end[];
+
+/* strip leading and trailing whitespace, in place */
+static char *strip(char *str)
+{
+    while (isspace((unsigned char) *str)) {
+        str++;
+    }
+    char *end = str + strlen(str);
+    while (end > str && isspace((unsigned char) end[-1])) {
+        end--;
+    }
+    *end = '\0';
+    return str;
+}
+
+static benchmark_t *find_benchmark(benchmark_t *benchmarks[], const char *name)
+{
+    for (int i = 0; benchmarks[i] != NULL; i++) {
+        if (strcmp(benchmarks[i]->name, name) == 0) {
+            return benchmarks[i];
+        }
+    }
+    return NULL;
+}
+
+static void select_benchmarks(benchmark_t *benchmarks[], char *value)
+{
+    int n_benchmarks = 0;
+    while (benchmarks[n_benchmarks] != NULL) {
+        n_benchmarks++;
+    }
+
+    bool selected[n_benchmarks];
+    memset(selected, 0, sizeof(selected));
+    char *saveptr = NULL;
+
+    for (char *name = strtok_r(value, ",", &saveptr); name != NULL; name = strtok_r(NULL, ",", &saveptr)) {
+        name = strip(name);
+        benchmark_t *benchmark = find_benchmark(benchmarks, name);
+        ZF_LOGF_IF(benchmark == NULL, "Unknown benchmark '%s' in " PARAMS_FILE_NAME, name);
+        if (!benchmark->enabled) {
+            ZF_LOGW("Benchmark '%s' is not part of this build, skipping it", name);
+        }
+        for (int i = 0; benchmarks[i] != NULL; i++) {
+            if (benchmarks[i] == benchmark) {
+                selected[i] = true;
+            }
+        }
+    }
+
+    for (int i = 0; benchmarks[i] != NULL; i++) {
+        benchmarks[i]->enabled = benchmarks[i]->enabled && selected[i];
+    }
+}
+
+static void override_sweep(benchmark_t *benchmark, char *value)
+{
+    param_override_t *params = &benchmark->params;
+    char *saveptr = NULL;
+
+    params->n_values = 0;
+    for (char *token = strtok_r(value, ",", &saveptr); token != NULL; token = strtok_r(NULL, ",", &saveptr)) {
+        token = strip(token);
+        char *end;
+        unsigned long long v = strtoull(token, &end, 0);
+        ZF_LOGF_IF(*token == '\0' || *end != '\0', "Invalid value '%s' for %s" SWEEP_SUFFIX, token, benchmark->name);
+        ZF_LOGF_IF(params->n_values == SEL4BENCH_MAX_PARAMS, "More than %d values for %s" SWEEP_SUFFIX,
+                   SEL4BENCH_MAX_PARAMS, benchmark->name);
+        params->values[params->n_values++] = v;
+    }
+}
+
+static void apply_param(benchmark_t *benchmarks[], char *key, char *value)
+{
+    if (strcmp(key, "benchmarks") == 0) {
+        select_benchmarks(benchmarks, value);
+        return;
+    }
+
+    size_t key_len = strlen(key);
+    size_t suffix_len = strlen(SWEEP_SUFFIX);
+    if (key_len > suffix_len && strcmp(key + key_len - suffix_len, SWEEP_SUFFIX) == 0) {
+        key[key_len - suffix_len] = '\0';
+        benchmark_t *benchmark = find_benchmark(benchmarks, key);
+        ZF_LOGF_IF(benchmark == NULL, "Unknown benchmark '%s' in " PARAMS_FILE_NAME, key);
+        override_sweep(benchmark, value);
+        return;
+    }
+
+    ZF_LOGF("Unknown parameter '%s' in " PARAMS_FILE_NAME, key);
+}
+
+void params_load(benchmark_t *benchmarks[])
+{
+    unsigned long size = 0;
+    const char *file = cpio_get_file(_cpio_archive, _cpio_archive_end - _cpio_archive, PARAMS_FILE_NAME, &size);
+    if (file == NULL) {
+        return;
+    }
+
+    printf("Applying parameters from " PARAMS_FILE_NAME "\n");
+
+    unsigned long pos = 0;
+    while (pos < size) {
+        char line[MAX_LINE_LENGTH];
+        size_t len = 0;
+
+        while (pos < size && file[pos] != '\n') {
+            ZF_LOGF_IF(len == MAX_LINE_LENGTH - 1, "Line too long in " PARAMS_FILE_NAME);
+            line[len++] = file[pos++];
+        }
+        /* skip the newline */
+        pos++;
+        line[len] = '\0';
+
+        char *comment = strchr(line, '#');
+        if (comment != NULL) {
+            *comment = '\0';
+        }
+
+        char *key = strip(line);
+        if (*key == '\0') {
+            continue;
+        }
+
+        char *value = strchr(key, '=');
+        ZF_LOGF_IF(value == NULL, "Expected 'key = value' in " PARAMS_FILE_NAME ", got '%s'", key);
+        *value++ = '\0';
+
+        key = strip(key);
+        value = strip(value);
+        printf("  %s = %s\n", key, value);
+        apply_param(benchmarks, key, value);
+    }
+}
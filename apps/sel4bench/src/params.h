@@ -0,0 +1,31 @@
+/*
+ * Copyright 2020, Data61, CSIRO (ABN 41 687 119 230)
+ *
+ * SPDX-License-Identifier: GPL-2.0-only
+ */
+
+#pragma once
+
+#include "benchmark.h"
+
+/* name of the parameter file in the CPIO archive */
+#define PARAMS_FILE_NAME "sel4bench.params"
+
+/*
+ * Apply the parameter file from the CPIO archive, if the image was built with one
+ * (see Sel4benchParamsFile). This allows to change which benchmarks run and what
+ * they sweep over without rebuilding the kernel or the benchmarks.
+ *
+ * The file consists of "key = value" lines. Empty lines and anything after a '#'
+ * are ignored. The keys are:
+ *
+ *  benchmarks     comma separated names of the benchmarks to run. Only benchmarks
+ *                 that are enabled in the build can be selected.
+ *  <name>.sweep   comma separated values that replace the default sweep of the
+ *                 benchmark called <name>, at most SEL4BENCH_MAX_PARAMS. What the
+ *                 values mean is up to the benchmark, see the benchmark's header
+ *                 in libsel4benchsupport.
+ *
+ * @param benchmarks NULL terminated list of all benchmarks.
+ */
+void params_load(benchmark_t *benchmarks[]);
@@ -0,0 +1,134 @@
+/*
+ * Copyright 2020, Data61, CSIRO (ABN 41 687 119 230)
+ *
+ * SPDX-License-Identifier: GPL-2.0-only
+ */
+
+#include <autoconf.h>
+#include <sel4benchapp/gen_config.h>
+#include <sel4utils/thread.h>
+#include <sel4utils/thread_config.h>
+#include <sync/bin_sem.h>
+#include <utils/util.h>
+
+#include "pipeline.h"
+
+static struct {
+    /* is the worker thread running */
+    bool active;
+    /* core the worker runs on */
+    int core;
+    sel4utils_thread_t thread;
+    /* held while allocating memory or printing */
+    sync_bin_sem_t lock;
+    /* posted by the main thread when a job has been submitted */
+    sync_bin_sem_t ready;
+    /* posted by the worker when it has finished the job */
+    sync_bin_sem_t done;
+    /* is a job in flight, only used by the main thread */
+    bool busy;
+    pipeline_job_fn_t fn;
+    void *arg;
+} pipeline;
+
+static void worker_fn(UNUSED void *arg0, UNUSED void *arg1, UNUSED void *ipc_buf)
+{
+    while (true) {
+        sync_bin_sem_wait(&pipeline.ready);
+        sync_bin_sem_wait(&pipeline.lock);
+        pipeline.fn(pipeline.arg);
+        sync_bin_sem_post(&pipeline.lock);
+        sync_bin_sem_post(&pipeline.done);
+    }
+}
+
+void pipeline_init(env_t *env)
+{
+    if (!config_set(CONFIG_PIPELINE_PROCESSING)) {
+        return;
+    }
+
+    int cores = simple_get_core_count(&env->simple);
+    if (cores < 2) {
+        ZF_LOGW("Pipelined processing needs a second core, processing results in series");
+        return;
+    }
+
+    int error = sync_bin_sem_new(&env->vka, &pipeline.lock, 1);
+    ZF_LOGF_IF(error, "Failed to create pipeline lock");
+    error = sync_bin_sem_new(&env->vka, &pipeline.ready, 0);
+    ZF_LOGF_IF(error, "Failed to create pipeline semaphore");
+    error = sync_bin_sem_new(&env->vka, &pipeline.done, 0);
+    ZF_LOGF_IF(error, "Failed to create pipeline semaphore");
+
+    /* benchmarks run on core 0, process on the last core */
+    sel4utils_thread_config_t config = thread_config_new(&env->simple);
+    config = thread_config_priority(config, seL4_MaxPrio);
+    config = thread_config_mcp(config, seL4_MaxPrio);
+    config = thread_config_auth(config, simple_get_tcb(&env->simple));
+#ifdef CONFIG_KERNEL_MCS
+    config.sched_params = sched_params_round_robin(config.sched_params, &env->simple, cores - 1,
+                                                   CONFIG_BOOT_THREAD_TIME_SLICE * NS_IN_US);
+#else
+    config.sched_params.core = cores - 1;
+#endif
+    config = thread_config_create_reply(config);
+    error = sel4utils_configure_thread_config(&env->vka, &env->vspace, &env->vspace, config, &pipeline.thread);
+    ZF_LOGF_IF(error, "Failed to configure pipeline worker");
+    NAME_THREAD(pipeline.thread.tcb.cptr, "sel4bench-pipeline");
+
+    error = sel4utils_set_sched_affinity(&pipeline.thread, config.sched_params);
+    ZF_LOGF_IF(error, "Failed to move pipeline worker to core %d", cores - 1);
+
+    error = sel4utils_start_thread(&pipeline.thread, worker_fn, NULL, NULL, true);
+    ZF_LOGF_IF(error, "Failed to start pipeline worker");
+
+    pipeline.core = cores - 1;
+    pipeline.active = true;
+}
+
+bool pipeline_active(void)
+{
+    return pipeline.active;
+}
+
+bool pipeline_on_core(int core)
+{
+    return pipeline.active && pipeline.core == core;
+}
+
+void pipeline_submit(pipeline_job_fn_t fn, void *arg)
+{
+    if (!pipeline.active) {
+        fn(arg);
+        return;
+    }
+
+    pipeline_flush();
+    pipeline.fn = fn;
+    pipeline.arg = arg;
+    pipeline.busy = true;
+    sync_bin_sem_post(&pipeline.ready);
+}
+
+void pipeline_flush(void)
+{
+    if (pipeline.busy) {
+        sync_bin_sem_wait(&pipeline.done);
+        pipeline.busy = false;
+    }
+}
+
+void pipeline_lock(void)
+{
+    if (pipeline.active) {
+        sync_bin_sem_wait(&pipeline.lock);
+    }
+}
+
+void pipeline_unlock(void)
+{
+    if (pipeline.active) {
+        sync_bin_sem_post(&pipeline.lock);
+    }
+}
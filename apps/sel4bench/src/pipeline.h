@@ -0,0 +1,53 @@
+/*
+ * Copyright 2020, Data61, CSIRO (ABN 41 687 119 230)
+ *
+ * SPDX-License-Identifier: GPL-2.0-only
+ */
+
+#pragma once
+
+#include <stdbool.h>
+
+#include "env.h"
+
+/*
+ * Pipelined processing of results (see PipelineProcessing).
+ *
+ * A worker thread of the root task, pinned to the last core, runs jobs (processing
+ * and outputting the results of a benchmark run) while the main thread goes ahead
+ * with the next run. Only one job is in flight at a time: submitting a job first
+ * waits for the previous one to finish.
+ *
+ * The root task's C library, vka and vspace are not thread safe, so both threads
+ * hold the pipeline lock while they may allocate memory or print. The worker holds
+ * it for a whole job, so the main thread only runs alongside it while waiting for a
+ * benchmark that does not need any of those services, e.g. a persistent benchmark
+ * between iterations.
+ *
+ * Without PipelineProcessing, or on a single core, jobs run synchronously in
+ * pipeline_submit and the lock does nothing.
+ */
+
+typedef void (*pipeline_job_fn_t)(void *arg);
+
+/* Start the worker thread, if pipelined processing is enabled */
+void pipeline_init(env_t *env);
+
+/* Do jobs run on the worker thread? */
+bool pipeline_active(void);
+
+/* Does the worker thread run on core? */
+bool pipeline_on_core(int core);
+
+/*
+ * Run fn(arg) on the worker thread, once the previous job has finished. arg, and
+ * anything the job uses, must stay valid until the job has finished (see
+ * pipeline_flush).
+ */
+void pipeline_submit(pipeline_job_fn_t fn, void *arg);
+
+/* Wait for the job in flight, if any, to finish */
+void pipeline_flush(void);
+
+void pipeline_lock(void);
+void pipeline_unlock(void);
@@ -80,7 +80,6 @@ static json_t *process_vcpu_results(void *r)
 
     result_desc_t all_bms_result_desc = {
         /* We already check for outlier results in the benchmark app. */
-        .stable = false,
         .name = "VCPU benchmark",
         /* The overhead here is the overhead of the cycle counter register
          * read operation and not the overhead of the extra code paths which
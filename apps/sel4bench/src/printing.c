@@ -10,7 +10,6 @@
 
 #include "benchmark.h"
 #include "printing.h"
-#include "ipc.h"
 
 void print_all(int size, ccnt_t array[size])
 {
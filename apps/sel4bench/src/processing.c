@@ -5,13 +5,251 @@
  */
 
 #include <benchmark.h>
+#include <math.h>
+#include <prng.h>
+#include <stdlib.h>
 #include <utils/zf_log.h>
 #include <utils/config.h>
 
-#include "ipc.h"
 #include "processing.h"
 #include "math.h"
-#include "printing.h"
+
+/* The bootstrap uses a fixed seed, so the same samples always give the same intervals */
+#define BOOTSTRAP_SEED 0x5e14be4cull
+
+/*
+ * Memory for copies of raw data that results point to, e.g. the columns of
+ * process_average_results. It is kept until processing_release, once the results
+ * have been turned into JSON.
+ */
+typedef struct raw_block {
+    struct raw_block *next;
+    ccnt_t data[];
+} raw_block_t;
+
+static raw_block_t *raw_blocks;
+
+static ccnt_t *raw_alloc(size_t n)
+{
+    raw_block_t *block = malloc(sizeof(raw_block_t) + n * sizeof(ccnt_t));
+    ZF_LOGF_IF(block == NULL, "Failed to allocate memory for %zu results", n);
+    block->next = raw_blocks;
+    raw_blocks = block;
+    return block->data;
+}
+
+void processing_release(void)
+{
+    while (raw_blocks != NULL) {
+        raw_block_t *next = raw_blocks->next;
+        free(raw_blocks);
+        raw_blocks = next;
+    }
+}
+
+static int double_compare_fn(const void *a, const void *b)
+{
+    double first = *((double *) a);
+    double second = *((double *) b);
+
+    return (first > second) - (first < second);
+}
+
+/* Find the k-th smallest value in array, partially reordering it */
+static ccnt_t select_kth(size_t n, ccnt_t array[n], size_t k)
+{
+    size_t lo = 0;
+    size_t hi = n - 1;
+
+    while (lo < hi) {
+        ccnt_t pivot = array[lo + (hi - lo) / 2];
+        size_t i = lo;
+        size_t j = hi;
+        /* partition into [lo, j] <= pivot and [i, hi] >= pivot */
+        while (i <= j) {
+            while (array[i] < pivot) {
+                i++;
+            }
+            while (array[j] > pivot) {
+                j--;
+            }
+            if (i <= j) {
+                ccnt_t tmp = array[i];
+                array[i] = array[j];
+                array[j] = tmp;
+                i++;
+                if (j == 0) {
+                    break;
+                }
+                j--;
+            }
+        }
+        if (k <= j) {
+            hi = j;
+        } else if (k >= i) {
+            lo = i;
+        } else {
+            /* everything between j and i is the pivot */
+            return pivot;
+        }
+    }
+
+    return array[k];
+}
+
+/* Median of the values in array, partially reordering it */
+static double select_median(size_t n, ccnt_t array[n])
+{
+    const size_t lhs = (n - 1) / 2;
+    const size_t rhs = n / 2;
+
+    ccnt_t median = select_kth(n, array, lhs);
+    if (lhs == rhs) {
+        return median;
+    }
+
+    /* the values after lhs are all at least the median, find the smallest */
+    ccnt_t next = array[rhs];
+    for (size_t i = rhs + 1; i < n; i++) {
+        next = MIN(next, array[i]);
+    }
+    return (median + next) / 2.0;
+}
+
+/* As results_quantile in math.c, for sorted doubles */
+static double sorted_quantile(size_t n, double sorted[n], double quantile)
+{
+    const double index = quantile * (n - 1);
+    const size_t lhs = index;
+    const double delta = index - lhs;
+
+    if (lhs == n - 1) {
+        return sorted[lhs];
+    }
+    return (1 - delta) * sorted[lhs] + delta * sorted[lhs + 1];
+}
+
+/*
+ * Scratch memory for the bootstrap, kept from one result to the next rather than
+ * allocated for each.
+ */
+static struct {
+    ccnt_t *resample;
+    size_t resample_size;
+    double *means;
+    double *medians;
+} bootstrap_scratch;
+
+static void bootstrap_scratch_reserve(size_t m)
+{
+    if (bootstrap_scratch.means == NULL) {
+        bootstrap_scratch.means = malloc(CONFIG_BOOTSTRAP_RESAMPLES * sizeof(double));
+        bootstrap_scratch.medians = malloc(CONFIG_BOOTSTRAP_RESAMPLES * sizeof(double));
+        ZF_LOGF_IF(bootstrap_scratch.means == NULL || bootstrap_scratch.medians == NULL,
+                   "Failed to allocate bootstrap memory");
+    }
+    if (m > bootstrap_scratch.resample_size) {
+        free(bootstrap_scratch.resample);
+        bootstrap_scratch.resample = malloc(m * sizeof(ccnt_t));
+        ZF_LOGF_IF(bootstrap_scratch.resample == NULL, "Failed to allocate bootstrap memory");
+        bootstrap_scratch.resample_size = m;
+    }
+}
+
+/*
+ * Estimate the 95% confidence intervals of the mean and median by resampling the
+ * samples with replacement CONFIG_BOOTSTRAP_RESAMPLES times (percentile bootstrap).
+ * Unlike the intervals in calculate_results, this does not assume anything about
+ * the distribution of the samples.
+ *
+ * Resamples have at most CONFIG_BOOTSTRAP_MAX_SAMPLES samples, so that the cost does
+ * not grow with the number of samples beyond that. With m < n samples per resample
+ * (m out of n bootstrap), the spread of the resampled statistics around the
+ * statistic of all samples is scaled by sqrt(m / n), as the spread of a mean or
+ * median shrinks with the square root of the number of samples. The spread of the
+ * means is taken around the exact mean of the samples, not the rounded one reported.
+ */
+static void result_bootstrap(result_t *result, size_t n, ccnt_t array[n])
+{
+    const size_t resamples = CONFIG_BOOTSTRAP_RESAMPLES;
+
+    result->mean_bootstrap_low = NAN;
+    result->mean_bootstrap_high = NAN;
+    result->median_bootstrap_low = NAN;
+    result->median_bootstrap_high = NAN;
+
+    if (resamples == 0 || n < 2) {
+        return;
+    }
+
+    const size_t m = MIN(n, (size_t) CONFIG_BOOTSTRAP_MAX_SAMPLES);
+    bootstrap_scratch_reserve(m);
+    ccnt_t *resample = bootstrap_scratch.resample;
+    double *means = bootstrap_scratch.means;
+    double *medians = bootstrap_scratch.medians;
+
+    long double total = 0;
+    for (size_t i = 0; i < n; i++) {
+        total += array[i];
+    }
+    const double mean = total / n;
+
+    prng_t prng;
+    prng_seed(&prng, BOOTSTRAP_SEED);
+
+    for (size_t r = 0; r < resamples; r++) {
+        long double sum = 0;
+        for (size_t i = 0; i < m; i++) {
+            resample[i] = array[prng_below(&prng, n)];
+            sum += resample[i];
+        }
+        means[r] = sum / m;
+        medians[r] = select_median(m, resample);
+    }
+
+    qsort(means, resamples, sizeof(double), double_compare_fn);
+    qsort(medians, resamples, sizeof(double), double_compare_fn);
+
+    const double scale = sqrt((double) m / n);
+    result->mean_bootstrap_low = mean + (sorted_quantile(resamples, means, 0.025) - mean) * scale;
+    result->mean_bootstrap_high = mean + (sorted_quantile(resamples, means, 0.975) - mean) * scale;
+    result->median_bootstrap_low = result->median +
+                                   (sorted_quantile(resamples, medians, 0.025) - result->median) * scale;
+    result->median_bootstrap_high = result->median +
+                                    (sorted_quantile(resamples, medians, 0.975) - result->median) * scale;
+}
+
+/*
+ * Count the samples beyond Tukey's fences. The inner fences are 1.5 times the
+ * interquartile range below the 1st and above the 3rd quartile, the outer fences
+ * 3 times. Samples between the inner and outer fences are mild outliers, those
+ * beyond the outer fences severe outliers.
+ */
+static void result_outliers(result_t *result, size_t n, ccnt_t array[n])
+{
+    const double iqr = result->third_quantile - result->first_quantile;
+
+    result->mild_outliers = 0;
+    result->severe_outliers = 0;
+
+    for (size_t i = 0; i < n; i++) {
+        if (array[i] < result->first_quantile - 3 * iqr || array[i] > result->third_quantile + 3 * iqr) {
+            result->severe_outliers++;
+        } else if (array[i] < result->first_quantile - 1.5 * iqr ||
+                   array[i] > result->third_quantile + 1.5 * iqr) {
+            result->mild_outliers++;
+        }
+    }
+}
+
+/* Calculate the results of samples, including those only available from raw samples */
+static result_t calculate_results_robust(size_t n, ccnt_t array[n])
+{
+    result_t result = calculate_results(n, array);
+    result_bootstrap(&result, n, array);
+    result_outliers(&result, n, array);
+    return result;
+}
 
 void process_average_results(int rows, int cols, ccnt_t array[rows][cols], result_t results[cols])
 {
@@ -26,41 +264,54 @@ void process_average_results(int rows, int cols, ccnt_t array[rows][cols], resul
     for (int col = 0; col < cols; col++) {
         /* create an array of the specific column we want to process - we can't reorganise the data structure as
          * the 2D array is arranged to minimise benchmark impact such that we write to sequential memory addresses in each loop of the benchmark,
-         * additionally we calloc the copy such that the raw data pointed to by the result does not exist on the stack. A different approach will be
-         * required if we run out of memory */
-        ccnt_t *raw_data = calloc(rows, sizeof(ccnt_t));
-        assert(raw_data != NULL);
+         * additionally the copy is on the heap such that the raw data pointed to by the result does not exist on the stack. It is freed
+         * by processing_release once the results have been converted to JSON */
+        ccnt_t *raw_data = raw_alloc(rows);
 
         for (int i = 0; i < rows; i++) {
             raw_data[i] = array[i][col];
         }
 
-        results[col] = calculate_results(rows, raw_data);
+        results[col] = calculate_results_robust(rows, raw_data);
     }
 }
 
 result_t process_result(size_t n, ccnt_t array[n], result_desc_t desc)
 {
-    array = &array[desc.ignored];
-    int size = n - desc.ignored;
-
-    if (desc.stable && !results_stable(array, size)) {
-        ZF_LOGW("%s cycles are not stable\n", desc.name == NULL ? "unknown" : desc.name);
-        if (ZF_LOG_LEVEL <= ZF_LOG_VERBOSE) {
-            print_all(size, array);
-        }
-        if (!config_set(CONFIG_ALLOW_UNSTABLE_OVERHEAD)) {
-            return (result_t) {
-                0
-            };
-        }
+    size_t ignored = desc.ignored;
+    bool steady = true;
+    size_t warmup;
+    /* too short a series to tell keeps the fixed warm-up, with its steady state unknown */
+    bool detect = config_set(CONFIG_WARMUP_DETECTION) && results_warmup(n, array, &warmup, &steady);
+    if (detect) {
+        /* the samples the benchmark ignores are known to be warm-up, e.g. the first
+         * run of a path, whatever the series looks like after them */
+        ignored = MAX(ignored, warmup);
     }
 
+    array = &array[ignored];
+    int size = n - ignored;
+
     for (int i = 0; i < size; i++) {
         array[i] -= desc.overhead;
     }
 
-    return calculate_results(size, array);
+    result_t result = calculate_results_robust(size, array);
+    result.warmup_detected = detect;
+    result.warmup = ignored;
+    result.steady = steady;
+    return result;
+}
+
+result_t process_result_pooled(size_t n, ccnt_t array[n])
+{
+    result_t result = calculate_results(n, array);
+    result.mean_bootstrap_low = NAN;
+    result.mean_bootstrap_high = NAN;
+    result.median_bootstrap_low = NAN;
+    result.median_bootstrap_high = NAN;
+    result_outliers(&result, n, array);
+    return result;
 }
 
 result_t process_result_early_proc(ccnt_t num, ccnt_t sum, ccnt_t sum2)
@@ -68,6 +319,11 @@ result_t process_result_early_proc(ccnt_t num, ccnt_t sum, ccnt_t sum2)
     return calculate_results_early_proc(num, sum, sum2);
 }
 
+result_t process_result_histogram(const histogram_t *histogram)
+{
+    return calculate_results_histogram(histogram);
+}
+
 void process_results(size_t ncols, size_t nrows, ccnt_t array[ncols][nrows], result_desc_t desc,
                      result_t results[ncols])
 {
@@ -83,3 +339,40 @@ void process_results_early_proc(ccnt_t ncols, ccnt_t nums[ncols], ccnt_t sums[nc
         results[i] = process_result_early_proc(nums[i], sums[i], sum2s[i]);
     }
 }
+
+void result_accumulate(result_accumulator_t *acc, size_t n, ccnt_t samples[n])
+{
+    for (size_t i = 0; i < n; i++) {
+        if (acc->samples == 0 || samples[i] < acc->min) {
+            acc->min = samples[i];
+        }
+        if (acc->samples == 0 || samples[i] > acc->max) {
+            acc->max = samples[i];
+        }
+        /* Welford's method, which unlike sum and sum of squares does not overflow */
+        acc->samples++;
+        double delta = samples[i] - acc->mean;
+        acc->mean += delta / acc->samples;
+        acc->m2 += delta * (samples[i] - acc->mean);
+    }
+}
+
+result_t process_result_accumulated(result_accumulator_t *acc, ccnt_t overhead)
+{
+    result_t result = results_empty();
+
+    if (acc->samples == 0) {
+        return result;
+    }
+
+    result.samples = acc->samples;
+    result.min = acc->min - overhead;
+    result.max = acc->max - overhead;
+    result.mean = acc->mean - overhead;
+    result.variance = acc->m2 / acc->samples;
+    result.stddev = acc->samples > 1 ? sqrt(acc->m2 / (acc->samples - 1)) : 0;
+    result.mean_ci = results_mean_ci(acc->samples, result.mean, result.stddev);
+    /* the median, percentiles and worst sample stay unknown, as the samples were not kept */
+
+    return result;
+}
@@ -7,6 +7,18 @@
 #pragma once
 
 #include "benchmark.h"
+#include <histogram.h>
+
+/* Running statistics of samples that are consumed in batches (e.g. from a sample
+ * ring) rather than kept in memory. Zero initialise before use. */
+typedef struct {
+    size_t samples;
+    double mean;
+    /* sum of squared differences from the mean */
+    double m2;
+    ccnt_t min;
+    ccnt_t max;
+} result_accumulator_t;
 
 /*
  * Compute the variance, standard deviation, mean, min and max for a set of values.
@@ -17,6 +29,17 @@
  */
 result_t process_result(size_t n, ccnt_t array[n], result_desc_t desc);
 
+/*
+ * As process_result, for the samples of several runs that were each processed with
+ * process_result already, one after the other. Nothing is ignored or subtracted, and
+ * there is no bootstrap, as the caller can combine the intervals of the runs instead
+ * (see iterations.c). The median, percentiles and outliers are those of all samples.
+ *
+ * @param n     number of values to process
+ * @param array values to compute results for.
+ */
+result_t process_result_pooled(size_t n, ccnt_t array[n]);
+
 /* Compute the variance, standard deviation, mean for a set of values
  * for benchmarks using Early Processing methodology
  * @param num   number of values to process
@@ -25,6 +48,12 @@ result_t process_result(size_t n, ccnt_t array[n], result_desc_t desc);
  */
 result_t process_result_early_proc(ccnt_t num, ccnt_t sum, ccnt_t sum2);
 
+/* Compute the variance, standard deviation, mean, min, max, median and quartiles
+ * for a set of values collected in a histogram (see histogram.h)
+ * @param histogram histogram of the values
+ */
+result_t process_result_histogram(const histogram_t *histogram);
+
 /**
  * @param ncols    size of the 1st dimension of array.
  * @param nrows    size of the 2nd dimension of the array.
@@ -51,6 +80,12 @@ void process_results(size_t ncols, size_t nrows, ccnt_t array[ncols][nrows], res
  */
 void process_average_results(int rows, int cols, ccnt_t array[rows][cols], result_t results[cols]);
 
+/*
+ * Free the copies of raw data made while processing (e.g. by process_average_results).
+ * Call once the results pointing to them are no longer needed.
+ */
+void processing_release(void);
+
 /* Process a set of early processing results. Compute the variance, standard deviation, mean for each set of values
  * for benchmarks using Early Processing methodology
  * @param ncols   number of values in each array
@@ -61,3 +96,22 @@ void process_average_results(int rows, int cols, ccnt_t array[rows][cols], resul
  */
 void process_results_early_proc(ccnt_t ncols, ccnt_t nums[ncols], ccnt_t sums[ncols], ccnt_t sum2s[ncols],
                                 result_t results[ncols]);
+
+/*
+ * Add a batch of samples to an accumulator.
+ *
+ * @param acc     accumulator to update.
+ * @param n       number of samples.
+ * @param samples samples to add.
+ */
+void result_accumulate(result_accumulator_t *acc, size_t n, ccnt_t samples[n]);
+
+/*
+ * Compute the variance, standard deviation, mean, min and max of the samples added
+ * to an accumulator. As the samples are not kept, there are no order statistics
+ * or raw data.
+ *
+ * @param acc      accumulator to compute results for.
+ * @param overhead overhead to subtract from each sample.
+ */
+result_t process_result_accumulated(result_accumulator_t *acc, ccnt_t overhead);
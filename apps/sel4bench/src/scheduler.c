@@ -9,12 +9,28 @@
 
 #include <scheduler.h>
 #include <stdio.h>
+#include <stdlib.h>
 
-static void process_yield_results(scheduler_results_t *results, ccnt_t overhead, json_t *array)
+/* the events of each of n rows, for the events of a result set (see pmu.h), to free
+ * once output. NULL without CONFIG_PMU_EVENTS */
+static result_t *process_events(int n, pmu_results_t events[n])
+{
+    if (!config_set(CONFIG_PMU_EVENTS)) {
+        return NULL;
+    }
+    result_t *results = malloc(n * NUM_AVERAGE_EVENTS * sizeof(result_t));
+    ZF_LOGF_IF(results == NULL, "Failed to allocate events");
+    for (int i = 0; i < n; i++) {
+        process_average_results(PMU_ROTATIONS, NUM_AVERAGE_EVENTS, events[i].counts, &results[i * NUM_AVERAGE_EVENTS]);
+    }
+    return results;
+}
+
+static void process_yield_results(scheduler_results_t *results, const overhead_t *overhead, json_t *array)
 {
     result_desc_t desc = {
         .ignored = N_IGNORED,
-        .overhead = overhead,
+        .overhead = overhead->value,
     };
 
     result_t result;
@@ -23,10 +39,14 @@ static void process_yield_results(scheduler_results_t *results, ccnt_t overhead,
         .n_extra_cols = 0,
         .results = &result,
         .n_results = 1,
+        .overhead_estimated = !overhead->stable,
     };
 
     result = process_result(N_RUNS, results->thread_yield, desc);
+    set.events = process_events(1, &results->thread_yield_events);
     json_array_append_new(array, result_set_to_json(set));
+    free(set.events);
+    set.events = NULL;
 
     set.name = "Thread yield (early processing)";
     result = process_result_early_proc(results->thread_yield_ep_num, results->thread_yield_ep_sum,
@@ -35,7 +55,10 @@ static void process_yield_results(scheduler_results_t *results, ccnt_t overhead,
 
     set.name = "Process yield";
     result = process_result(N_RUNS, results->process_yield, desc);
+    set.events = process_events(1, &results->process_yield_events);
     json_array_append_new(array, result_set_to_json(set));
+    free(set.events);
+    set.events = NULL;
 
     set.name = "Process yield (early processing)";
     result = process_result_early_proc(results->process_yield_ep_num, results->process_yield_ep_sum,
@@ -50,11 +73,12 @@ static void process_yield_results(scheduler_results_t *results, ccnt_t overhead,
 
 static void process_scheduler_results(scheduler_results_t *results, json_t *array)
 {
+    const overhead_t *overhead = &results->calibration.overheads[CALIBRATION_SIGNAL];
     result_desc_t desc = {
-        .stable = true,
         .name = "Signal overhead",
         .ignored = N_IGNORED
     };
+    /* the overhead the benchmark measured itself, for reference */
     result_t result = process_result(N_RUNS, results->overhead_signal, desc);
     result_t per_prio_result[N_PRIOS];
 
@@ -68,8 +92,8 @@ static void process_scheduler_results(scheduler_results_t *results, json_t *arra
     json_array_append_new(array, result_set_to_json(set));
 
     /* thread switch overhead */
-    desc.stable = false;
-    desc.overhead = result.min;
+    desc.overhead = overhead->value;
+    set.overhead_estimated = !overhead->stable;
 
     process_results(N_PRIOS, N_RUNS, results->thread_results, desc, per_prio_result);
 
@@ -91,7 +115,10 @@ static void process_scheduler_results(scheduler_results_t *results, json_t *arra
     set.n_extra_cols = 1,
     set.results = per_prio_result,
     set.n_results = N_PRIOS,
+    set.events = process_events(N_PRIOS, results->thread_events);
     json_array_append_new(array, result_set_to_json(set));
+    free(set.events);
+    set.events = NULL;
 
     /* signal to thread of higher prio (early processing) */
     result_t per_prio_result_ep[N_PRIOS];
@@ -104,7 +131,11 @@ static void process_scheduler_results(scheduler_results_t *results, json_t *arra
 
     set.name = "Signal to process of higher prio";
     process_results(N_PRIOS, N_RUNS, results->process_results, desc, per_prio_result);
+    set.results = per_prio_result;
+    set.events = process_events(N_PRIOS, results->process_events);
     json_array_append_new(array, result_set_to_json(set));
+    free(set.events);
+    set.events = NULL;
 
     /* signal to process of higher prio (early processing) */
     process_results_early_proc(N_PRIOS, results->process_results_ep_num, results->process_results_ep_sum,
@@ -123,16 +154,17 @@ static void process_scheduler_results(scheduler_results_t *results, json_t *arra
 static json_t *scheduler_process(void *results)
 {
     scheduler_results_t *raw_results = results;
+    ZF_LOGF_IF(!raw_results->calibration.valid, "scheduler benchmark did not record its overheads");
     json_t *array = json_array();
 
     process_scheduler_results(raw_results, array);
 
     result_desc_t desc = {
         .name = "Read ccnt overhead",
-        .stable = true,
         .ignored = N_IGNORED,
     };
 
+    /* the overhead the benchmark measured itself, for reference */
     result_t ccnt_overhead = process_result(N_RUNS, raw_results->overhead_ccnt, desc);
 
     result_set_t set = {
@@ -144,7 +176,7 @@ static json_t *scheduler_process(void *results)
 
     json_array_append_new(array, result_set_to_json(set));
 
-    process_yield_results(raw_results, ccnt_overhead.min, array);
+    process_yield_results(raw_results, &raw_results->calibration.overheads[CALIBRATION_CCNT], array);
 
     return array;
 }
@@ -152,6 +184,7 @@ static json_t *scheduler_process(void *results)
 static benchmark_t sched_benchmark = {
     .name = "scheduler",
     .enabled = config_set(CONFIG_APP_SCHEDULERBENCH),
+    .per_core = true,
     .results_pages = BYTES_TO_SIZE_BITS_PAGES(sizeof(scheduler_results_t), seL4_PageBits),
     .process = scheduler_process,
     .init = blank_init
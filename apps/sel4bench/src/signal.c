@@ -13,13 +13,15 @@
 static json_t *signal_process(void *results)
 {
     signal_results_t *raw_results = results;
+    const overhead_t *overhead = &raw_results->calibration.overheads[CALIBRATION_SIGNAL];
+    ZF_LOGF_IF(!raw_results->calibration.valid, "signal benchmark did not record its overheads");
 
     result_desc_t desc = {
-        .stable = true,
         .name = "signal overhead",
         .ignored = N_IGNORED
     };
 
+    /* the overhead the benchmark measured itself, for reference */
     result_t result = process_result(N_RUNS, raw_results->overhead, desc);
 
     result_set_t set = {
@@ -32,8 +34,8 @@ static json_t *signal_process(void *results)
     json_t *array = json_array();
     json_array_append_new(array, result_set_to_json(set));
 
-    desc.stable = false;
-    desc.overhead = result.min;
+    desc.overhead = overhead->value;
+    set.overhead_estimated = !overhead->stable;
 
     result = process_result_early_proc(raw_results->lo_num,
                                        raw_results->lo_sum, raw_results->lo_sum2);
@@ -41,16 +43,29 @@ static json_t *signal_process(void *results)
     set.name = "Signal to high prio thread (early processing)";
     json_array_append_new(array, result_set_to_json(set));
 
+    result = process_result_histogram(&raw_results->lo_histogram);
+    set.name = "Signal to high prio thread (histogram)";
+    json_array_append_new(array, result_set_to_json(set));
+
+    result_t events[NUM_AVERAGE_EVENTS];
     result = process_result(N_RUNS, raw_results->lo_prio_results, desc);
     set.name = "Signal to high prio thread";
+    if (config_set(CONFIG_PMU_EVENTS)) {
+        process_average_results(PMU_ROTATIONS, NUM_AVERAGE_EVENTS, raw_results->lo_prio_events.counts, events);
+        set.events = events;
+    }
     json_array_append_new(array, result_set_to_json(set));
 
+    /* the averages below count the events of the same signals */
+    result_t average_results[NUM_AVERAGE_EVENTS];
+    process_average_results(N_RUNS, NUM_AVERAGE_EVENTS, raw_results->hi_prio_average, average_results);
+
     result = process_result(N_RUNS, raw_results->hi_prio_results, desc);
     set.name = "Signal to low prio thread";
+    set.events = config_set(CONFIG_PMU_EVENTS) ? average_results : NULL;
     json_array_append_new(array, result_set_to_json(set));
+    set.events = NULL;
 
-    result_t average_results[NUM_AVERAGE_EVENTS];
-    process_average_results(N_RUNS, NUM_AVERAGE_EVENTS, raw_results->hi_prio_average, average_results);
 
     json_array_append_new(array, average_counters_to_json("Average signal to low prio thread",
                                                           average_results));
@@ -61,6 +76,8 @@ static json_t *signal_process(void *results)
 static benchmark_t signal_benchmark = {
     .name = "signal",
     .enabled = config_set(CONFIG_APP_SIGNALBENCH),
+    .persistent = true,
+    .per_core = true,
     .results_pages = BYTES_TO_SIZE_BITS_PAGES(sizeof(signal_results_t), seL4_PageBits),
     .process = signal_process,
     .init = blank_init
@@ -27,17 +27,18 @@ static json_t *process_smp_results(void *r)
 {
     smp_results_t *raw_results = r;
 
-    int n = TESTS * cores_collective_results;
+    int ntests = raw_results->n_tests;
+    int n = ntests * cores_collective_results;
 
     json_int_t cycle_col[n], cores_col[n];
     for (int i = 0; i < n; i++) {
-        cycle_col[i] = smp_benchmark_params[i / cores_collective_results].delay;
+        cycle_col[i] = raw_results->delay[i / cores_collective_results];
         cores_col[i] = (i % cores_collective_results) + 1;
     }
 
     column_t extra_cols[] = {
         {
-            .header = "Cycles",
+            .header = (char *) smp_axes[0].name,
             .type = JSON_INTEGER,
             .integer_array = cycle_col,
         },
@@ -48,7 +49,7 @@ static json_t *process_smp_results(void *r)
         },
     };
 
-    result_t results[TESTS][cores_collective_results];
+    result_t results[ntests][cores_collective_results];
 
     result_set_t result_set = {
         .name = "SMP Benchmark",
@@ -58,10 +59,10 @@ static json_t *process_smp_results(void *r)
         .n_results = n,
     };
 
-    for (int i = 0; i < TESTS; i++) {
+    for (int i = 0; i < ntests; i++) {
         for (int j = 0; j < cores_collective_results; j++) {
             result_desc_t desc = {
-                .name = smp_benchmark_params[i].name,
+                .name = "SMP Benchmark",
                 .overhead = 0,
             };
             results[i][j] = process_result(RUNS, raw_results->benchmarks_result[i][j], desc);
@@ -76,6 +77,7 @@ static json_t *process_smp_results(void *r)
 static benchmark_t smp_benchmark = {
     .name = "smp",
     .enabled = config_set(CONFIG_APP_SMPBENCH),
+    .all_cores = true,
     .results_pages = BYTES_TO_SIZE_BITS_PAGES(sizeof(smp_results_t), seL4_PageBits),
     .process = process_smp_results,
     .init = process_smp_results_init
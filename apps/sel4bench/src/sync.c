@@ -15,7 +15,6 @@ static json_t *sync_process(void *results)
     sync_results_t *raw_results = results;
 
     result_desc_t desc = {
-        .stable = false,
         .name = "sync benchmarks",
         .ignored = N_IGNORED
     };
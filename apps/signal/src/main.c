@@ -13,6 +13,9 @@
 #include <sel4utils/slab.h>
 
 #include <benchmark.h>
+#include <cache_state.h>
+#include <calibration.h>
+#include <pmu.h>
 #include <sel4benchsupport/signal.h>
 
 #define NOPS ""
@@ -56,6 +59,23 @@ void wait_fn(int argc, char **argv)
     seL4_Wait(ntfn, NULL);
 }
 
+/* wait_fn for the signals of low_prio_signal_events_fn */
+void wait_events_fn(int argc, char **argv)
+{
+    assert(argc == N_WAIT_ARGS);
+    seL4_CPtr ntfn = (seL4_CPtr) atol(argv[0]);
+    seL4_CPtr done_ep = (seL4_CPtr) atol(argv[1]);
+
+    for (seL4_Word i = 0; i < pmu_ops(PMU_ROTATIONS); i++) {
+        DO_REAL_WAIT(ntfn);
+    }
+
+    /* signal completion */
+    seL4_Send(done_ep, seL4_MessageInfo_new(0, 0, 0, 0));
+    /* block */
+    seL4_Wait(ntfn, NULL);
+}
+
 /* this signal function expects to switch threads (ie wait_fn is higher prio) */
 void low_prio_signal_fn(int argc, char **argv)
 {
@@ -67,6 +87,7 @@ void low_prio_signal_fn(int argc, char **argv)
 
     for (int i = 0; i < N_RUNS; i++) {
         ccnt_t start;
+        cache_state_prepare();
         SEL4BENCH_READ_CCNT(start);
         DO_REAL_SIGNAL(ntfn);
         results[i] = (*end - start);
@@ -82,7 +103,8 @@ void low_prio_signal_fn(int argc, char **argv)
  * early processing of samples ("Early processing methodology")
  *
  * The methodology accumulates sum of samples and sum of squared samples
- * that allows to calculate standard deviation and mean.
+ * that allows to calculate standard deviation and mean, as well as a
+ * histogram of the samples for their percentiles.
  * Raw samples are dropped.
  */
 
@@ -104,14 +126,18 @@ void low_prio_signal_early_proc_fn(int argc, char **argv)
     ccnt_t sum = 0;
     ccnt_t sum2 = 0;
 
+    histogram_init(&results->lo_histogram);
+
     DATACOLLECT_INIT();
 
     for (seL4_Word i = 0; i < N_RUNS; i++) {
         ccnt_t start;
 
+        cache_state_prepare();
         SEL4BENCH_READ_CCNT(start);
         DO_REAL_SIGNAL(ntfn);
         DATACOLLECT_GET_SUMS(i, N_IGNORED, start, *end, overhead, sum, sum2);
+        DATACOLLECT_HISTOGRAM(i, N_IGNORED, start, *end, overhead, &results->lo_histogram);
     }
 
     results->lo_sum = sum;
@@ -124,6 +150,22 @@ void low_prio_signal_early_proc_fn(int argc, char **argv)
     seL4_Wait(ntfn, NULL);
 }
 
+/* The same as low_prio_signal_fn, but counts events (see pmu.h) */
+void low_prio_signal_events_fn(int argc, char **argv)
+{
+    assert(argc == N_LO_SIGNAL_ARGS);
+    seL4_CPtr ntfn = (seL4_CPtr) atol(argv[0]);
+    signal_results_t *results = (signal_results_t *) atol(argv[2]);
+    seL4_CPtr done_ep = (seL4_CPtr) atol(argv[3]);
+
+    PMU_CAPTURE(results->lo_prio_events.counts, PMU_ROTATIONS, DO_REAL_SIGNAL(ntfn));
+
+    /* signal completion */
+    seL4_Send(done_ep, seL4_MessageInfo_new(0, 0, 0, 0));
+    /* block */
+    seL4_Wait(ntfn, NULL);
+}
+
 void high_prio_signal_fn(int argc, char **argv)
 {
     assert(argc == N_HI_SIGNAL_ARGS);
@@ -137,6 +179,7 @@ void high_prio_signal_fn(int argc, char **argv)
     for (int i = 0; i < N_RUNS; i++) {
         ccnt_t start, end;
         COMPILER_MEMORY_FENCE();
+        cache_state_prepare();
         SEL4BENCH_READ_CCNT(start);
         DO_REAL_SIGNAL(ntfn);
         SEL4BENCH_READ_CCNT(end);
@@ -146,25 +189,7 @@ void high_prio_signal_fn(int argc, char **argv)
     }
 
     /* now run an average benchmark and read the perf counters as well */
-    seL4_Word n_counters = sel4bench_get_num_counters();
-    ccnt_t start = 0;
-    ccnt_t end = 0;
-    assert(n_counters > 0);
-    assert(sel4bench_get_num_generic_counter_chunks(n_counters) > 0);
-    for (int j = 0; j < N_RUNS; j++) {
-        for (seL4_Word chunk = 0; chunk < sel4bench_get_num_generic_counter_chunks(n_counters); chunk++) {
-            COMPILER_MEMORY_FENCE();
-            counter_bitfield_t mask = sel4bench_enable_generic_counters(chunk, n_counters);
-            SEL4BENCH_READ_CCNT(start);
-            for (int i = 0; i < AVERAGE_RUNS; i++) {
-                DO_REAL_SIGNAL(ntfn);
-            }
-            SEL4BENCH_READ_CCNT(end);
-            sel4bench_read_and_stop_counters(mask, chunk, n_counters, results->hi_prio_average[j]);
-            results->hi_prio_average[j][CYCLE_COUNT_EVENT] = end - start;
-            COMPILER_MEMORY_FENCE();
-        }
-    }
+    PMU_CAPTURE(results->hi_prio_average, N_RUNS, DO_REAL_SIGNAL(ntfn));
 
     /* signal completion */
     seL4_Send(done_ep, seL4_MessageInfo_new(0, 0, 0, 0));
@@ -191,6 +216,17 @@ static void stop_threads(helper_thread_t *first, helper_thread_t *second)
     assert(error == seL4_NoError);
 }
 
+void measure_signal_overhead(seL4_CPtr ntfn, ccnt_t *results)
+{
+    ccnt_t start, end;
+    for (int i = 0; i < N_RUNS; i++) {
+        SEL4BENCH_READ_CCNT(start);
+        DO_NOP_SIGNAL(ntfn);
+        SEL4BENCH_READ_CCNT(end);
+        results[i] = (end - start);
+    }
+}
+
 static void benchmark(env_t *env, seL4_CPtr ep, seL4_CPtr ntfn, signal_results_t *results)
 {
     helper_thread_t wait = {
@@ -198,10 +234,7 @@ static void benchmark(env_t *env, seL4_CPtr ep, seL4_CPtr ntfn, signal_results_t
         .fn = (sel4utils_thread_entry_fn) wait_fn,
     };
 
-    helper_thread_t signal = {
-        .argc = N_LO_SIGNAL_ARGS,
-        .fn = (sel4utils_thread_entry_fn) low_prio_signal_fn,
-    };
+    helper_thread_t signal;
 
     helper_thread_t signal_early_proc = {
         .argc = N_LO_SIGNAL_ARGS,
@@ -213,7 +246,6 @@ static void benchmark(env_t *env, seL4_CPtr ep, seL4_CPtr ntfn, signal_results_t
 
     assert(N_LO_SIGNAL_ARGS >= N_HI_SIGNAL_ARGS);
 
-    /* first benchmark signalling to a higher prio thread */
     benchmark_configure_thread(env, ep, seL4_MaxPrio, "wait", &wait.thread);
     benchmark_configure_thread(env, ep, seL4_MaxPrio - 1, "signal", &signal.thread);
     benchmark_configure_thread(env, ep, seL4_MaxPrio - 1, "signal early", &signal_early_proc.thread);
@@ -224,59 +256,86 @@ static void benchmark(env_t *env, seL4_CPtr ep, seL4_CPtr ntfn, signal_results_t
 
     sel4utils_create_word_args(wait.argv_strings, wait.argv, wait.argc, ntfn, ep, (seL4_Word) &end);
 
-    sel4utils_create_word_args(signal.argv_strings, signal.argv, signal.argc, ntfn,
-                               (seL4_Word) &end, (seL4_Word) results->lo_prio_results, ep);
-
     sel4utils_create_word_args(signal_early_proc.argv_strings, signal_early_proc.argv, signal_early_proc.argc, ntfn,
                                (seL4_Word) &end, (seL4_Word) results, ep);
 
-    /* Late processing run*/
-    start_threads(&signal, &wait);
+    seL4_CPtr auth = simple_get_tcb(&env->simple);
 
-    benchmark_wait_children(ep, "children of notification benchmark", 2);
+    do {
+        /* measure overhead */
+        measure_signal_overhead(ntfn, results->overhead);
 
-    stop_threads(&signal, &wait);
+        /* subtract the overhead calibrated by the root task, which falls back to the
+         * minimum of its samples if they are not stable */
+        results->calibration = env->args->calibration;
+        results->overhead_min = results->calibration.overheads[CALIBRATION_SIGNAL].value;
 
-    /* Early processing run*/
-    start_threads(&signal_early_proc, &wait);
+        /* first benchmark signalling to a higher prio thread. The priorities are
+         * swapped below, so set them up again for every iteration */
+        error = seL4_TCB_SetPriority(wait.thread.tcb.cptr, auth, seL4_MaxPrio);
+        assert(error == seL4_NoError);
+        error = seL4_TCB_SetPriority(signal.thread.tcb.cptr, auth, seL4_MaxPrio - 1);
+        assert(error == seL4_NoError);
+        error = seL4_TCB_SetPriority(SEL4UTILS_TCB_SLOT, auth, seL4_MaxPrio);
+        assert(error == seL4_NoError);
 
-    benchmark_wait_children(ep, "children of notification benchmark", 2);
+        /* discard any signal left over from the last iteration */
+        seL4_Poll(ntfn, NULL);
 
-    stop_threads(&signal_early_proc, &wait);
+        signal.fn = (sel4utils_thread_entry_fn) low_prio_signal_fn;
+        signal.argc = N_LO_SIGNAL_ARGS;
+        sel4utils_create_word_args(signal.argv_strings, signal.argv, signal.argc, ntfn,
+                                   (seL4_Word) &end, (seL4_Word) results->lo_prio_results, ep);
 
-    seL4_CPtr auth = simple_get_tcb(&env->simple);
-    /* now benchmark signalling to a lower prio thread */
-    error = seL4_TCB_SetPriority(wait.thread.tcb.cptr, auth, seL4_MaxPrio - 1);
-    assert(error == seL4_NoError);
+        /* Late processing run*/
+        start_threads(&signal, &wait);
 
-    error = seL4_TCB_SetPriority(signal.thread.tcb.cptr, auth, seL4_MaxPrio);
-    assert(error == seL4_NoError);
+        benchmark_wait_children(ep, "children of notification benchmark", 2);
 
-    /* set our prio down so the waiting thread can get on the endpoint */
-    seL4_TCB_SetPriority(SEL4UTILS_TCB_SLOT, auth, seL4_MaxPrio - 2);
+        stop_threads(&signal, &wait);
 
-    /* change params for high prio signaller */
-    signal.fn = (sel4utils_thread_entry_fn) high_prio_signal_fn;
-    signal.argc = N_HI_SIGNAL_ARGS;
-    sel4utils_create_word_args(signal.argv_strings, signal.argv, signal.argc, ntfn,
-                               (seL4_Word) results, ep);
+        /* Early processing run*/
+        start_threads(&signal_early_proc, &wait);
 
-    start_threads(&wait, &signal);
+        benchmark_wait_children(ep, "children of notification benchmark", 2);
 
-    benchmark_wait_children(ep, "children of notification", 1);
+        stop_threads(&signal_early_proc, &wait);
 
-    stop_threads(&wait, &signal);
-}
+        if (config_set(CONFIG_PMU_EVENTS)) {
+            /* the same pair of threads again, counting events */
+            signal_early_proc.fn = (sel4utils_thread_entry_fn) low_prio_signal_events_fn;
+            wait.fn = (sel4utils_thread_entry_fn) wait_events_fn;
+            start_threads(&signal_early_proc, &wait);
 
-void measure_signal_overhead(seL4_CPtr ntfn, ccnt_t *results)
-{
-    ccnt_t start, end;
-    for (int i = 0; i < N_RUNS; i++) {
-        SEL4BENCH_READ_CCNT(start);
-        DO_NOP_SIGNAL(ntfn);
-        SEL4BENCH_READ_CCNT(end);
-        results[i] = (end - start);
-    }
+            benchmark_wait_children(ep, "children of notification benchmark", 2);
+
+            stop_threads(&signal_early_proc, &wait);
+            signal_early_proc.fn = (sel4utils_thread_entry_fn) low_prio_signal_early_proc_fn;
+            wait.fn = (sel4utils_thread_entry_fn) wait_fn;
+        }
+
+        /* now benchmark signalling to a lower prio thread */
+        error = seL4_TCB_SetPriority(wait.thread.tcb.cptr, auth, seL4_MaxPrio - 1);
+        assert(error == seL4_NoError);
+
+        error = seL4_TCB_SetPriority(signal.thread.tcb.cptr, auth, seL4_MaxPrio);
+        assert(error == seL4_NoError);
+
+        /* set our prio down so the waiting thread can get on the endpoint */
+        seL4_TCB_SetPriority(SEL4UTILS_TCB_SLOT, auth, seL4_MaxPrio - 2);
+
+        /* change params for high prio signaller */
+        signal.fn = (sel4utils_thread_entry_fn) high_prio_signal_fn;
+        signal.argc = N_HI_SIGNAL_ARGS;
+        sel4utils_create_word_args(signal.argv_strings, signal.argv, signal.argc, ntfn,
+                                   (seL4_Word) results, ep);
+
+        start_threads(&wait, &signal);
+
+        benchmark_wait_children(ep, "children of notification", 1);
+
+        stop_threads(&wait, &signal);
+    } while (benchmark_iteration_done(EXIT_SUCCESS));
 }
 
 int main(int argc, char **argv)
@@ -308,19 +367,6 @@ int main(int argc, char **argv)
     error = vka_alloc_notification(&env->slab_vka, &ntfn);
     assert(error == seL4_NoError);
 
-    /* measure overhead */
-    measure_signal_overhead(ntfn.cptr, results->overhead);
-
-    /* TODO: integrate checking stability of the overhead.
-     * Currently (04.06.2022) only x86_64 platform has unstable overhead and it's allowed,
-     * so we just blindly subtract "Min" overhead from all the measurements.
-     *
-     * Original workflow (late processing) has param "stable" in structure
-     * result_desc_t and CONFIG_ALLOW_UNSTABLE_OVERHEAD to deal with overhead.
-     * NB! CONFIG_ALLOW_UNSTABLE_OVERHEAD is not avail. in signal app.
-    */
-    results->overhead_min = getMinOverhead(results->overhead, N_RUNS);
-
     benchmark(env, done_ep.cptr, ntfn.cptr, results);
 
     /* done -> results are stored in shared memory so we can now return */
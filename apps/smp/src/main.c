@@ -186,8 +186,11 @@ static void benchmark_multicore_ipc_throughput(env_t *env, smp_results_t *result
     /* Make future wait times more deterministic. */
     wait_for_benchmark(env);
 
-    for (int nr_test = 0; nr_test < TESTS; nr_test++) {
-        current_delay_cycle = smp_benchmark_params[nr_test].delay;
+    results->n_tests = benchmark_sweep_size(env, TESTS);
+    for (int nr_test = 0; nr_test < results->n_tests; nr_test++) {
+        results->delay[nr_test] = benchmark_sweep_overridden(env) ? env->args->params.values[nr_test] :
+                                  sweep_value(&smp_sweep, sweep_point(&smp_sweep, nr_test), 0);
+        current_delay_cycle = results->delay[nr_test];
 
         for (int core_idx = 0; core_idx < nr_cores; core_idx++) {
             if (nr_test == 0) {
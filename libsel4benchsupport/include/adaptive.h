@@ -0,0 +1,146 @@
+/*
+ * Copyright 2020, Data61, CSIRO (ABN 41 687 119 230)
+ *
+ * SPDX-License-Identifier: BSD-2-Clause
+ */
+#pragma once
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <sel4benchsupport/gen_config.h>
+#include <sel4bench/sel4bench.h>
+#include <utils/config.h>
+#include <utils/util.h>
+
+/*
+ * Adaptive sample counts.
+ *
+ * Rather than taking a fixed number of samples, a benchmark loop keeps sampling
+ * until the 95% confidence interval of the mean is narrower than
+ * CONFIG_ADAPTIVE_TARGET_PRECISION (relative to the mean), or it runs out of space
+ * for samples. Without CONFIG_ADAPTIVE_SAMPLING the loop takes exactly the default
+ * number of samples, as before.
+ *
+ * Benchmarks are built with general purpose registers only, so the estimate is
+ * kept with integer arithmetic: the deviations of each sample from the first are
+ * summed, which keeps the sums small for the tightly clustered samples we take.
+ * Should a sum overflow anyway, the interval is never considered converged and the
+ * loop runs to its maximum.
+ *
+ * Usage:
+ *
+ *     adaptive_t adaptive;
+ *     adaptive_init(&adaptive, DEFAULT_RUNS, MAX_RUNS);
+ *     for (i = 0; !adaptive_done(&adaptive); i++) {
+ *         results[i] = measure();
+ *         adaptive_add(&adaptive, results[i]);
+ *     }
+ *     results->n = adaptive.n;
+ *     results->converged = adaptive_converged(&adaptive);
+ */
+
+/* z value of a two sided 95% confidence interval, multiplied by 100 */
+#define ADAPTIVE_Z95_X100 196
+/* CONFIG_ADAPTIVE_TARGET_PRECISION is in hundredths of a percent */
+#define ADAPTIVE_PRECISION_SCALE 10000
+
+typedef struct adaptive {
+    /* number of samples added */
+    size_t n;
+    /* stop once n reaches min_samples and the interval has converged */
+    size_t min_samples;
+    /* stop once n reaches max_samples regardless */
+    size_t max_samples;
+    /* first sample, which the deviations are relative to */
+    ccnt_t first;
+    /* sum of deviations from first */
+    int64_t sum;
+    /* sum of squared deviations from first */
+    uint64_t sum2;
+    /* one of the sums overflowed */
+    bool overflow;
+} adaptive_t;
+
+/*
+ * @param default_samples number of samples to take without CONFIG_ADAPTIVE_SAMPLING.
+ * @param max_samples     most samples to take with CONFIG_ADAPTIVE_SAMPLING, usually
+ *                        the space available to store them.
+ */
+static inline void adaptive_init(adaptive_t *adaptive, size_t default_samples, size_t max_samples)
+{
+    *adaptive = (adaptive_t) {
+        0
+    };
+    if (config_set(CONFIG_ADAPTIVE_SAMPLING)) {
+        adaptive->min_samples = MIN(CONFIG_ADAPTIVE_MIN_SAMPLES, max_samples);
+        adaptive->max_samples = max_samples;
+    } else {
+        adaptive->min_samples = default_samples;
+        adaptive->max_samples = default_samples;
+    }
+}
+
+static inline void adaptive_add(adaptive_t *adaptive, ccnt_t sample)
+{
+    if (adaptive->n == 0) {
+        adaptive->first = sample;
+    }
+    adaptive->n++;
+
+    int64_t delta = (int64_t) sample - (int64_t) adaptive->first;
+    uint64_t delta2;
+    adaptive->overflow |= __builtin_mul_overflow(delta, delta, &delta2);
+    adaptive->overflow |= __builtin_add_overflow(adaptive->sum, delta, &adaptive->sum);
+    adaptive->overflow |= __builtin_add_overflow(adaptive->sum2, delta2, &adaptive->sum2);
+}
+
+/*
+ * Is the relative half-width of the 95% confidence interval of the mean at most
+ * CONFIG_ADAPTIVE_TARGET_PRECISION? Always false without CONFIG_ADAPTIVE_SAMPLING.
+ */
+static inline bool adaptive_converged(adaptive_t *adaptive)
+{
+    size_t n = adaptive->n;
+    if (!config_set(CONFIG_ADAPTIVE_SAMPLING) || n < 2 || adaptive->overflow) {
+        return false;
+    }
+
+    /* n * sum of squared deviations from the mean = n * sum2 - sum^2 */
+    uint64_t nm2, sum_sq;
+    if (__builtin_mul_overflow(adaptive->sum2, (uint64_t) n, &nm2) ||
+        __builtin_mul_overflow(adaptive->sum, adaptive->sum, &sum_sq)) {
+        return false;
+    }
+    uint64_t m2 = nm2 > sum_sq ? (nm2 - sum_sq) / n : 0;
+
+    /* squared half-width is z^2 * variance / n, scaled by 100^2 for z */
+    uint64_t half_width2;
+    if (__builtin_mul_overflow(m2, (uint64_t)(ADAPTIVE_Z95_X100 * ADAPTIVE_Z95_X100), &half_width2)) {
+        return false;
+    }
+    half_width2 /= (uint64_t)(n - 1) * n;
+
+    /* squared target half-width is (target * mean)^2, scaled by 100^2 for z */
+    int64_t mean = (int64_t) adaptive->first + adaptive->sum / (int64_t) n;
+    if (mean <= 0) {
+        return false;
+    }
+    uint64_t target, target2;
+    if (__builtin_mul_overflow((uint64_t) mean, (uint64_t)(CONFIG_ADAPTIVE_TARGET_PRECISION * 100), &target) ||
+        __builtin_mul_overflow(target / ADAPTIVE_PRECISION_SCALE, target / ADAPTIVE_PRECISION_SCALE, &target2)) {
+        /* the target is too wide to represent, so anything fits */
+        return true;
+    }
+
+    return half_width2 <= target2;
+}
+
+/* Should the benchmark loop stop taking samples? */
+static inline bool adaptive_done(adaptive_t *adaptive)
+{
+    if (adaptive->n >= adaptive->max_samples) {
+        return true;
+    }
+    return adaptive->n >= adaptive->min_samples && adaptive_converged(adaptive);
+}
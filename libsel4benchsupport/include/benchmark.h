@@ -20,6 +20,8 @@
 #include <vka/vka.h>
 #include <vspace/vspace.h>
 #include <benchmark_types.h>
+#include <sample_ring.h>
+#include <histogram.h>
 
 /* average events = sel4bench generic events + the cycle counter */
 #define NUM_AVERAGE_EVENTS (SEL4BENCH_NUM_GENERIC_EVENTS + 1u)
@@ -47,6 +49,17 @@ sample = is_counted * (e - s - o);\
 par_sum += sample; par_sum2 += sample * sample;\
 }
 
+/* As DATACOLLECT_GET_SUMS, but add the sample to the histogram_t "hist"
+ * instead of accumulating sums. Like the sums, "hist" takes constant memory
+ * however many samples there are, but also gives min, max and percentiles.
+ */
+#define DATACOLLECT_HISTOGRAM(i, n, s, e, o, hist) \
+{\
+is_counted = ( ~(i - n) ) >> (seL4_WordBits - 1);\
+sample = e - s - o;\
+histogram_add(hist, sample, is_counted);\
+}
+
 /*
  * Execution flow for Early Processing: we have to calculate min value
  * of measured overheads before running benchmark.
@@ -77,6 +90,8 @@ typedef struct env {
     sel4utils_elf_region_t region;
     /* virtual address to write benchmark results to */
     void *results;
+    /* size of the results in bytes */
+    size_t results_size;
     /* ltimer interface */
     ltimer_t ltimer;
     /* has the timer been initialised? */
@@ -96,8 +111,37 @@ typedef struct env {
 /* initialise the benchmarking environment and return it */
 env_t *benchmark_get_env(int argc, char **argv, size_t results_size,
                          size_t object_freq[seL4_ObjectTypeCount]);
+/* Was the benchmark's sweep overridden in the parameter file? The values are in env->args->params. */
+static inline bool benchmark_sweep_overridden(env_t *env)
+{
+    return env->args->params.n_values > 0;
+}
+
+/*
+ * Number of values the benchmark should sweep over: as many as were given in the
+ * parameter file, or n_defaults if the sweep was not overridden.
+ */
+static inline size_t benchmark_sweep_size(env_t *env, size_t n_defaults)
+{
+    return benchmark_sweep_overridden(env) ? env->args->params.n_values : n_defaults;
+}
+
 /* signal to the benchmark driver process that we are done */
 NORETURN void benchmark_finished(int exit_code);
+/*
+ * Signal to the benchmark driver process that an iteration of the benchmark is
+ * done, and wait to be told whether to run another one.
+ *
+ * Benchmarks that are marked as persistent by the driver loop on this, so that
+ * their process is kept for all iterations. Before asking for another iteration,
+ * the driver zeroes the results (and resets the sample ring), but anything else
+ * the benchmark changed (thread priorities, kernel objects, ...) is left as is.
+ * If a failure is reported, this does not return.
+ *
+ * @return true if another iteration should be run. If false, the benchmark should
+ *         call benchmark_finished.
+ */
+bool benchmark_iteration_done(int exit_code);
 /* Write for benchmarks. prints via a serial server in the initial task */
 size_t benchmark_write(void *buf, size_t count);
 
@@ -192,5 +236,35 @@ void send_result(seL4_CPtr ep, ccnt_t result);
  */
 ccnt_t get_result(seL4_CPtr ep);
 
+/*
+ * Block until the benchmark driver has consumed all samples in the sample ring.
+ *
+ * Only valid if the benchmark was started with a sample ring.
+ */
+void benchmark_ring_drain(void);
+
+/*
+ * Start a new stream of samples on the sample ring, after draining what is left
+ * of the previous one.
+ *
+ * @param env environment from benchmark_get_env
+ * @param stream benchmark specific identifier of what the following samples measure
+ */
+void benchmark_ring_set_stream(env_t *env, seL4_Word stream);
+
+/*
+ * Append a sample to the sample ring, draining the ring first if it is full.
+ *
+ * Draining involves a round trip to the benchmark driver, so avoid calling this
+ * between reading the start and end of a measurement.
+ */
+static inline void benchmark_ring_push(env_t *env, ccnt_t sample)
+{
+    sample_ring_t *ring = env->args->ring;
+    while (!sample_ring_push(ring, sample)) {
+        benchmark_ring_drain();
+    }
+}
+
 /* Enable or disable the FPU for a task */
 void configure_fpu(seL4_CPtr tcb, bool fpu_on);
\ No newline at end of file
@@ -9,18 +9,53 @@
 #include <stdint.h>
 #include <sel4/types.h>
 #include <sel4platsupport/timer.h>
+#include <calibration.h>
 /* types shared between sel4bench and its child apps */
 
 #define SEL4BENCH_PROTOBUF_RPC (9000)
+/* sent by a benchmark when its sample ring needs to be drained */
+#define SEL4BENCH_RING_DRAIN (9001)
+/* maximum number of values a benchmark's sweep can be overridden with */
+#define SEL4BENCH_MAX_PARAMS 16
+/* maximum number of untypeds a benchmark can be given */
+#define SEL4BENCH_MAX_UNTYPEDS 32
+
+/* values to sweep over instead of a benchmark's defaults, from the parameter file */
+typedef struct {
+    /* number of values, 0 to use the defaults */
+    size_t n_values;
+    seL4_Word values[SEL4BENCH_MAX_PARAMS];
+} param_override_t;
+
 typedef struct {
-    size_t untyped_size_bits;
+    /* untypeds to allocate from, in consecutive slots starting at untyped_cptr */
+    size_t n_untypeds;
+    uint8_t untyped_size_bits[SEL4BENCH_MAX_UNTYPEDS];
+    /* physical addresses of the untypeds, for cache colouring (see cache_colour.h) */
+    uintptr_t untyped_paddr[SEL4BENCH_MAX_UNTYPEDS];
     uintptr_t stack_vaddr;
     size_t stack_pages;
     void *results;
+    /* shared sample ring (see sample_ring.h), NULL if the benchmark does not use one */
+    void *ring;
+    /* size of the ring in 4K pages */
+    size_t ring_pages;
+    /* size of the pages the results, the ring and these args are mapped with (see shared_mem.h) */
+    size_t results_page_bits;
+    size_t ring_page_bits;
+    size_t args_page_bits;
     int nr_cores;
+    /* core the benchmark and all of its threads run on */
+    int core;
+    /* seed of the order of the configurations in this run (see shuffle.h) */
+    uint64_t order_seed;
     void *fdt;
     seL4_CPtr first_free;
     seL4_CPtr untyped_cptr;
     seL4_CPtr sched_ctrl;
     seL4_CPtr serial_ep;
+    /* sweep override for this benchmark */
+    param_override_t params;
+    /* measurement overheads on this core, calibrated once by the root task (see calibration.h) */
+    calibration_t calibration;
 } benchmark_args_t;
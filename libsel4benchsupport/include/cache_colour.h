@@ -0,0 +1,76 @@
+/*
+ * Copyright 2020, Data61, CSIRO (ABN 41 687 119 230)
+ *
+ * SPDX-License-Identifier: BSD-2-Clause
+ */
+#pragma once
+
+#include <autoconf.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <sel4/sel4.h>
+#include <sel4benchsupport/gen_config.h>
+#include <utils/util.h>
+#include <vka/vka.h>
+
+/*
+ * Cache colouring of the frames benchmarks run on.
+ *
+ * The frames a benchmark gets decide which sets of a physically indexed cache its
+ * stacks, IPC buffers and results fall into, so two runs of the same benchmark can
+ * conflict in the cache differently just because they got different memory. A
+ * colour is a page sized slice of the cache sets: frame number modulo CacheColours,
+ * where CacheColours is the size of the last level cache over its ways and the page
+ * size. With CacheColouring, cache_colour_vka restricts the 4K frames a vka hands
+ * out to the colours set in CacheColourMask:
+ *
+ *  - the root task colours its own vka, which backs the results, arguments and
+ *    sample ring it shares with benchmarks (mapped with 4K pages, as a large page
+ *    has every colour), and the images of the benchmark processes.
+ *  - benchmarks colour their allocator, which backs the stacks, IPC buffers and
+ *    page tables of the processes and threads made by
+ *    benchmark_shallow_clone_process and benchmark_configure_thread.
+ *
+ * Frames of other colours that the vka hands out on the way are kept, and never
+ * used, so that it does not hand them out again. That wastes memory, about as much
+ * for each coloured frame as there are colours not in the mask for each colour in
+ * it, but only up to the most coloured frames in use at once. Where the vka cannot
+ * tell the physical address of a frame, the frame is used as it is.
+ */
+
+#ifdef CONFIG_CACHE_COLOURING
+compile_time_assert(cache_colours_fit, CONFIG_CACHE_COLOURS > 0 && CONFIG_CACHE_COLOURS <= 32);
+compile_time_assert(cache_colour_mask_fits,
+                    ((uint64_t) CONFIG_CACHE_COLOUR_MASK >> CONFIG_CACHE_COLOURS) == 0 &&
+                    CONFIG_CACHE_COLOUR_MASK != 0);
+#endif
+
+/* colour of the frame at paddr */
+static inline int cache_colour_of(uintptr_t paddr)
+{
+#ifdef CONFIG_CACHE_COLOURING
+    return (paddr >> seL4_PageBits) % CONFIG_CACHE_COLOURS;
+#else
+    return 0;
+#endif
+}
+
+/* is the frame at paddr of a colour in CONFIG_CACHE_COLOUR_MASK? */
+static inline bool cache_colour_allowed(uintptr_t paddr)
+{
+#ifdef CONFIG_CACHE_COLOURING
+    return (CONFIG_CACHE_COLOUR_MASK >> cache_colour_of(paddr)) & 1;
+#else
+    return true;
+#endif
+}
+
+/*
+ * Make vka hand out 4K frames of the colours in CONFIG_CACHE_COLOUR_MASK only, by
+ * replacing its utspace functions. Everything allocated with vka from then on,
+ * including through allocators layered on it, is coloured. Once per process.
+ */
+void cache_colour_vka(vka_t *vka);
+
+/* number of frames of other colours that were set aside so far */
+size_t cache_colour_rejected(void);
@@ -0,0 +1,58 @@
+/*
+ * Copyright 2020, Data61, CSIRO (ABN 41 687 119 230)
+ *
+ * SPDX-License-Identifier: BSD-2-Clause
+ */
+#pragma once
+
+#include <autoconf.h>
+#include <sel4/sel4.h>
+#include <sel4benchsupport/gen_config.h>
+#include <utils/util.h>
+
+/*
+ * State of the caches and TLB at the start of a timed section.
+ *
+ * Benchmarks run their timed sections back to back, so by default they measure
+ * with hot caches. For cold cache figures, set CacheState. Benchmarks call
+ * cache_state_prepare right before they read the counter at the start of a timed
+ * section (HARNESS_TIME does so too), and it then:
+ *
+ *  - flush_l1: cleans and invalidates the L1 caches (seL4_BenchmarkFlushL1Caches).
+ *  - flush: cleans and invalidates all caches (seL4_BenchmarkFlushCaches).
+ *  - pollute: writes a buffer of CachePolluteBytes, a word per cache line, which
+ *    evicts the data caches and, with a page for each, the TLB. It then runs about
+ *    CachePolluteCodeBytes of straight line code to evict the instruction cache.
+ *    This is the state a workload running between kernel entries leaves behind.
+ *
+ * The flushes need a kernel with benchmarks enabled. Neither the flushes nor the
+ * pollution reset branch predictors.
+ */
+
+/* evict the caches and TLB, see CONFIG_CACHE_STATE_POLLUTE */
+void cache_state_pollute(void);
+
+/* Put the caches and TLB into the configured state, does nothing for hot caches */
+static inline void cache_state_prepare(void)
+{
+#if defined(CONFIG_CACHE_STATE_FLUSH_L1)
+    seL4_BenchmarkFlushL1Caches(seL4_ARM_CacheID);
+#elif defined(CONFIG_CACHE_STATE_FLUSH)
+    seL4_BenchmarkFlushCaches();
+#elif defined(CONFIG_CACHE_STATE_POLLUTE)
+    cache_state_pollute();
+#endif
+}
+
+/* name of the configured state, for the output, or NULL for hot caches */
+static inline const char *cache_state_name(void)
+{
+    if (config_set(CONFIG_CACHE_STATE_FLUSH_L1)) {
+        return "flushed L1";
+    } else if (config_set(CONFIG_CACHE_STATE_FLUSH)) {
+        return "flushed";
+    } else if (config_set(CONFIG_CACHE_STATE_POLLUTE)) {
+        return "polluted";
+    }
+    return NULL;
+}
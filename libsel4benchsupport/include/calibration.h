@@ -0,0 +1,102 @@
+/*
+ * Copyright 2020, Data61, CSIRO (ABN 41 687 119 230)
+ *
+ * SPDX-License-Identifier: BSD-2-Clause
+ */
+#pragma once
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <sel4bench/sel4bench.h>
+#include <sel4benchsupport/gen_config.h>
+
+/*
+ * Calibration of measurement overheads.
+ *
+ * The overhead of reading the cycle counter, and of the syscall stubs around the
+ * kernel entry, is subtracted from measurements. The root task measures each of
+ * them once per boot, on each core benchmarks run on, and passes every benchmark
+ * the estimates of its core (calibration in benchmark_args_t), instead of each
+ * benchmark measuring its own and failing if the samples are not identical.
+ * Benchmarks copy the estimates into their results, so that the root task corrects
+ * their raw samples by the same values they correct their early processed ones by.
+ *
+ * An overhead is sampled in rounds of CALIBRATION_SAMPLES, until at least
+ * CONFIG_CALIBRATION_CONFIDENCE percent of the samples of a round are within
+ * CONFIG_CALIBRATION_TOLERANCE cycles of its mode. The estimate is then the smallest
+ * of those samples, so that it does not overcorrect. If no round gets there (e.g.
+ * where the counter does not count steadily across instructions), the estimate falls
+ * back to the minimum of all samples and is flagged as not stable, rather than
+ * aborting.
+ *
+ * The confidence of an estimate is a whole percentage, like CalibrationConfidence
+ * that it is compared with, which is as fine as rounds of CALIBRATION_SAMPLES can tell.
+ */
+
+#define CALIBRATION_ROUNDS 8
+#define CALIBRATION_SAMPLES 64
+/* runs of the operation before each sample is taken */
+#define CALIBRATION_WARMUPS 16
+
+typedef enum {
+    /* reading the cycle counter twice (SEL4BENCH_READ_CCNT) */
+    CALIBRATION_CCNT,
+    /* stubs of the IPC syscalls, without entering the kernel (see arch/ipc.h) */
+    CALIBRATION_CALL,
+    CALIBRATION_REPLY_RECV,
+    CALIBRATION_SEND,
+    CALIBRATION_RECV,
+    CALIBRATION_CALL_10,
+    CALIBRATION_REPLY_RECV_10,
+    /* stub of seL4_Signal, without entering the kernel (see arch/signal.h) */
+    CALIBRATION_SIGNAL,
+    /* stub of the reply recv with one message register of the fault benchmark (see arch/fault.h) */
+    CALIBRATION_REPLY_RECV_1,
+    /* stub of the null syscall of the hardware benchmark (see arch/hardware.h). Only
+     * measured with a kernel that has the benchmark syscalls, 0 otherwise */
+    CALIBRATION_NULLSYSCALL,
+    /******/
+    CALIBRATION_N_OVERHEADS
+} calibration_overhead_id_t;
+
+typedef struct {
+    /* cycles to subtract from each measurement */
+    ccnt_t value;
+    /* percentage of samples of the best round within CONFIG_CALIBRATION_TOLERANCE of the mode */
+    uint8_t confidence;
+    /* did a round reach CONFIG_CALIBRATION_CONFIDENCE? If not, value is the minimum of
+     * all samples, an estimate that at least does not overcorrect */
+    bool stable;
+} overhead_t;
+
+typedef struct {
+    /* have the overheads been measured? */
+    bool valid;
+    overhead_t overheads[CALIBRATION_N_OVERHEADS];
+} calibration_t;
+
+static const char *const calibration_names[CALIBRATION_N_OVERHEADS] = {
+    [CALIBRATION_CCNT]          = "read ccnt",
+    [CALIBRATION_CALL]          = "call",
+    [CALIBRATION_REPLY_RECV]    = "reply recv",
+    [CALIBRATION_SEND]          = "send",
+    [CALIBRATION_RECV]          = "recv",
+    [CALIBRATION_CALL_10]       = "call (10 words)",
+    [CALIBRATION_REPLY_RECV_10] = "reply recv (10 words)",
+    [CALIBRATION_SIGNAL]        = "signal",
+    [CALIBRATION_REPLY_RECV_1]  = "reply recv (1 word)",
+    [CALIBRATION_NULLSYSCALL]   = "null syscall",
+};
+
+/* takes one sample of an overhead, after warming it up */
+typedef ccnt_t (*calibration_sample_fn_t)(calibration_overhead_id_t id);
+
+/*
+ * Estimate an overhead from rounds of samples. Benchmarks that count something other
+ * than cycles estimate their own overheads with this, with a sample function that
+ * reads their counter.
+ */
+overhead_t calibration_estimate(calibration_overhead_id_t id, calibration_sample_fn_t sample);
+
+/* Set up the cycle counter and estimate every overhead in cycles */
+void calibration_measure(calibration_t *calibration);
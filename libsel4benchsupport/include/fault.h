@@ -6,11 +6,16 @@
 #pragma once
 
 #include <sel4bench/sel4bench.h>
+#include <calibration.h>
+#include <pmu.h>
 
 #define N_IGNORED 10
 #define N_RUNS (100 + N_IGNORED)
 
 typedef struct {
+    /* overheads the samples are corrected by, from the root task */
+    calibration_t calibration;
+    /* measured for reference, the calibrated overheads are subtracted */
     ccnt_t reply_recv_overhead[N_RUNS];
     ccnt_t ccnt_overhead[N_RUNS];
 
@@ -37,4 +42,7 @@ typedef struct {
     ccnt_t fault_reply_ep_sum2;
     ccnt_t fault_reply_ep_num;
     ccnt_t fault_reply_ep_min_overhead;
+
+    /* events counted for a round trip, with CONFIG_PMU_EVENTS */
+    pmu_results_t round_trip_events;
 } fault_results_t;
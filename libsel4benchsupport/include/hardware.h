@@ -5,19 +5,59 @@
  */
 #pragma once
 
+#include <stdbool.h>
 #include <sel4bench/sel4bench.h>
+#include <cache_state.h>
+#include <calibration.h>
+#include <histogram.h>
+#include <pmu.h>
 
 #define N_IGNORED 10
 #define N_RUNS (100 + N_IGNORED)
+/* most null syscall samples taken with CONFIG_ADAPTIVE_SAMPLING */
+#define N_ADAPTIVE_RUNS (10000 + N_IGNORED)
+
+/* null syscall samples collected in a histogram, far more than fit in an array */
+#define N_HISTOGRAM_RUNS (1000000 + N_IGNORED)
+/* as many as fit in an array with a CacheState, which flushes or pollutes the caches
+ * before every sample */
+#define N_COLD_HISTOGRAM_RUNS N_ADAPTIVE_RUNS
+
+/* null syscall samples to collect in the histogram */
+static inline size_t hardware_histogram_runs(void)
+{
+    return cache_state_name() == NULL ? N_HISTOGRAM_RUNS : N_COLD_HISTOGRAM_RUNS;
+}
+
+/* size of the sample ring used when CONFIG_HARDWARE_RING_SAMPLES is set */
+#define HARDWARE_RING_PAGES 16
+
+/* streams of samples sent through the sample ring */
+enum hardware_ring_streams {
+    HARDWARE_RING_NULLSYSCALL = 0,
+};
 
 typedef struct hardware_results {
-    ccnt_t nullSyscall_results[N_RUNS];
+    /* overheads the samples are corrected by, from the root task */
+    calibration_t calibration;
+    ccnt_t nullSyscall_results[N_ADAPTIVE_RUNS];
+    /* number of nullSyscall_results taken, including ignored ones */
+    size_t nullSyscall_runs;
+    /* nullSyscall_results converged to CONFIG_ADAPTIVE_TARGET_PRECISION */
+    bool nullSyscall_converged;
+    /* measured for reference, the calibrated overhead is subtracted */
     ccnt_t nullSyscall_overhead[N_RUNS];
 
-    /* Data for early processing */
+    /* Data for early processing, corrected by the calibrated null syscall overhead */
     ccnt_t overhead_min;
 
     ccnt_t nullSyscall_ep_sum;
     ccnt_t nullSyscall_ep_sum2;
     ccnt_t nullSyscall_ep_num;
+
+    /* Data for processing with a histogram */
+    histogram_t nullSyscall_histogram;
+
+    /* events counted for a null syscall, with CONFIG_PMU_EVENTS */
+    pmu_results_t nullSyscall_events;
 } hardware_results_t;
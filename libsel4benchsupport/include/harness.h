@@ -0,0 +1,275 @@
+/*
+ * Copyright 2020, Data61, CSIRO (ABN 41 687 119 230)
+ *
+ * SPDX-License-Identifier: BSD-2-Clause
+ */
+#pragma once
+
+#include <stdbool.h>
+#include <sel4/sel4.h>
+#include <sel4bench/sel4bench.h>
+#include <utils/util.h>
+#include <adaptive.h>
+#include <benchmark.h>
+#include <cache_state.h>
+#include <histogram.h>
+#include <shared_mem.h>
+
+/*
+ * Single source measurement harness.
+ *
+ * Benchmarks collect the samples of a path in several ways: a raw array for the
+ * root task to process, sums for early processing, a histogram, or the sample ring.
+ * Instead of a copy of the timed section for each, a benchmark writes its loop
+ * once, as an ALWAYS_INLINE function taking a harness_kind_t and a harness_t, and
+ * hands each sample to harness_collect. HARNESS_RUN calls the loop with the kind as
+ * a constant, so every kind gets its own copy of the loop in which the switch in
+ * harness_collect folds away. The counter reads and everything around them are the
+ * same in each copy, and collecting costs no more than the copies written by hand.
+ *
+ * Usage:
+ *
+ *     static inline ALWAYS_INLINE void measure_loop(harness_kind_t kind, harness_t *harness)
+ *     {
+ *         for (seL4_Word i = 0; harness_more(kind, harness, i); i++) {
+ *             HARNESS_TIME(kind, harness, i, DO_OPERATION());
+ *         }
+ *     }
+ *
+ *     harness_t harness = harness_sums(overhead, N_RUNS, N_IGNORED, &sum, &sum2, &num);
+ *     HARNESS_RUN(&harness, measure_loop);
+ *
+ * Where the start and end of a sample are read by different threads, the loop
+ * calls harness_collect itself with the two counter values, and the thread that
+ * reads the start calls cache_state_prepare before it.
+ */
+
+typedef enum {
+    /* samples[i] = end - start, the root task subtracts the overhead */
+    HARNESS_RAW,
+    /* sum of the counted samples and of their squares, less the overhead */
+    HARNESS_SUMS,
+    /* histogram of the counted samples, less the overhead */
+    HARNESS_HISTOGRAM,
+    /* end - start pushed to the sample ring, the root task subtracts the overhead */
+    HARNESS_RING,
+} harness_kind_t;
+
+typedef struct {
+    harness_kind_t kind;
+    /* number of samples to take, the most if adaptive */
+    seL4_Word n;
+    /* the first ignored samples warm up caches and are not counted (raw samples
+     * record them for the root task to drop) */
+    seL4_Word ignored;
+    /* subtracted from counted samples, for the kinds that are not corrected later */
+    ccnt_t overhead;
+    /* HARNESS_RAW */
+    ccnt_t *samples;
+    adaptive_t *adaptive;
+    /* HARNESS_SUMS, accumulated while running and stored by harness_finish, and the
+     * samples counted by earlier slices (see harness_slice) */
+    ccnt_t sum;
+    ccnt_t sum2;
+    ccnt_t counted;
+    ccnt_t *sum_out;
+    ccnt_t *sum2_out;
+    ccnt_t *num_out;
+    /* HARNESS_HISTOGRAM */
+    histogram_t *histogram;
+    /* HARNESS_RING */
+    env_t *env;
+} harness_t;
+
+/* Record n samples in samples */
+static inline harness_t harness_raw(ccnt_t *samples, seL4_Word n)
+{
+    return (harness_t) {
+        .kind = HARNESS_RAW,
+        .n = n,
+        .samples = samples,
+    };
+}
+
+/*
+ * Record samples in samples until the counted ones converge (see adaptive.h).
+ * adaptive must be initialised to take at most n - ignored samples.
+ */
+static inline harness_t harness_adaptive(ccnt_t *samples, seL4_Word n, seL4_Word ignored,
+                                         adaptive_t *adaptive)
+{
+    return (harness_t) {
+        .kind = HARNESS_RAW,
+        .n = n,
+        .ignored = ignored,
+        .samples = samples,
+        .adaptive = adaptive,
+    };
+}
+
+/* Sum n samples as DATACOLLECT_GET_SUMS does, and store the sums and their count */
+static inline harness_t harness_sums(ccnt_t overhead, seL4_Word n, seL4_Word ignored,
+                                     ccnt_t *sum, ccnt_t *sum2, ccnt_t *num)
+{
+    return (harness_t) {
+        .kind = HARNESS_SUMS,
+        .n = n,
+        .ignored = ignored,
+        .overhead = overhead,
+        .sum_out = sum,
+        .sum2_out = sum2,
+        .num_out = num,
+    };
+}
+
+/* Add n samples to histogram, which is cleared first */
+static inline harness_t harness_histogram(histogram_t *histogram, ccnt_t overhead, seL4_Word n,
+                                          seL4_Word ignored)
+{
+    histogram_init(histogram);
+    return (harness_t) {
+        .kind = HARNESS_HISTOGRAM,
+        .n = n,
+        .ignored = ignored,
+        .overhead = overhead,
+        .histogram = histogram,
+    };
+}
+
+/* Push n samples to the sample ring of env, see benchmark_ring_set_stream */
+static inline harness_t harness_ring(env_t *env, seL4_Word n)
+{
+    return (harness_t) {
+        .kind = HARNESS_RING,
+        .n = n,
+        .env = env,
+    };
+}
+
+/*
+ * The n samples of harness from the first, for passes over several configurations that
+ * take the samples of each a slice at a time, so that the configurations interleave
+ * (see shuffle.h). Run the slices of a harness in order: raw samples go to their place
+ * in the array, sums carry on from those of the slices before, and the ignored samples
+ * are those at the start of the first slices only. Later slices are warmed up by the
+ * caller, with runs that are not timed.
+ */
+static inline harness_t harness_slice(harness_t harness, seL4_Word first, seL4_Word n)
+{
+    assert(harness.adaptive == NULL && first + n <= harness.n);
+
+    switch (harness.kind) {
+    case HARNESS_RAW:
+        harness.samples += first;
+        break;
+    case HARNESS_SUMS:
+        if (first > 0) {
+            harness.sum = *harness.sum_out;
+            harness.sum2 = *harness.sum2_out;
+            harness.counted = *harness.num_out;
+        }
+        break;
+    default:
+        ZF_LOGF("Cannot slice a harness of kind %d", harness.kind);
+    }
+
+    harness.ignored = harness.ignored > first ? MIN(harness.ignored - first, n) : 0;
+    harness.n = n;
+    return harness;
+}
+
+/* Touch the raw samples before the loop, so that writing them does not miss in the TLB */
+static inline void harness_start(harness_t *harness)
+{
+    if (harness->kind == HARNESS_RAW) {
+        shared_mem_prefault(harness->samples, harness->n * sizeof(ccnt_t));
+    }
+}
+
+/* Is there a sample i to take? */
+static inline ALWAYS_INLINE bool harness_more(harness_kind_t kind, harness_t *harness, seL4_Word i)
+{
+    if (kind == HARNESS_RAW && harness->adaptive != NULL) {
+        return i < harness->ignored || !adaptive_done(harness->adaptive);
+    }
+    return i < harness->n;
+}
+
+/* Collect sample i, measured from start to end. kind must be a constant. */
+static inline ALWAYS_INLINE void harness_collect(harness_kind_t kind, harness_t *harness, seL4_Word i,
+                                                 ccnt_t start, ccnt_t end)
+{
+    DATACOLLECT_INIT();
+
+    switch (kind) {
+    case HARNESS_RAW:
+        harness->samples[i] = end - start;
+        if (harness->adaptive != NULL && i >= harness->ignored) {
+            adaptive_add(harness->adaptive, end - start);
+        }
+        break;
+    case HARNESS_SUMS:
+        DATACOLLECT_GET_SUMS(i, harness->ignored, start, end, harness->overhead, harness->sum, harness->sum2);
+        break;
+    case HARNESS_HISTOGRAM:
+        DATACOLLECT_HISTOGRAM(i, harness->ignored, start, end, harness->overhead, harness->histogram);
+        break;
+    case HARNESS_RING:
+        benchmark_ring_push(harness->env, end - start);
+        break;
+    }
+}
+
+/* Store what was accumulated while running */
+static inline void harness_finish(harness_t *harness)
+{
+    if (harness->kind == HARNESS_SUMS) {
+        *harness->sum_out = harness->sum;
+        *harness->sum2_out = harness->sum2;
+        *harness->num_out = harness->counted + harness->n - harness->ignored;
+    }
+}
+
+/*
+ * Time op and collect it as sample i, from the configured cache state (see
+ * cache_state.h). Every kind reads the counter the same way, with nothing but op
+ * in between.
+ */
+#define HARNESS_TIME(kind, harness, i, op) do { \
+    ccnt_t _harness_start, _harness_end; \
+    cache_state_prepare(); \
+    SEL4BENCH_READ_CCNT(_harness_start); \
+    op; \
+    SEL4BENCH_READ_CCNT(_harness_end); \
+    harness_collect(kind, harness, i, _harness_start, _harness_end); \
+} while (0)
+
+/*
+ * harness_start, run loop(kind, harness, ...) with the kind of harness as a
+ * constant, then harness_finish. The loop runs on a copy of the harness local to
+ * the caller, so that the sums stay in registers rather than going through memory
+ * for every sample.
+ */
+#define HARNESS_RUN(harness, loop, ...) do { \
+    harness_t *_harness = (harness); \
+    harness_t _harness_local = *_harness; \
+    harness_start(&_harness_local); \
+    switch (_harness_local.kind) { \
+    case HARNESS_RAW: \
+        loop(HARNESS_RAW, &_harness_local, ##__VA_ARGS__); \
+        break; \
+    case HARNESS_SUMS: \
+        loop(HARNESS_SUMS, &_harness_local, ##__VA_ARGS__); \
+        break; \
+    case HARNESS_HISTOGRAM: \
+        loop(HARNESS_HISTOGRAM, &_harness_local, ##__VA_ARGS__); \
+        break; \
+    case HARNESS_RING: \
+        loop(HARNESS_RING, &_harness_local, ##__VA_ARGS__); \
+        break; \
+    default: \
+        ZF_LOGF("Unknown harness kind %d", _harness_local.kind); \
+    } \
+    harness_finish(&_harness_local); \
+    *_harness = _harness_local; \
+} while (0)
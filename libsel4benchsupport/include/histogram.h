@@ -0,0 +1,98 @@
+/*
+ * Copyright 2020, Data61, CSIRO (ABN 41 687 119 230)
+ *
+ * SPDX-License-Identifier: BSD-2-Clause
+ */
+#pragma once
+
+#include <stdint.h>
+#include <stddef.h>
+#include <sel4bench/sel4bench.h>
+#include <utils/util.h>
+
+/*
+ * Fixed size log-linear histogram of samples, in the style of HdrHistogram.
+ *
+ * This is a third way of collecting samples, beside storing every sample (late
+ * processing) and only keeping their sum and sum of squares (early processing).
+ * It takes constant memory regardless of the number of samples and constant time
+ * per sample, yet still gives min, max and percentiles, the latter to within
+ * HISTOGRAM_PRECISION_BITS significant bits of the sample.
+ *
+ * Values below HISTOGRAM_SUB_BUCKETS each have a bucket of their own. Above that,
+ * every power of 2 range is split into HISTOGRAM_SUB_BUCKETS / 2 equally sized
+ * buckets, so a bucket is never wider than 1 / 2^HISTOGRAM_PRECISION_BITS of the
+ * values in it. The whole 64-bit range fits in HISTOGRAM_BUCKETS buckets.
+ *
+ * The histogram lives in the results page of the benchmark. It must be initialised
+ * with histogram_init before samples are added, as the results page is cleared
+ * with zeros.
+ */
+
+/* each bucket is at most 1 / 2^HISTOGRAM_PRECISION_BITS of its values wide, i.e. ~3% */
+#define HISTOGRAM_PRECISION_BITS 5
+#define HISTOGRAM_SUB_BUCKETS BIT(HISTOGRAM_PRECISION_BITS + 1)
+#define HISTOGRAM_BUCKETS ((64 - HISTOGRAM_PRECISION_BITS + 1) * (HISTOGRAM_SUB_BUCKETS / 2))
+
+typedef struct histogram {
+    /* number of samples in each bucket */
+    uint32_t counts[HISTOGRAM_BUCKETS];
+    /* number of samples */
+    uint64_t total;
+    /* exact sum, min and max of the samples */
+    uint64_t sum;
+    uint64_t min;
+    uint64_t max;
+} histogram_t;
+
+/* Bucket of a value, without any branches */
+static inline size_t histogram_index(uint64_t value)
+{
+    /* 0 for values below HISTOGRAM_SUB_BUCKETS, then 1 more for each power of 2 */
+    unsigned int shift = (63 - __builtin_clzll(value | (HISTOGRAM_SUB_BUCKETS - 1))) - HISTOGRAM_PRECISION_BITS;
+    return (shift << HISTOGRAM_PRECISION_BITS) + (value >> shift);
+}
+
+/* Lowest value in a bucket */
+static inline uint64_t histogram_bucket_low(size_t index)
+{
+    if (index < HISTOGRAM_SUB_BUCKETS) {
+        return index;
+    }
+    unsigned int shift = (index >> HISTOGRAM_PRECISION_BITS) - 1;
+    return (uint64_t)(index - (shift << HISTOGRAM_PRECISION_BITS)) << shift;
+}
+
+/* Number of values in a bucket */
+static inline uint64_t histogram_bucket_width(size_t index)
+{
+    if (index < HISTOGRAM_SUB_BUCKETS) {
+        return 1;
+    }
+    return (uint64_t) 1 << ((index >> HISTOGRAM_PRECISION_BITS) - 1);
+}
+
+static inline void histogram_init(histogram_t *histogram)
+{
+    for (size_t i = 0; i < HISTOGRAM_BUCKETS; i++) {
+        histogram->counts[i] = 0;
+    }
+    histogram->total = 0;
+    histogram->sum = 0;
+    histogram->min = UINT64_MAX;
+    histogram->max = 0;
+}
+
+/*
+ * Add count (0 or 1) samples of value. Taking the count, rather than checking
+ * whether to add the sample at all, lets the benchmark discard warm up samples
+ * without a branch (see DATACOLLECT_HISTOGRAM).
+ */
+static inline void histogram_add(histogram_t *histogram, ccnt_t value, uint32_t count)
+{
+    histogram->counts[histogram_index(value)] += count;
+    histogram->total += count;
+    histogram->sum += (uint64_t) value * count;
+    histogram->min = count && value < histogram->min ? value : histogram->min;
+    histogram->max = count && value > histogram->max ? value : histogram->max;
+}
@@ -7,20 +7,17 @@
 
 #include <sel4bench/sel4bench.h>
 #include <sel4utils/process.h>
+#include <utils/config.h>
+#include <utils/util.h>
+#include <autoconf.h>
+#include <benchmark_types.h>
+#include <calibration.h>
+#include <pmu.h>
+#include <sweep.h>
 
-#define OVERHEAD_BENCH_PARAMS(n) { .name = n }
 #define RUNS 16
-
-enum overheads {
-    CALL_OVERHEAD,
-    REPLY_RECV_OVERHEAD,
-    SEND_OVERHEAD,
-    RECV_OVERHEAD,
-    CALL_10_OVERHEAD,
-    REPLY_RECV_10_OVERHEAD,
-    /******/
-    NUM_OVERHEAD_BENCHMARKS
-};
+/* most samples taken of each benchmark with CONFIG_ADAPTIVE_SAMPLING */
+#define ADAPTIVE_RUNS 256
 
 typedef enum dir {
     /* client ---> server */
@@ -39,7 +36,14 @@ typedef enum {
     IPC_REPLYRECV_10_FUNC2 = 6,
     IPC_REPLYRECV_10_FUNC = 7,
     IPC_SEND_FUNC = 8,
-    IPC_RECV_FUNC = 9
+    IPC_RECV_FUNC = 9,
+    /* count the events of the ipc, see pmu.h */
+    IPC_CALL_EVENTS_FUNC = 10,
+    IPC_CALL_10_EVENTS_FUNC = 11,
+    IPC_REPLYRECV_EVENTS_FUNC = 12,
+    IPC_REPLYRECV_10_EVENTS_FUNC = 13,
+    IPC_SEND_EVENTS_FUNC = 14,
+    IPC_RECV_EVENTS_FUNC = 15
 } helper_func_id_t;
 
 typedef seL4_Word(*helper_func_t)(int argc, char *argv[]);
@@ -51,169 +55,208 @@ typedef struct benchmark_params {
     dir_t direction;
     /* functions for client and server to run */
     helper_func_id_t server_fn, client_fn;
+    /* functions for client and server to run to count events, with CONFIG_PMU_EVENTS. The
+     * client counts the events of its ipc and of the server's reply, if there is one */
+    helper_func_id_t server_events_fn, client_events_fn;
     /* should client and server run in the same vspace? */
     bool same_vspace;
     /* prio for client and server to run at */
     uint8_t server_prio, client_prio;
     /* length of ipc to send */
     uint8_t length;
-    /* id of overhead calculation for this function */
-    enum overheads overhead_id;
+    /* overhead to subtract from the samples of this function (see calibration.h) */
+    calibration_overhead_id_t overhead_id;
     /* if CONFIG_KERNEL_MCS, should the server be passive? */
     bool passive;
     bool server_fpu;
 } benchmark_params_t;
 
-struct overhead_benchmark_params {
-    const char *name;
+/*
+ * The one way IPC benchmarks are the points of ipc_sweep (see sweep.h), which
+ * varies the function, address spaces, FPU, length, passive server and priorities.
+ * To explore further, add values to the axes below.
+ */
+typedef enum {
+    IPC_CALL,
+    IPC_REPLY_RECV,
+    IPC_SEND,
+} ipc_function_t;
+
+enum ipc_axes {
+    IPC_AXIS_FUNCTION,
+    IPC_AXIS_SAME_VSPACE,
+    IPC_AXIS_SERVER_FPU,
+    IPC_AXIS_LENGTH,
+    IPC_AXIS_PASSIVE,
+    IPC_AXIS_CLIENT_PRIO,
+    IPC_AXIS_SERVER_PRIO,
+    /******/
+    IPC_N_AXES
 };
 
-/* array of benchmarks to run */
-/* one way IPC benchmarks - varying size, direction and priority.*/
-static const benchmark_params_t benchmark_params[] = {
-    /* Call fastpath between client and server in the same address space */
-    {
-        .name        = "seL4_Call",
-        .direction   = DIR_TO,
-        .client_fn   = IPC_CALL_FUNC2,
-        .server_fn   = IPC_REPLYRECV_FUNC2,
-        .same_vspace = true,
-        .client_prio = seL4_MaxPrio - 1,
-        .server_prio = seL4_MaxPrio - 1,
-        .length = 0,
-        .overhead_id = CALL_OVERHEAD,
-        .passive = true,
-        .server_fpu = false,
-    },
-    /* ReplyRecv fastpath between server and client in the same address space */
-    {
-        .name        = "seL4_ReplyRecv",
-        .direction   = DIR_FROM,
-        .client_fn   = IPC_CALL_FUNC,
-        .server_fn   = IPC_REPLYRECV_FUNC,
-        .same_vspace = true,
-        .client_prio = seL4_MaxPrio - 1,
-        .server_prio = seL4_MaxPrio - 1,
-        .length = 0,
-        .overhead_id = REPLY_RECV_OVERHEAD,
-        .passive = true,
-        .server_fpu = false,
+static const seL4_Word ipc_functions[] = { IPC_CALL, IPC_REPLY_RECV, IPC_SEND };
+static const char *const ipc_function_names[] = {
+    [IPC_CALL]       = "seL4_Call",
+    [IPC_REPLY_RECV] = "seL4_ReplyRecv",
+    [IPC_SEND]       = "seL4_Send",
+};
+static const seL4_Word ipc_same_vspace[] = { true, false };
+static const seL4_Word ipc_server_fpu[] = { false, true };
+/* there are only helper functions for these lengths */
+static const seL4_Word ipc_lengths[] = { 0, 10 };
+/* only the first value is used without CONFIG_KERNEL_MCS */
+static const seL4_Word ipc_passive[] = { false, true };
+static const seL4_Word ipc_client_prios[] = { seL4_MaxPrio - 1, seL4_MaxPrio - 2 };
+static const seL4_Word ipc_server_prios[] = { seL4_MaxPrio - 1 };
+
+static const sweep_axis_t ipc_axes[IPC_N_AXES] = {
+    [IPC_AXIS_FUNCTION] = {
+        .name = "Function",
+        .type = SWEEP_LABEL,
+        .n_values = ARRAY_SIZE(ipc_functions),
+        .values = ipc_functions,
+        .labels = ipc_function_names,
     },
-    /* Call fastpath between client and server in different address spaces */
-    {
-        .name        = "seL4_Call",
-        .direction   = DIR_TO,
-        .client_fn   = IPC_CALL_FUNC2,
-        .server_fn   = IPC_REPLYRECV_FUNC2,
-        .same_vspace = false,
-        .client_prio = seL4_MaxPrio - 1,
-        .server_prio = seL4_MaxPrio - 1,
-        .length = 0,
-        .overhead_id = CALL_OVERHEAD,
-        .passive = true,
-        .server_fpu = false,
+    [IPC_AXIS_SAME_VSPACE] = {
+        .name = "Same vspace?",
+        .type = SWEEP_BOOL,
+        .n_values = ARRAY_SIZE(ipc_same_vspace),
+        .values = ipc_same_vspace,
     },
-    /* Call fastpath between client and FPU enabled server in different address spaces */
-    {
-        .name        = "seL4_Call (FPU)",
-        .direction   = DIR_TO,
-        .client_fn   = IPC_CALL_FUNC2,
-        .server_fn   = IPC_REPLYRECV_FUNC2,
-        .same_vspace = false,
-        .client_prio = seL4_MaxPrio - 1,
-        .server_prio = seL4_MaxPrio - 1,
-        .length = 0,
-        .overhead_id = CALL_OVERHEAD,
-        .passive = true,
-        .server_fpu = true,
+    [IPC_AXIS_SERVER_FPU] = {
+        .name = "Server FPU",
+        .type = SWEEP_BOOL,
+        .n_values = ARRAY_SIZE(ipc_server_fpu),
+        .values = ipc_server_fpu,
     },
-    /* ReplyRecv fastpath between server and client in different address spaces */
-    {
-        .name        = "seL4_ReplyRecv",
-        .direction   = DIR_FROM,
-        .client_fn   = IPC_CALL_FUNC,
-        .server_fn   = IPC_REPLYRECV_FUNC,
-        .same_vspace = false,
-        .client_prio = seL4_MaxPrio - 1,
-        .server_prio = seL4_MaxPrio - 1,
-        .length = 0,
-        .overhead_id = REPLY_RECV_OVERHEAD,
-        .passive = true,
-        .server_fpu = false,
+    [IPC_AXIS_LENGTH] = {
+        .name = "IPC length",
+        .type = SWEEP_INTEGER,
+        .n_values = ARRAY_SIZE(ipc_lengths),
+        .values = ipc_lengths,
     },
-    /* ReplyRecv fastpath between FPU enabled server and client in different address spaces */
-    {
-        .name        = "seL4_ReplyRecv (FPU)",
-        .direction   = DIR_FROM,
-        .client_fn   = IPC_CALL_FUNC,
-        .server_fn   = IPC_REPLYRECV_FUNC,
-        .same_vspace = false,
-        .client_prio = seL4_MaxPrio - 1,
-        .server_prio = seL4_MaxPrio - 1,
-        .length = 0,
-        .overhead_id = REPLY_RECV_OVERHEAD,
-        .passive = true,
-        .server_fpu = true,
+    [IPC_AXIS_PASSIVE] = {
+        .name = "Passive server",
+        .type = SWEEP_BOOL,
+        .n_values = config_set(CONFIG_KERNEL_MCS) ? ARRAY_SIZE(ipc_passive) : 1,
+        .values = ipc_passive,
     },
-    /* Send slowpath (no fastpath for send) same prio client-server, different address space */
-    {
-        .name        = "seL4_Send",
-        .direction   = DIR_TO,
-        .client_fn   = IPC_SEND_FUNC,
-        .server_fn   = IPC_RECV_FUNC,
-        .same_vspace = false,
-        .client_prio = seL4_MaxPrio - 2,
-        .server_prio = seL4_MaxPrio - 1,
-        .length = 0,
-        .overhead_id = SEND_OVERHEAD,
-        .passive = false,
-        .server_fpu = false,
+    [IPC_AXIS_CLIENT_PRIO] = {
+        .name = "Client Prio",
+        .type = SWEEP_INTEGER,
+        .n_values = ARRAY_SIZE(ipc_client_prios),
+        .values = ipc_client_prios,
     },
-    /* Call slowpath, long IPC (10), same prio client to server, different address space */
-    {
-        .name        = "seL4_Call",
-        .direction   = DIR_TO,
-        .client_fn   = IPC_CALL_10_FUNC2,
-        .server_fn   = IPC_REPLYRECV_10_FUNC2,
-        .same_vspace = false,
-        .client_prio = seL4_MaxPrio - 1,
-        .server_prio = seL4_MaxPrio - 1,
-        .length = 10,
-        .overhead_id = CALL_10_OVERHEAD,
-        .passive = false,
-        .server_fpu = false,
+    [IPC_AXIS_SERVER_PRIO] = {
+        .name = "Server Prio",
+        .type = SWEEP_INTEGER,
+        .n_values = ARRAY_SIZE(ipc_server_prios),
+        .values = ipc_server_prios,
     },
-    /* ReplyRecv slowpath, long IPC (10), same prio server to client, on the slowpath, different address space */
-    {
-        .name        = "seL4_ReplyRecv",
-        .direction   = DIR_FROM,
-        .client_fn   = IPC_CALL_10_FUNC,
-        .server_fn   = IPC_REPLYRECV_10_FUNC,
-        .same_vspace = false,
-        .client_prio = seL4_MaxPrio - 1,
-        .server_prio = seL4_MaxPrio - 1,
-        .length = 10,
-        .overhead_id = REPLY_RECV_10_OVERHEAD,
-        .passive = false,
-        .server_fpu = false,
-    }
 };
 
-static const struct overhead_benchmark_params overhead_benchmark_params[] = {
-    [CALL_OVERHEAD]          = {"call"},
-    [REPLY_RECV_OVERHEAD]    = {"reply recv"},
-    [SEND_OVERHEAD]          = {"send"},
-    [RECV_OVERHEAD]          = {"recv"},
-    [CALL_10_OVERHEAD]       = {"call"},
-    [REPLY_RECV_10_OVERHEAD] = {"reply recv"},
+static inline bool ipc_sweep_valid(const sweep_t *sweep, size_t point)
+{
+    seL4_Word function = sweep_value(sweep, point, IPC_AXIS_FUNCTION);
+    seL4_Word length = sweep_value(sweep, point, IPC_AXIS_LENGTH);
+    seL4_Word client_prio = sweep_value(sweep, point, IPC_AXIS_CLIENT_PRIO);
+    seL4_Word server_prio = sweep_value(sweep, point, IPC_AXIS_SERVER_PRIO);
+
+    if (length != 0 && length != 10) {
+        return false;
+    }
+    if (function == IPC_SEND) {
+        /* there is no fastpath for send: a lower prio client makes the server run at
+         * once on the slowpath. A passive server would never get to run. */
+        return length == 0 && client_prio < server_prio && !sweep_value(sweep, point, IPC_AXIS_PASSIVE);
+    }
+    /* the fastpath needs client and server at the same prio */
+    return client_prio == server_prio;
+}
+
+static const sweep_t ipc_sweep = {
+    .n_axes = IPC_N_AXES,
+    .axes = ipc_axes,
+    .valid = ipc_sweep_valid,
 };
 
+/* The parameters of the benchmark at a point of ipc_sweep */
+static inline benchmark_params_t ipc_benchmark_params(size_t point)
+{
+    ipc_function_t function = sweep_value(&ipc_sweep, point, IPC_AXIS_FUNCTION);
+    bool long_ipc = sweep_value(&ipc_sweep, point, IPC_AXIS_LENGTH) != 0;
+    benchmark_params_t params = {
+        .name = ipc_function_names[function],
+        .same_vspace = sweep_value(&ipc_sweep, point, IPC_AXIS_SAME_VSPACE),
+        .server_fpu = sweep_value(&ipc_sweep, point, IPC_AXIS_SERVER_FPU),
+        .length = sweep_value(&ipc_sweep, point, IPC_AXIS_LENGTH),
+        .passive = sweep_value(&ipc_sweep, point, IPC_AXIS_PASSIVE),
+        .client_prio = sweep_value(&ipc_sweep, point, IPC_AXIS_CLIENT_PRIO),
+        .server_prio = sweep_value(&ipc_sweep, point, IPC_AXIS_SERVER_PRIO),
+    };
+
+    switch (function) {
+    case IPC_CALL:
+        params.direction = DIR_TO;
+        params.client_fn = long_ipc ? IPC_CALL_10_FUNC2 : IPC_CALL_FUNC2;
+        params.server_fn = long_ipc ? IPC_REPLYRECV_10_FUNC2 : IPC_REPLYRECV_FUNC2;
+        params.overhead_id = long_ipc ? CALIBRATION_CALL_10 : CALIBRATION_CALL;
+        params.client_events_fn = long_ipc ? IPC_CALL_10_EVENTS_FUNC : IPC_CALL_EVENTS_FUNC;
+        params.server_events_fn = long_ipc ? IPC_REPLYRECV_10_EVENTS_FUNC : IPC_REPLYRECV_EVENTS_FUNC;
+        break;
+    case IPC_REPLY_RECV:
+        params.direction = DIR_FROM;
+        params.client_fn = long_ipc ? IPC_CALL_10_FUNC : IPC_CALL_FUNC;
+        params.server_fn = long_ipc ? IPC_REPLYRECV_10_FUNC : IPC_REPLYRECV_FUNC;
+        params.overhead_id = long_ipc ? CALIBRATION_REPLY_RECV_10 : CALIBRATION_REPLY_RECV;
+        params.client_events_fn = long_ipc ? IPC_CALL_10_EVENTS_FUNC : IPC_CALL_EVENTS_FUNC;
+        params.server_events_fn = long_ipc ? IPC_REPLYRECV_10_EVENTS_FUNC : IPC_REPLYRECV_EVENTS_FUNC;
+        break;
+    case IPC_SEND:
+        params.direction = DIR_TO;
+        params.client_fn = IPC_SEND_FUNC;
+        params.server_fn = IPC_RECV_FUNC;
+        params.overhead_id = CALIBRATION_SEND;
+        params.client_events_fn = IPC_SEND_EVENTS_FUNC;
+        params.server_events_fn = IPC_RECV_EVENTS_FUNC;
+        break;
+    }
+
+    return params;
+}
+
+/* The sweep of the ipc benchmark can be overridden (ipc.sweep in the parameter file)
+ * with the numbers of the valid points of ipc_sweep to run, counting from 0, to run
+ * a subset of them or in a different order. */
+#define IPC_MAX_BENCHMARKS MAX(sweep_size(&ipc_sweep), SEL4BENCH_MAX_PARAMS)
+
+typedef struct ipc_benchmark_results {
+    /* point of ipc_sweep that was run */
+    size_t point;
+    /* number of samples */
+    size_t runs;
+    /* samples converged to CONFIG_ADAPTIVE_TARGET_PRECISION */
+    bool converged;
+    ccnt_t samples[ADAPTIVE_RUNS];
+#ifdef CONFIG_PMU_EVENTS
+    /* events counted for the benchmark, only kept with CONFIG_PMU_EVENTS as there
+     * are up to IPC_MAX_BENCHMARKS of them */
+    pmu_results_t events;
+#endif
+} ipc_benchmark_results_t;
+
 typedef struct ipc_results {
-    /* Raw results from benchmarking. These get checked for sanity */
-    ccnt_t overhead_benchmarks[NUM_OVERHEAD_BENCHMARKS][RUNS];
-    ccnt_t benchmarks[ARRAY_SIZE(benchmark_params)][RUNS];
+    /* overheads the samples are corrected by, from the root task or measured by the
+     * benchmark when it does not count cycles */
+    calibration_t calibration;
+    /* number of benchmarks that were run */
+    size_t n_benchmarks;
+    /* IPC_MAX_BENCHMARKS of them, the size of ipc_sweep is only known at run time */
+    ipc_benchmark_results_t benchmarks[];
 } ipc_results_t;
 
+#define IPC_RESULTS_SIZE (sizeof(ipc_results_t) + IPC_MAX_BENCHMARKS * sizeof(ipc_benchmark_results_t))
+
 static inline bool results_stable(ccnt_t *array, size_t size)
 {
     for (size_t i = 1; i < size; i++) {
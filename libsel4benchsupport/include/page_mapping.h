@@ -8,34 +8,37 @@
 
 #include <sel4bench/sel4bench.h>
 #include <sel4utils/process.h>
+#include <utils/compile_time.h>
+#include <benchmark_types.h>
+#include <pmu.h>
+#include <sweep.h>
 
 #define RUNS 17
-#define TESTS ARRAY_SIZE(page_mapping_benchmark_params)
+#define TESTS sweep_size(&page_mapping_sweep)
+/* The sweep can be overridden (page_mapping.sweep in the parameter file) with
+ * the numbers of pages to map, each at most MAX_NPAGE. */
+#define MAX_TESTS SEL4BENCH_MAX_PARAMS
+#define MAX_NPAGE 2048
 #define NPHASE ARRAY_SIZE(phase_name)
 
-typedef struct benchmark_params {
-    /* name of the function we are benchmarking */
-    const char *name;
-    const int   npage;
-} benchmark_params_t;
+/* numbers of pages to map */
+static const seL4_Word page_mapping_npages[] = { 1, 512, 2048 };
 
-/* array of benchmarks to run */
-static const
-benchmark_params_t page_mapping_benchmark_params[] = {
+static const sweep_axis_t page_mapping_axes[] = {
     {
-        .name   = "map 1",
-        .npage  = 1,
-    },
-    {
-        .name   = "map 512",
-        .npage  = 512,
-    },
-    {
-        .name   = "map 2048",
-        .npage  = 2048,
+        .name = "Num of Page Mapped",
+        .type = SWEEP_INTEGER,
+        .n_values = ARRAY_SIZE(page_mapping_npages),
+        .values = page_mapping_npages,
     },
 };
 
+static const sweep_t page_mapping_sweep = {
+    .n_axes = ARRAY_SIZE(page_mapping_axes),
+    .axes = page_mapping_axes,
+};
+compile_time_assert(page_mapping_default_sweep_fits, ARRAY_SIZE(page_mapping_npages) <= MAX_TESTS);
+
 char *phase_name[] = {
     "Prepare Page Tables",
     "Allocate Pages",
@@ -47,5 +50,10 @@ char *phase_name[] = {
 typedef struct page_mapping_results {
     /* Raw results from benchmarking. These get checked for sanity */
     ccnt_t overhead_benchmarks[RUNS];
-    ccnt_t benchmarks_result[TESTS][NPHASE][RUNS];
+    /* number of tests that were run, and the number of pages each one mapped */
+    size_t n_tests;
+    seL4_Word npage[MAX_TESTS];
+    ccnt_t benchmarks_result[MAX_TESTS][NPHASE][RUNS];
+    /* events counted for mapping and unmapping a page, with CONFIG_PMU_EVENTS */
+    pmu_results_t map_unmap_events;
 } page_mapping_results_t;
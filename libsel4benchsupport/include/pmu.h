@@ -0,0 +1,112 @@
+/*
+ * Copyright 2020, Data61, CSIRO (ABN 41 687 119 230)
+ *
+ * SPDX-License-Identifier: BSD-2-Clause
+ */
+#pragma once
+
+#include <sel4/sel4.h>
+#include <sel4bench/sel4bench.h>
+#include <sel4benchsupport/gen_config.h>
+#include <utils/util.h>
+#include <benchmark.h>
+
+/*
+ * PMU sessions: counting every generic event for an operation.
+ *
+ * There are more GENERIC_EVENTS than counters, so a session rotates through them
+ * in chunks of as many events as there are counters (see
+ * sel4bench_enable_generic_counters). A rotation runs the operation AVERAGE_RUNS
+ * times for each chunk, and fills a row of NUM_AVERAGE_EVENTS counts: one per
+ * generic event, and the cycles of the last chunk at CYCLE_COUNT_EVENT. The root
+ * task divides the rows by AVERAGE_RUNS (process_average_results) for the counts
+ * per operation.
+ *
+ * Usage:
+ *
+ *     PMU_CAPTURE(results->op_events.counts, PMU_ROTATIONS, DO_OPERATION());
+ *
+ * The operation runs pmu_ops(rotations) times in all, so that a partner thread,
+ * e.g. one that replies to it, knows how often to do its part. Everything else
+ * running on the core in the meantime, including the partner and the kernel, is
+ * counted too.
+ *
+ * With PmuEvents, benchmarks attach the counts to the rows of their results as
+ * "Events".
+ */
+
+/* rotations through all events for the rows of results that have them */
+#define PMU_ROTATIONS 16
+
+/* counts of PMU_ROTATIONS rotations, for a row of results */
+typedef struct {
+    ccnt_t counts[PMU_ROTATIONS][NUM_AVERAGE_EVENTS];
+} pmu_results_t;
+
+typedef struct {
+    seL4_Word n_counters;
+    /* chunk of GENERIC_EVENTS being counted, and the counters that count it */
+    seL4_Word chunk;
+    counter_bitfield_t mask;
+    ccnt_t start;
+} pmu_session_t;
+
+static inline pmu_session_t pmu_session_new(void)
+{
+    pmu_session_t pmu = {
+        .n_counters = sel4bench_get_num_counters(),
+    };
+    assert(pmu.n_counters > 0);
+    assert(sel4bench_get_num_generic_counter_chunks(pmu.n_counters) > 0);
+    return pmu;
+}
+
+/* number of chunks a rotation goes through */
+static inline seL4_Word pmu_chunks(pmu_session_t *pmu)
+{
+    return sel4bench_get_num_generic_counter_chunks(pmu->n_counters);
+}
+
+/* number of times PMU_CAPTURE runs its operation for rotations */
+static inline seL4_Word pmu_ops(seL4_Word rotations)
+{
+    return rotations * sel4bench_get_num_generic_counter_chunks(sel4bench_get_num_counters()) * AVERAGE_RUNS;
+}
+
+/* Start counting the events of chunk, and the cycles */
+static inline void pmu_chunk_start(pmu_session_t *pmu, seL4_Word chunk)
+{
+    COMPILER_MEMORY_FENCE();
+    pmu->chunk = chunk;
+    pmu->mask = sel4bench_enable_generic_counters(chunk, pmu->n_counters);
+    SEL4BENCH_READ_CCNT(pmu->start);
+}
+
+/* Stop counting, and store the events of the chunk and the cycles in counts */
+static inline void pmu_chunk_stop(pmu_session_t *pmu, ccnt_t counts[NUM_AVERAGE_EVENTS])
+{
+    ccnt_t end;
+    SEL4BENCH_READ_CCNT(end);
+    sel4bench_read_and_stop_counters(pmu->mask, pmu->chunk, pmu->n_counters, counts);
+    counts[CYCLE_COUNT_EVENT] = end - pmu->start;
+    COMPILER_MEMORY_FENCE();
+}
+
+/* One rotation: count every event over AVERAGE_RUNS runs of op into counts */
+#define PMU_AVERAGE(pmu, counts, op) do { \
+    for (seL4_Word _pmu_chunk = 0; _pmu_chunk < pmu_chunks(pmu); _pmu_chunk++) { \
+        pmu_chunk_start(pmu, _pmu_chunk); \
+        for (int _pmu_i = 0; _pmu_i < AVERAGE_RUNS; _pmu_i++) { \
+            op; \
+        } \
+        pmu_chunk_stop(pmu, counts); \
+    } \
+} while (0)
+
+/* rotations rotations, into rows[rotations][NUM_AVERAGE_EVENTS] */
+#define PMU_CAPTURE(rows, rotations, op) do { \
+    pmu_session_t _pmu = pmu_session_new(); \
+    for (seL4_Word _pmu_rotation = 0; _pmu_rotation < (rotations); _pmu_rotation++) { \
+        PMU_AVERAGE(&_pmu, (rows)[_pmu_rotation], op); \
+    } \
+} while (0)
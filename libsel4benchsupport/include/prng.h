@@ -0,0 +1,43 @@
+/*
+ * Copyright 2020, Data61, CSIRO (ABN 41 687 119 230)
+ *
+ * SPDX-License-Identifier: BSD-2-Clause
+ */
+#pragma once
+
+#include <stdint.h>
+
+/*
+ * Small, fast pseudo random number generator (splitmix64) for the statistics and
+ * for shuffling benchmarks. It is not suitable for anything security related, but
+ * the same seed always gives the same sequence on every platform, so runs can be
+ * reproduced from a recorded seed.
+ */
+typedef struct prng {
+    uint64_t state;
+} prng_t;
+
+static inline void prng_seed(prng_t *prng, uint64_t seed)
+{
+    prng->state = seed;
+}
+
+static inline uint64_t prng_next(prng_t *prng)
+{
+    uint64_t z = (prng->state += 0x9e3779b97f4a7c15ull);
+    z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9ull;
+    z = (z ^ (z >> 27)) * 0x94d049bb133111ebull;
+    return z ^ (z >> 31);
+}
+
+/* Uniformly distributed number in [0, bound), bound > 0 */
+static inline uint64_t prng_below(prng_t *prng, uint64_t bound)
+{
+    /* reject the top of the range that would make the result biased */
+    uint64_t limit = UINT64_MAX - UINT64_MAX % bound;
+    uint64_t r;
+    do {
+        r = prng_next(prng);
+    } while (r >= limit);
+    return r % bound;
+}
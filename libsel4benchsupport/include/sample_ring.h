@@ -0,0 +1,103 @@
+/*
+ * Copyright 2020, Data61, CSIRO (ABN 41 687 119 230)
+ *
+ * SPDX-License-Identifier: BSD-2-Clause
+ */
+#pragma once
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <sel4/types.h>
+#include <sel4bench/sel4bench.h>
+#include <utils/util.h>
+
+/*
+ * Single producer, single consumer ring of samples in memory shared between a
+ * benchmark (the producer) and sel4bench (the consumer).
+ *
+ * The fixed size result structures shared through the results pages limit how
+ * many samples a benchmark can record. With a ring, the benchmark appends samples
+ * as it measures them and sel4bench consumes them whenever the benchmark asks
+ * for the ring to be drained (see benchmark_ring_push), so the number of samples
+ * is only limited by how long we are prepared to wait.
+ *
+ * head is only written by the producer, tail only by the consumer. Both only ever
+ * increase, and the slot for an index is index & (size - 1).
+ */
+
+/* keep the producer and consumer indices on separate cache lines */
+#define SAMPLE_RING_LINE_SIZE 64
+
+typedef struct sample_ring {
+    /* index of the next sample the producer writes */
+    size_t head;
+    char head_pad[SAMPLE_RING_LINE_SIZE - sizeof(size_t)];
+    /* index of the next sample the consumer reads */
+    size_t tail;
+    char tail_pad[SAMPLE_RING_LINE_SIZE - sizeof(size_t)];
+    /* number of slots in samples, a power of 2 */
+    size_t size;
+    /* benchmark specific identifier of what is being measured. Only changed by the
+     * producer while the ring is empty */
+    seL4_Word stream;
+    ccnt_t samples[] ALIGN(SAMPLE_RING_LINE_SIZE);
+} sample_ring_t;
+
+/*
+ * Initialise a ring occupying bytes bytes of memory. Called by the consumer before
+ * the memory is shared with the producer.
+ */
+static inline void sample_ring_init(sample_ring_t *ring, size_t bytes)
+{
+    size_t slots = (bytes - sizeof(sample_ring_t)) / sizeof(ccnt_t);
+    ring->head = 0;
+    ring->tail = 0;
+    ring->stream = 0;
+    ring->size = 1;
+    while (ring->size * 2 <= slots) {
+        ring->size *= 2;
+    }
+}
+
+/* Number of samples in the ring that have not been consumed yet */
+static inline size_t sample_ring_count(sample_ring_t *ring)
+{
+    return __atomic_load_n(&ring->head, __ATOMIC_ACQUIRE) - __atomic_load_n(&ring->tail, __ATOMIC_ACQUIRE);
+}
+
+/*
+ * Append a sample to the ring.
+ *
+ * @return false if the ring is full and the sample was not added.
+ */
+static inline bool sample_ring_push(sample_ring_t *ring, ccnt_t sample)
+{
+    size_t head = ring->head;
+    if (head - __atomic_load_n(&ring->tail, __ATOMIC_ACQUIRE) == ring->size) {
+        return false;
+    }
+    ring->samples[head & (ring->size - 1)] = sample;
+    __atomic_store_n(&ring->head, head + 1, __ATOMIC_RELEASE);
+    return true;
+}
+
+/*
+ * Get the longest run of unconsumed samples that is contiguous in memory.
+ *
+ * @param[out] samples set to the first unconsumed sample.
+ * @return the number of samples available at samples.
+ */
+static inline size_t sample_ring_peek(sample_ring_t *ring, ccnt_t **samples)
+{
+    size_t tail = ring->tail;
+    size_t count = __atomic_load_n(&ring->head, __ATOMIC_ACQUIRE) - tail;
+    size_t offset = tail & (ring->size - 1);
+    *samples = &ring->samples[offset];
+    return MIN(count, ring->size - offset);
+}
+
+/* Release n samples returned by sample_ring_peek back to the producer */
+static inline void sample_ring_consume(sample_ring_t *ring, size_t n)
+{
+    __atomic_store_n(&ring->tail, ring->tail + n, __ATOMIC_RELEASE);
+}
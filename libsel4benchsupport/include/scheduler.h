@@ -7,12 +7,20 @@
 
 #include <sel4bench/sel4bench.h>
 #include <benchmark.h>
+#include <calibration.h>
+#include <pmu.h>
 
 #define N_IGNORED 10
 #define N_RUNS (100 + N_IGNORED)
 #define N_PRIOS ((seL4_MaxPrio + seL4_WordBits - 1) / seL4_WordBits)
+/* with CONFIG_SHUFFLE_ORDER, the samples of each prio are taken in N_SLICES slices,
+ * with those of the other prios in between */
+#define N_SLICES 10
+compile_time_assert(scheduler_slices_divide_runs, N_RUNS % N_SLICES == 0);
 
 typedef struct scheduler_results_t {
+    /* overheads the samples are corrected by, from the root task */
+    calibration_t calibration;
     ccnt_t thread_results[N_PRIOS][N_RUNS];
     ccnt_t process_results[N_PRIOS][N_RUNS];
     ccnt_t overhead_signal[N_RUNS];
@@ -23,8 +31,15 @@ typedef struct scheduler_results_t {
     ccnt_t overhead_ccnt[N_RUNS];
     ccnt_t average_yield[N_RUNS][NUM_AVERAGE_EVENTS];
 
+    /* events counted for each row, with CONFIG_PMU_EVENTS */
+    pmu_results_t thread_events[N_PRIOS];
+    pmu_results_t process_events[N_PRIOS];
+    pmu_results_t thread_yield_events;
+    pmu_results_t process_yield_events;
+
     /* Data for early processing */
     ccnt_t overhead_ccnt_min;
+    ccnt_t overhead_signal_min;
 
     ccnt_t thread_yield_ep_sum;
     ccnt_t thread_yield_ep_sum2;
@@ -7,21 +7,29 @@
 
 #include <sel4bench/sel4bench.h>
 #include <benchmark.h>
+#include <calibration.h>
+#include <histogram.h>
+#include <pmu.h>
 
 #define N_IGNORED 10
 #define N_RUNS (100 + N_IGNORED)
 
 typedef struct signal_results {
+    /* overheads the samples are corrected by, from the root task */
+    calibration_t calibration;
     /* Data for late processing */
     ccnt_t lo_prio_results[N_RUNS];
     ccnt_t hi_prio_results[N_RUNS];
     ccnt_t hi_prio_average[N_RUNS][NUM_AVERAGE_EVENTS];
-    ccnt_t overhead[N_RUNS]; /* "overhead" is used by early processing as well */
+    /* events counted for a signal to a high prio thread, with CONFIG_PMU_EVENTS */
+    pmu_results_t lo_prio_events;
+    ccnt_t overhead[N_RUNS]; /* measured for reference, the calibrated one is subtracted */
     /* Data for early processing */
     ccnt_t lo_sum; /* sum of samples */
     ccnt_t lo_sum2; /* sum of squared samples */
     ccnt_t lo_num; /* number of samples to process */
-    ccnt_t overhead_min; /* min overhead found in "overhead" array */
+    ccnt_t overhead_min; /* calibrated signal overhead */
+    histogram_t lo_histogram; /* histogram of the same samples */
     /* array required by report output function
     Zeros, but can be used for diagnostic data */
     ccnt_t diag_results[N_RUNS]; /* array required by report output function */
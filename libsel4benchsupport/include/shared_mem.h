@@ -0,0 +1,53 @@
+/*
+ * Copyright 2020, Data61, CSIRO (ABN 41 687 119 230)
+ *
+ * SPDX-License-Identifier: BSD-2-Clause
+ */
+#pragma once
+
+#include <stddef.h>
+#include <sel4/sel4.h>
+#include <sel4benchsupport/gen_config.h>
+#include <utils/util.h>
+#include <vspace/vspace.h>
+
+/*
+ * Memory shared between the driver and a benchmark (results, args and the sample
+ * ring), or between the processes of a benchmark (e.g. a start time).
+ *
+ * Timed loops write to this memory, so a TLB miss on it ends up in a measurement.
+ * With CONFIG_LARGE_SHARED_PAGES, memory larger than a 4K page is mapped with large
+ * pages, which cover the results of most benchmarks with a single TLB entry, falling
+ * back to 4K pages if there are no large frames to be had. Memory that fits in a 4K
+ * page (the args, a start time) is mapped with one. shared_mem_prefault touches the memory so
+ * that the first timed writes do not take the misses either.
+ */
+
+/* Number of pages of page_bits bytes needs */
+static inline size_t shared_mem_pages(size_t bytes, size_t page_bits)
+{
+    return BYTES_TO_SIZE_BITS_PAGES(bytes, page_bits);
+}
+
+/* Number of 4K frames in the pages of page_bits bytes are shared in */
+static inline size_t shared_mem_frames(size_t bytes, size_t page_bits)
+{
+    return shared_mem_pages(bytes, page_bits) << (page_bits - seL4_PageBits);
+}
+
+/*
+ * Allocate and map memory to share.
+ *
+ * @param vspace    vspace to map the memory in.
+ * @param bytes     size of the memory.
+ * @param page_bits set to the size of the pages used, to share and unmap them with.
+ * @return the memory, NULL if it could not be allocated.
+ */
+void *shared_mem_alloc(vspace_t *vspace, size_t bytes, size_t *page_bits);
+
+/*
+ * Touch every page of a range of memory, so that it is in the TLB and, where the
+ * architecture tracks it, already marked accessed and dirty. The contents are
+ * written back unchanged, so do not call this while another thread writes to it.
+ */
+void shared_mem_prefault(void *vaddr, size_t bytes);
@@ -0,0 +1,70 @@
+/*
+ * Copyright 2020, Data61, CSIRO (ABN 41 687 119 230)
+ *
+ * SPDX-License-Identifier: BSD-2-Clause
+ */
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+#include <sel4benchsupport/gen_config.h>
+#include <utils/util.h>
+#include <prng.h>
+
+/*
+ * Order in which a benchmark runs its configurations.
+ *
+ * Benchmarks that run several configurations (e.g. the points of the ipc sweep, the
+ * priorities of the scheduler benchmark) run them in rounds, each taking some of the
+ * samples of every configuration (see harness_slice in harness.h). Run in the same order
+ * every round, slow drift (temperature, frequency scaling, the cache state one
+ * configuration leaves for the next) biases some configurations against others.
+ * With ShuffleOrder, each round runs them in a new random order instead:
+ *
+ *     shuffle_t shuffle = shuffle_new(env->args->order_seed);
+ *     for (each round) {
+ *         size_t order[n];
+ *         shuffle_order(&shuffle, n, order);
+ *         for (size_t k = 0; k < n; k++) {
+ *             run configuration order[k], storing its samples under order[k]
+ *         }
+ *     }
+ *
+ * The samples of a configuration still go to its own results, so the root task
+ * aggregates them per configuration as before.
+ *
+ * The root task passes each run of a benchmark its own seed (order_seed in
+ * benchmark_args_t), drawn from the one recorded in the output as "Order seed".
+ * Setting ShuffleSeed to that seed runs everything in the same order again, as long
+ * as the same benchmarks run.
+ */
+
+typedef struct {
+    prng_t prng;
+} shuffle_t;
+
+/* A shuffle for a run, from seed */
+static inline shuffle_t shuffle_new(uint64_t seed)
+{
+    shuffle_t shuffle;
+    prng_seed(&shuffle.prng, seed);
+    return shuffle;
+}
+
+/* Fill order with the n configurations in the order to run them this round */
+static inline void shuffle_order(shuffle_t *shuffle, size_t n, size_t order[n])
+{
+    for (size_t i = 0; i < n; i++) {
+        order[i] = i;
+    }
+    if (!config_set(CONFIG_SHUFFLE_ORDER)) {
+        return;
+    }
+    /* Fisher-Yates */
+    for (size_t i = n; i > 1; i--) {
+        size_t j = prng_below(&shuffle->prng, i);
+        size_t tmp = order[i - 1];
+        order[i - 1] = order[j];
+        order[j] = tmp;
+    }
+}
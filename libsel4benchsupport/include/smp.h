@@ -9,22 +9,37 @@
 #include <autoconf.h>
 #include <sel4bench/sel4bench.h>
 #include <sel4utils/process.h>
+#include <utils/compile_time.h>
+#include <benchmark_types.h>
+#include <sweep.h>
 
 #define RUNS 10
-#define TESTS ARRAY_SIZE(smp_benchmark_params)
+#define TESTS sweep_size(&smp_sweep)
+/* The sweep can be overridden (smp.sweep in the parameter file) with the delays,
+ * in cycles, to use. */
+#define MAX_TESTS SEL4BENCH_MAX_PARAMS
 
-typedef struct benchmark_params {
-    const char *name;
-    const double delay;
-} benchmark_params_t;
+/* delays between IPCs, in cycles */
+static const seL4_Word smp_delays[] = { 500, 4000, 32000 };
 
-static const
-benchmark_params_t smp_benchmark_params[] = {
-    { .name = "500 cycles",   .delay = 500.000, },
-    { .name = "4000 cycles",  .delay = 4000.00, },
-    { .name = "32000 cycles", .delay = 32000.0, },
+static const sweep_axis_t smp_axes[] = {
+    {
+        .name = "Cycles",
+        .type = SWEEP_INTEGER,
+        .n_values = ARRAY_SIZE(smp_delays),
+        .values = smp_delays,
+    },
 };
 
+static const sweep_t smp_sweep = {
+    .n_axes = ARRAY_SIZE(smp_axes),
+    .axes = smp_axes,
+};
+compile_time_assert(smp_default_sweep_fits, ARRAY_SIZE(smp_delays) <= MAX_TESTS);
+
 typedef struct smp_results {
-    ccnt_t benchmarks_result[TESTS][CONFIG_MAX_NUM_NODES][RUNS];
+    /* number of tests that were run, and the delay each one used */
+    size_t n_tests;
+    ccnt_t delay[MAX_TESTS];
+    ccnt_t benchmarks_result[MAX_TESTS][CONFIG_MAX_NUM_NODES][RUNS];
 } smp_results_t;
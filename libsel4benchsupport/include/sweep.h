@@ -0,0 +1,121 @@
+/*
+ * Copyright 2020, Data61, CSIRO (ABN 41 687 119 230)
+ *
+ * SPDX-License-Identifier: BSD-2-Clause
+ */
+#pragma once
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <sel4/types.h>
+
+/*
+ * Parametric sweeps.
+ *
+ * A sweep declares the parameters (axes) of a benchmark, and the values each of
+ * them takes. The benchmark runs every point of the cartesian product of the axes,
+ * except those that the sweep's valid function rejects (combinations the benchmark
+ * cannot run). Adding a value or an axis changes the points that are run without
+ * writing out the product by hand.
+ *
+ * A point is identified by its index in the full product, in which the last axis
+ * changes fastest. Benchmarks store the indices of the points they ran in their
+ * results, so that sel4bench can label each result with the values of the axes
+ * (see sweep_to_columns in the sel4bench app).
+ *
+ * Everything here uses integer arithmetic only, as benchmarks are built without
+ * floating point registers.
+ */
+
+/* most axes a sweep can have */
+#define SWEEP_MAX_AXES 8
+
+typedef enum sweep_axis_type {
+    /* the values are output as integers */
+    SWEEP_INTEGER,
+    /* the values are output as booleans */
+    SWEEP_BOOL,
+    /* the values are output as the corresponding entry of labels */
+    SWEEP_LABEL,
+} sweep_axis_type_t;
+
+typedef struct sweep_axis {
+    /* header of the output column with the values of this axis */
+    const char *name;
+    sweep_axis_type_t type;
+    /* number of values the axis takes, at least 1 */
+    size_t n_values;
+    const seL4_Word *values;
+    /* for SWEEP_LABEL, the name of each value, indexed by the value */
+    const char *const *labels;
+} sweep_axis_t;
+
+typedef struct sweep sweep_t;
+
+struct sweep {
+    size_t n_axes;
+    const sweep_axis_t *axes;
+    /* does a point of the product make a valid configuration? NULL if all do */
+    bool (*valid)(const sweep_t *sweep, size_t point);
+};
+
+/* Number of points in the full product of the axes, valid or not */
+static inline size_t sweep_product(const sweep_t *sweep)
+{
+    size_t product = 1;
+    for (size_t a = 0; a < sweep->n_axes; a++) {
+        product *= sweep->axes[a].n_values;
+    }
+    return product;
+}
+
+/* Index of the value that axis takes at point */
+static inline size_t sweep_value_index(const sweep_t *sweep, size_t point, size_t axis)
+{
+    /* mixed radix digits, the last axis is the least significant */
+    for (size_t a = sweep->n_axes - 1; a > axis; a--) {
+        point /= sweep->axes[a].n_values;
+    }
+    return point % sweep->axes[axis].n_values;
+}
+
+/* Value that axis takes at point */
+static inline seL4_Word sweep_value(const sweep_t *sweep, size_t point, size_t axis)
+{
+    return sweep->axes[axis].values[sweep_value_index(sweep, point, axis)];
+}
+
+static inline bool sweep_valid(const sweep_t *sweep, size_t point)
+{
+    return point < sweep_product(sweep) && (sweep->valid == NULL || sweep->valid(sweep, point));
+}
+
+/*
+ * Index of the n-th valid point, or sweep_product(sweep) if there are not that
+ * many valid points.
+ */
+static inline size_t sweep_point(const sweep_t *sweep, size_t n)
+{
+    size_t product = sweep_product(sweep);
+    size_t point;
+    for (point = 0; point < product; point++) {
+        if (sweep_valid(sweep, point)) {
+            if (n == 0) {
+                break;
+            }
+            n--;
+        }
+    }
+    return point;
+}
+
+/* Number of valid points */
+static inline size_t sweep_size(const sweep_t *sweep)
+{
+    size_t product = sweep_product(sweep);
+    size_t size = 0;
+    for (size_t point = 0; point < product; point++) {
+        size += sweep_valid(sweep, point);
+    }
+    return size;
+}
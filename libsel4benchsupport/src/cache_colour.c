@@ -0,0 +1,94 @@
+/*
+ * Copyright 2020, Data61, CSIRO (ABN 41 687 119 230)
+ *
+ * SPDX-License-Identifier: BSD-2-Clause
+ */
+
+#include <autoconf.h>
+#include <sel4benchsupport/gen_config.h>
+#include <utils/util.h>
+#include <vka/capops.h>
+#include <vka/kobject_t.h>
+
+#include <cache_colour.h>
+
+#ifdef CONFIG_CACHE_COLOURING
+
+/* frames to try for one of an allowed colour before giving up, a generous multiple of
+ * the colours so that a run of frames of other colours does not fail the allocation */
+#define CACHE_COLOUR_TRIES (CONFIG_CACHE_COLOURS * 64)
+
+/* the vka before colouring, to allocate from */
+static vka_t parent;
+static size_t rejected;
+
+static int colour_alloc(const cspacepath_t *dest, seL4_Word type, seL4_Word size_bits, seL4_Word *res,
+                        vka_utspace_alloc_fn alloc)
+{
+    if (type != kobject_get_type(KOBJECT_FRAME, seL4_PageBits)) {
+        return alloc(parent.data, dest, type, size_bits, res);
+    }
+
+    for (int i = 0; i < CACHE_COLOUR_TRIES; i++) {
+        seL4_Word cookie;
+        int error = alloc(parent.data, dest, type, size_bits, &cookie);
+        if (error) {
+            return error;
+        }
+        uintptr_t paddr = vka_utspace_paddr(&parent, cookie, type, size_bits);
+        if (paddr == VKA_NO_PADDR || cache_colour_allowed(paddr)) {
+            *res = cookie;
+            return 0;
+        }
+        /* keep the frame, but not its cap, so that the allocator moves on */
+        error = vka_cnode_delete(dest);
+        ZF_LOGF_IF(error, "Failed to delete frame of colour %d", cache_colour_of(paddr));
+        rejected++;
+    }
+
+    ZF_LOGE("No frame of colours %#x in %d tries", (unsigned int) CONFIG_CACHE_COLOUR_MASK,
+            CACHE_COLOUR_TRIES);
+    return -1;
+}
+
+static int colour_utspace_alloc(void *data, const cspacepath_t *dest, seL4_Word type, seL4_Word size_bits,
+                                seL4_Word *res)
+{
+    return colour_alloc(dest, type, size_bits, res, parent.utspace_alloc);
+}
+
+static int colour_utspace_alloc_maybe_device(void *data, const cspacepath_t *dest, seL4_Word type,
+                                             seL4_Word size_bits, bool can_use_dev, seL4_Word *res)
+{
+    if (type != kobject_get_type(KOBJECT_FRAME, seL4_PageBits)) {
+        return vka_utspace_alloc_maybe_device(&parent, dest, type, size_bits, can_use_dev, res);
+    }
+    /* coloured frames come from normal memory only */
+    return colour_alloc(dest, type, size_bits, res, parent.utspace_alloc);
+}
+
+void cache_colour_vka(vka_t *vka)
+{
+    assert(parent.utspace_alloc == NULL);
+    parent = *vka;
+    vka->utspace_alloc = colour_utspace_alloc;
+    vka->utspace_alloc_maybe_device = colour_utspace_alloc_maybe_device;
+}
+
+size_t cache_colour_rejected(void)
+{
+    return rejected;
+}
+
+#else
+
+void cache_colour_vka(vka_t *vka)
+{
+}
+
+size_t cache_colour_rejected(void)
+{
+    return 0;
+}
+
+#endif /* CONFIG_CACHE_COLOURING */
@@ -0,0 +1,50 @@
+/*
+ * Copyright 2020, Data61, CSIRO (ABN 41 687 119 230)
+ *
+ * SPDX-License-Identifier: BSD-2-Clause
+ */
+
+#include <autoconf.h>
+#include <sel4benchsupport/gen_config.h>
+#include <utils/util.h>
+
+#include <cache_state.h>
+
+#ifdef CONFIG_CACHE_STATE_POLLUTE
+
+#ifdef CONFIG_L1_CACHE_LINE_SIZE_BITS
+#define POLLUTE_STRIDE BIT(CONFIG_L1_CACHE_LINE_SIZE_BITS)
+#else
+/* the smallest line size there is, so that every line is written */
+#define POLLUTE_STRIDE 32
+#endif
+
+#ifdef CONFIG_ARCH_X86
+#define NOP_BYTES 1
+#else
+#define NOP_BYTES 4
+#endif
+
+#define POLLUTE_STR_(x) #x
+#define POLLUTE_STR(x) POLLUTE_STR_(x)
+
+static char pollute_buffer[CONFIG_CACHE_POLLUTE_BYTES] ALIGN(BIT(seL4_PageBits));
+
+/* run CONFIG_CACHE_POLLUTE_CODE_BYTES of nops */
+static NO_INLINE void pollute_code(void)
+{
+    asm volatile(".rept " POLLUTE_STR(CONFIG_CACHE_POLLUTE_CODE_BYTES) " / " POLLUTE_STR(NOP_BYTES) "\n"
+                 "nop\n"
+                 ".endr\n" ::: "memory");
+}
+
+void cache_state_pollute(void)
+{
+    volatile char *buffer = pollute_buffer;
+    for (size_t i = 0; i < sizeof(pollute_buffer); i += POLLUTE_STRIDE) {
+        buffer[i]++;
+    }
+    pollute_code();
+}
+
+#endif /* CONFIG_CACHE_STATE_POLLUTE */
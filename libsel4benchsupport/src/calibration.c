@@ -0,0 +1,172 @@
+/*
+ * Copyright 2020, Data61, CSIRO (ABN 41 687 119 230)
+ *
+ * SPDX-License-Identifier: BSD-2-Clause
+ */
+
+#include <autoconf.h>
+#include <sel4benchsupport/gen_config.h>
+#include <sel4/sel4.h>
+#include <sel4bench/sel4bench.h>
+#include <utils/util.h>
+
+#include <calibration.h>
+
+/* arch/ipc.h requires these defines */
+#define NOPS ""
+
+#include <arch/ipc.h>
+#include <arch/signal.h>
+#include <arch/fault.h>
+#include <arch/hardware.h>
+
+/* time op the way the benchmarks that subtract the overhead do */
+#define CALIBRATION_TIME(op, before, after) do { \
+    before(start); \
+    op; \
+    after(end); \
+} while (0)
+
+static ccnt_t calibration_sample(calibration_overhead_id_t id)
+{
+    ccnt_t start = 0, end = 0;
+    seL4_MessageInfo_t tag = seL4_MessageInfo_new(0, 0, 0, 0);
+    seL4_MessageInfo_t tag10 = seL4_MessageInfo_new(0, 0, 0, 10);
+    UNUSED seL4_Word ip = 0;
+    UNUSED seL4_CPtr reply = 0;
+
+    COMPILER_MEMORY_FENCE();
+    for (int i = 0; i < CALIBRATION_WARMUPS; i++) {
+        switch (id) {
+        case CALIBRATION_CCNT:
+            CALIBRATION_TIME(, SEL4BENCH_READ_CCNT, SEL4BENCH_READ_CCNT);
+            break;
+        case CALIBRATION_CALL:
+            CALIBRATION_TIME(DO_NOP_CALL(0, tag), READ_COUNTER_BEFORE, READ_COUNTER_AFTER);
+            break;
+        case CALIBRATION_REPLY_RECV:
+            CALIBRATION_TIME(DO_NOP_REPLY_RECV(0, tag, 0), READ_COUNTER_BEFORE, READ_COUNTER_AFTER);
+            break;
+        case CALIBRATION_SEND:
+            CALIBRATION_TIME(DO_NOP_SEND(0, tag), READ_COUNTER_BEFORE, READ_COUNTER_AFTER);
+            break;
+        case CALIBRATION_RECV:
+            CALIBRATION_TIME(DO_NOP_RECV(0, 0), READ_COUNTER_BEFORE, READ_COUNTER_AFTER);
+            break;
+        case CALIBRATION_CALL_10:
+            CALIBRATION_TIME(DO_NOP_CALL_10(0, tag10), READ_COUNTER_BEFORE, READ_COUNTER_AFTER);
+            break;
+        case CALIBRATION_REPLY_RECV_10:
+            CALIBRATION_TIME(DO_NOP_REPLY_RECV_10(0, tag10, 0), READ_COUNTER_BEFORE, READ_COUNTER_AFTER);
+            break;
+        case CALIBRATION_SIGNAL:
+            CALIBRATION_TIME(DO_NOP_SIGNAL(0), SEL4BENCH_READ_CCNT, SEL4BENCH_READ_CCNT);
+            break;
+        case CALIBRATION_REPLY_RECV_1:
+            CALIBRATION_TIME(DO_NOP_REPLY_RECV_1(0, ip, reply), SEL4BENCH_READ_CCNT, SEL4BENCH_READ_CCNT);
+            break;
+        case CALIBRATION_NULLSYSCALL:
+#ifdef CONFIG_ENABLE_BENCHMARKS
+            CALIBRATION_TIME(DO_NOP_NULLSYSCALL(), SEL4BENCH_READ_CCNT, SEL4BENCH_READ_CCNT);
+#endif
+            break;
+        default:
+            ZF_LOGF("Unknown overhead %d", id);
+        }
+    }
+    COMPILER_MEMORY_FENCE();
+
+    return end - start;
+}
+
+static void calibration_sort(size_t n, ccnt_t samples[n])
+{
+    /* insertion sort, there are only CALIBRATION_SAMPLES */
+    for (size_t i = 1; i < n; i++) {
+        ccnt_t sample = samples[i];
+        size_t j = i;
+        for (; j > 0 && samples[j - 1] > sample; j--) {
+            samples[j] = samples[j - 1];
+        }
+        samples[j] = sample;
+    }
+}
+
+/*
+ * @return the smallest of the sorted samples that are within the tolerance of their
+ *         mode, and in close the number of those samples.
+ */
+static ccnt_t calibration_mode(size_t n, const ccnt_t sorted[n], size_t *close)
+{
+    ccnt_t mode = sorted[0];
+    size_t mode_count = 0;
+    for (size_t i = 0; i < n;) {
+        size_t j = i;
+        while (j < n && sorted[j] == sorted[i]) {
+            j++;
+        }
+        if (j - i > mode_count) {
+            mode = sorted[i];
+            mode_count = j - i;
+        }
+        i = j;
+    }
+
+    ccnt_t low = mode;
+    *close = 0;
+    for (size_t i = 0; i < n; i++) {
+        ccnt_t distance = sorted[i] > mode ? sorted[i] - mode : mode - sorted[i];
+        if (distance <= CONFIG_CALIBRATION_TOLERANCE) {
+            low = MIN(low, sorted[i]);
+            (*close)++;
+        }
+    }
+    return low;
+}
+
+overhead_t calibration_estimate(calibration_overhead_id_t id, calibration_sample_fn_t sample)
+{
+    overhead_t overhead = {
+        .value = -1,
+        .confidence = 0,
+        .stable = false,
+    };
+    ccnt_t min = -1;
+    ccnt_t samples[CALIBRATION_SAMPLES];
+
+    for (int round = 0; round < CALIBRATION_ROUNDS; round++) {
+        for (int i = 0; i < CALIBRATION_SAMPLES; i++) {
+            samples[i] = sample(id);
+        }
+        calibration_sort(CALIBRATION_SAMPLES, samples);
+        min = MIN(min, samples[0]);
+
+        size_t close;
+        ccnt_t value = calibration_mode(CALIBRATION_SAMPLES, samples, &close);
+        uint8_t confidence = close * 100 / CALIBRATION_SAMPLES;
+        if (confidence > overhead.confidence) {
+            overhead.confidence = confidence;
+        }
+        if (confidence >= CONFIG_CALIBRATION_CONFIDENCE) {
+            overhead.value = value;
+            overhead.stable = true;
+            return overhead;
+        }
+    }
+
+    ZF_LOGW("Overhead of %s is not stable (%d%% of samples within %d cycles of the mode), "
+            "using the minimum of "CCNT_FORMAT, calibration_names[id], overhead.confidence,
+            CONFIG_CALIBRATION_TOLERANCE, min);
+    overhead.value = min;
+    return overhead;
+}
+
+void calibration_measure(calibration_t *calibration)
+{
+    sel4bench_init();
+    for (int id = 0; id < CALIBRATION_N_OVERHEADS; id++) {
+        calibration->overheads[id] = calibration_estimate(id, calibration_sample);
+    }
+    sel4bench_destroy();
+    calibration->valid = true;
+}
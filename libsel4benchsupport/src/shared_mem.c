@@ -0,0 +1,39 @@
+/*
+ * Copyright 2020, Data61, CSIRO (ABN 41 687 119 230)
+ *
+ * SPDX-License-Identifier: BSD-2-Clause
+ */
+
+#include <autoconf.h>
+#include <sel4benchsupport/gen_config.h>
+#include <utils/util.h>
+
+#include <shared_mem.h>
+
+void *shared_mem_alloc(vspace_t *vspace, size_t bytes, size_t *page_bits)
+{
+    /* a large page has frames of every cache colour. Memory that fits in a 4K page
+     * needs only one TLB entry already, so a large frame would be wasted on it */
+    if (config_set(CONFIG_LARGE_SHARED_PAGES) && !config_set(CONFIG_CACHE_COLOURING) &&
+        bytes > BIT(seL4_PageBits)) {
+        void *vaddr = vspace_new_pages(vspace, seL4_AllRights, shared_mem_pages(bytes, seL4_LargePageBits),
+                                       seL4_LargePageBits);
+        if (vaddr != NULL) {
+            *page_bits = seL4_LargePageBits;
+            return vaddr;
+        }
+        ZF_LOGW("No large pages for %zu bytes of shared memory, using 4K pages", bytes);
+    }
+
+    *page_bits = seL4_PageBits;
+    return vspace_new_pages(vspace, seL4_AllRights, shared_mem_pages(bytes, seL4_PageBits), seL4_PageBits);
+}
+
+void shared_mem_prefault(void *vaddr, size_t bytes)
+{
+    uintptr_t end = (uintptr_t) vaddr + bytes;
+    for (uintptr_t addr = (uintptr_t) vaddr; addr < end; addr = ALIGN_DOWN(addr, PAGE_SIZE_4K) + PAGE_SIZE_4K) {
+        volatile char *byte = (volatile char *) addr;
+        *byte = *byte;
+    }
+}
@@ -27,6 +27,8 @@
 #include <libfdt.h>
 
 #include <benchmark.h>
+#include <cache_colour.h>
+#include <shared_mem.h>
 
 #include <utils/util.h>
 #include <sel4/sel4.h>
@@ -129,20 +131,26 @@ static void init_allocator_vspace(allocman_t *allocator, vspace_t *vspace)
 
 static void init_vspace(vka_t *vka, vspace_t *vspace, sel4utils_alloc_data_t *data,
                         size_t stack_pages, uintptr_t stack_vaddr, uintptr_t results_addr,
-                        size_t results_bytes, uintptr_t args_vaddr)
+                        size_t results_bytes, benchmark_args_t *args)
 {
     int index;
-    size_t results_size, ipc_buffer_size;
+    size_t results_size, ipc_buffer_size, args_size, ring_size;
 
-    /* set up existing frames - stack, ipc buffer, results */
-    results_size = BYTES_TO_SIZE_BITS_PAGES(results_bytes, seL4_PageBits);
+    /* set up existing frames - stack, ipc buffer, results, args, sample ring. The shared
+     * ones may be mapped with large pages, reserve all the 4K frames they cover */
+    results_size = shared_mem_frames(results_bytes, args->results_page_bits);
     ipc_buffer_size = BYTES_TO_SIZE_BITS_PAGES(sizeof(seL4_IPCBuffer), seL4_PageBits);
-    void *existing_frames[stack_pages + results_size + ipc_buffer_size];
+    args_size = shared_mem_frames(sizeof(benchmark_args_t), args->args_page_bits);
+    ring_size = args->ring_pages > 0 ? shared_mem_frames(args->ring_pages * PAGE_SIZE_4K, args->ring_page_bits) : 0;
+    /* + 1 for the NULL terminator */
+    void *existing_frames[stack_pages + results_size + ipc_buffer_size + args_size + ring_size + 1];
 
     index = add_frames(existing_frames, 0, results_addr, results_size);
     index = add_frames(existing_frames, index, (uintptr_t) seL4_GetIPCBuffer(), ipc_buffer_size);
     index = add_frames(existing_frames, index, stack_vaddr, stack_pages);
-    index = add_frames(existing_frames, index, (uintptr_t) args_vaddr, 1);
+    index = add_frames(existing_frames, index, (uintptr_t) args, args_size);
+    index = add_frames(existing_frames, index, (uintptr_t) args->ring, ring_size);
+    existing_frames[index] = NULL;
 
     if (sel4utils_bootstrap_vspace(vspace, data, SEL4UTILS_PD_SLOT, vka, NULL, NULL, existing_frames)) {
         ZF_LOGF("Failed to bootstrap vspace");
@@ -180,12 +188,23 @@ static inline sel4utils_process_config_t get_process_config(env_t *env, uint8_t
     config = process_config_create_vspace(config, &env->region, 1);
     config = process_config_priority(config, prio);
 #ifdef CONFIG_KERNEL_MCS
-    config.sched_params = sched_params_round_robin(config.sched_params, &env->simple, 0,
+    config.sched_params = sched_params_round_robin(config.sched_params, &env->simple, env->args->core,
                                                    CONFIG_BOOT_THREAD_TIME_SLICE * NS_IN_US);
+#else
+    config.sched_params.core = env->args->core;
 #endif
     return process_config_mcp(config, prio);
 }
 
+/* Move a thread of the benchmark to the core the benchmark runs on, if that is not core 0 */
+static void set_benchmark_core(env_t *env, sel4utils_thread_t *thread, sched_params_t params, char *name)
+{
+    if (env->args->core != 0) {
+        int error = sel4utils_set_sched_affinity(thread, params);
+        ZF_LOGF_IF(error, "Failed to move %s to core %d", name, env->args->core);
+    }
+}
+
 void benchmark_shallow_clone_process(env_t *env, sel4utils_process_t *process, uint8_t prio, void *entry_point,
                                      char *name)
 {
@@ -193,6 +212,7 @@ void benchmark_shallow_clone_process(env_t *env, sel4utils_process_t *process, u
     sel4utils_process_config_t config = get_process_config(env, prio, entry_point);
     error = sel4utils_configure_process_custom(process, &env->slab_vka, &env->vspace, config);
     ZF_LOGF_IFERR(error, "Failed to configure process %s", name);
+    set_benchmark_core(env, &process->thread, config.sched_params, name);
 
     /* clone the text segment into the vspace - note that as we are only cloning the text
      * segment, you will not be able to use anything that relies on initialisation in benchmark
@@ -216,6 +236,7 @@ void benchmark_configure_thread_in_process(env_t *env, sel4utils_process_t *proc
 
     error = sel4utils_configure_process_custom(thread, &env->slab_vka, &env->vspace, config);
     ZF_LOGF_IFERR(error, "Failed to configure process %s", name);
+    set_benchmark_core(env, &thread->thread, config.sched_params, name);
 
     NAME_THREAD(thread->thread.tcb.cptr, name);
 }
@@ -228,12 +249,15 @@ void benchmark_configure_thread(env_t *env, seL4_CPtr fault_ep, uint8_t prio, ch
     config = thread_config_mcp(config, prio);
     config = thread_config_auth(config, simple_get_tcb(&env->simple));
 #ifdef CONFIG_KERNEL_MCS
-    config.sched_params = sched_params_round_robin(config.sched_params, &env->simple, 0,
+    config.sched_params = sched_params_round_robin(config.sched_params, &env->simple, env->args->core,
                                                    CONFIG_BOOT_THREAD_TIME_SLICE * NS_IN_US);
+#else
+    config.sched_params.core = env->args->core;
 #endif
     config = thread_config_create_reply(config);
     int error = sel4utils_configure_thread_config(&env->slab_vka, &env->vspace, &env->vspace, config, thread);
     ZF_LOGF_IF(error, "Failed to configure %s\n", name);
+    set_benchmark_core(env, thread, config.sched_params, name);
     NAME_THREAD(thread->tcb.cptr, name);
 }
 
@@ -341,7 +365,8 @@ int benchmark_spawn_process(sel4utils_process_t *process, vka_t *vka, vspace_t *
 
 static int get_untyped_count(void *data)
 {
-    return 1;
+    env_t *env = data;
+    return env->args->n_untypeds;
 }
 
 static uint8_t get_cnode_size(void *data)
@@ -352,13 +377,13 @@ static uint8_t get_cnode_size(void *data)
 static seL4_CPtr get_nth_untyped(void *data, int n, size_t *size_bits, uintptr_t *paddr, bool *device)
 {
     env_t *env = data;
-    if (n != 0) {
+    if (n < 0 || (size_t) n >= env->args->n_untypeds) {
         ZF_LOGE("Asked for untyped we don't have");
         return seL4_CapNull;
     }
 
     if (size_bits) {
-        *size_bits = env->args->untyped_size_bits;
+        *size_bits = env->args->untyped_size_bits[n];
     }
 
     if (device) {
@@ -366,9 +391,9 @@ static seL4_CPtr get_nth_untyped(void *data, int n, size_t *size_bits, uintptr_t
     }
 
     if (paddr) {
-        *paddr = 0;
+        *paddr = env->args->untyped_paddr[n];
     }
-    return env->args->untyped_cptr;
+    return env->args->untyped_cptr + n;
 }
 
 static int get_cap_count(void *data)
@@ -543,6 +568,51 @@ NORETURN void benchmark_finished(int exit_code)
     while (true);
 }
 
+/* take the TLB misses on the memory shared with the driver now, rather than in the first samples */
+static void prefault_shared_mem(void)
+{
+    shared_mem_prefault(env.results, env.results_size);
+    shared_mem_prefault(env.args, sizeof(benchmark_args_t));
+    if (env.args->ring != NULL) {
+        shared_mem_prefault(env.args->ring, env.args->ring_pages * PAGE_SIZE_4K);
+    }
+}
+
+bool benchmark_iteration_done(int exit_code)
+{
+    if (exit_code != EXIT_SUCCESS) {
+        benchmark_finished(exit_code);
+    }
+
+    seL4_MessageInfo_t info = seL4_MessageInfo_new(seL4_Fault_NullFault, 0, 0, 1);
+    seL4_SetMR(0, exit_code);
+    seL4_Call(SEL4UTILS_ENDPOINT_SLOT, info);
+    bool again = seL4_GetMR(0);
+    if (again) {
+        /* the driver reset the memory in between */
+        prefault_shared_mem();
+    }
+    return again;
+}
+
+void benchmark_ring_drain(void)
+{
+    seL4_MessageInfo_t info = seL4_MessageInfo_new(seL4_Fault_NullFault, 0, 0, 1);
+    seL4_SetMR(0, SEL4BENCH_RING_DRAIN);
+    seL4_Call(SEL4UTILS_ENDPOINT_SLOT, info);
+}
+
+void benchmark_ring_set_stream(env_t *env, seL4_Word stream)
+{
+    sample_ring_t *ring = env->args->ring;
+    ZF_LOGF_IF(ring == NULL, "Benchmark was not started with a sample ring");
+
+    if (sample_ring_count(ring) != 0) {
+        benchmark_ring_drain();
+    }
+    ring->stream = stream;
+}
+
 static char *benchmark_io_fdt_get(void *cookie)
 {
     return (cookie != NULL) ? (char *) cookie : NULL;
@@ -573,12 +643,17 @@ env_t *benchmark_get_env(int argc, char **argv, size_t results_size,
 
     env.args = (void *) atol(argv[0]);
     env.results = env.args->results;
+    env.results_size = results_size;
     init_simple(&env);
 
     sel4rpc_client_init(&env.rpc_client, SEL4UTILS_ENDPOINT_SLOT, SEL4BENCH_PROTOBUF_RPC);
     env.allocman = init_allocator(&env.simple, &env.delegate_vka);
+    if (config_set(CONFIG_CACHE_COLOURING)) {
+        /* before anything is allocated with it, by us or the slab allocator */
+        cache_colour_vka(&env.delegate_vka);
+    }
     init_vspace(&env.delegate_vka, &env.vspace, &env.data, env.args->stack_pages, env.args->stack_vaddr,
-                (uintptr_t) env.results, results_size, (uintptr_t) env.args);
+                (uintptr_t) env.results, results_size, env.args);
     init_allocator_vspace(env.allocman, &env.vspace);
     parse_code_region(&env.region);
 
@@ -621,6 +696,8 @@ env_t *benchmark_get_env(int argc, char **argv, size_t results_size,
 
     env.ntfn_id = MINI_IRQ_INTERFACE_NTFN_ID;
 
+    prefault_shared_mem();
+
     return &env;
 }
 
@@ -0,0 +1,260 @@
+#!/usr/bin/env python3
+#
+# Copyright 2020, Data61, CSIRO (ABN 41 687 119 230)
+#
+# SPDX-License-Identifier: BSD-2-Clause
+#
+
+"""
+Compare the results of two sel4bench runs, e.g. before and after a kernel
+change, and report which results got significantly slower or faster.
+
+Result rows are matched by their "Benchmark" name and the extra columns of the
+row (e.g. "Function", "Direction" and "IPC length" for ipc). Rows that appear
+more than once, e.g. with ITERATIONS > 1, are pooled.
+
+Rows with raw results (either encoding) are compared with a two sided
+Mann-Whitney U test, with Cliff's delta as the effect size. Rows with only
+summary statistics fall back to Welch's t-test on the mean, with Cohen's d as
+the effect size. Lower is better, as for cycle counts.
+
+A change is reported when it is significant at --alpha and the median (or
+mean) moved by at least --threshold percent. The exit status is 1 if there
+were any regressions, 0 otherwise.
+"""
+
+import argparse
+import json
+import math
+import re
+import sys
+
+from decode_results import DecodeError, decode_compact, extract_json, COMPACT_KEY, RAW_KEY
+
+# keys of a row that are statistics of the result, rather than extra columns
+STAT_KEYS = {
+    "Min", "Max", "Mean", "Stddev", "Variance", "Mode", "Median", "1st quantile", "3rd quantile",
+    "Samples", RAW_KEY, COMPACT_KEY, "Mean precision", "Median precision", "Converged", "Max index",
+    "Mean bootstrap CI95", "Median bootstrap CI95", "Mild outliers", "Severe outliers",
+    # of rows merged from several runs (MergeIterations)
+    "Iterations", "Within-run variance", "Between-run variance", "Between-run fraction", "Run means",
+    "Run medians", "Run median range", "Run median stddev", "Merged from summaries",
+    # counts of PMU events per operation (PmuEvents)
+    "Events",
+    # warm-up detected in the samples (WarmupDetection)
+    "Warm-up samples", "Steady state",
+    # estimates of the overheads, whose rows are told apart by "Overhead" (and "Core")
+    "Cycles", "Confidence", "Stable",
+}
+PERCENTILE_KEY = re.compile(r"^p[0-9.]+$")
+
+
+class Row:
+    """Pooled results of all the rows with the same key"""
+
+    def __init__(self):
+        self.samples = []
+        # (mean, stddev, n) of rows without raw results
+        self.summaries = []
+
+
+def row_key(benchmark, row):
+    extra = tuple(sorted((k, json.dumps(v)) for k, v in row.items()
+                         if k not in STAT_KEYS and not PERCENTILE_KEY.match(k)))
+    return (benchmark, extra)
+
+
+def describe_key(key):
+    benchmark, extra = key
+    if not extra:
+        return benchmark
+    return "%s [%s]" % (benchmark, ", ".join("%s=%s" % (k, v) for k, v in extra))
+
+
+def load_rows(path):
+    with open(path) as f:
+        try:
+            results = json.loads(extract_json(f.read()))
+        except (DecodeError, ValueError) as e:
+            sys.exit("error: could not read results from %s: %s" % (path, e))
+
+    rows = {}
+    for result_set in results:
+        # benchmarks that fail to process produce an empty object
+        if not isinstance(result_set, dict) or "Benchmark" not in result_set:
+            continue
+        for row in result_set.get("Results", []):
+            key = row_key(result_set["Benchmark"], row)
+            pooled = rows.setdefault(key, Row())
+            if COMPACT_KEY in row:
+                try:
+                    pooled.samples.extend(decode_compact(row[COMPACT_KEY]))
+                except (DecodeError, KeyError, ValueError) as e:
+                    sys.exit("error: %s in %s: %s" % (describe_key(key), path, e))
+            elif RAW_KEY in row:
+                pooled.samples.extend(row[RAW_KEY])
+            elif isinstance(row.get("Mean"), (int, float)) and row.get("Samples"):
+                pooled.summaries.append((row["Mean"], row.get("Stddev", 0) or 0, row["Samples"]))
+    return rows
+
+
+def normal_sf(z):
+    """Two sided p-value of a standard normal statistic"""
+    return math.erfc(abs(z) / math.sqrt(2))
+
+
+def median(samples):
+    s = sorted(samples)
+    n = len(s)
+    return (s[(n - 1) // 2] + s[n // 2]) / 2
+
+
+def mann_whitney(base, new):
+    """
+    Returns the two sided p-value of the Mann-Whitney U test, using the normal
+    approximation with a correction for ties, and Cliff's delta, which is positive
+    when new tends to be larger than base.
+    """
+    n1, n2 = len(base), len(new)
+    combined = sorted([(v, 0) for v in base] + [(v, 1) for v in new])
+
+    # rank with the average rank for ties
+    rank_sum_new = 0.0
+    tie_term = 0
+    i = 0
+    while i < len(combined):
+        j = i
+        while j < len(combined) and combined[j][0] == combined[i][0]:
+            j += 1
+        rank = (i + j + 1) / 2
+        rank_sum_new += rank * sum(1 for k in range(i, j) if combined[k][1] == 1)
+        tie_term += (j - i) ** 3 - (j - i)
+        i = j
+
+    u_new = rank_sum_new - n2 * (n2 + 1) / 2
+    delta = 2 * u_new / (n1 * n2) - 1
+
+    n = n1 + n2
+    variance = n1 * n2 / 12 * ((n + 1) - tie_term / (n * (n - 1)))
+    if variance <= 0:
+        # all samples are identical
+        return 1.0, delta
+    z = (u_new - n1 * n2 / 2) / math.sqrt(variance)
+    return normal_sf(z), delta
+
+
+def pool_summaries(summaries):
+    """Combine (mean, stddev, n) of several rows into one"""
+    n = sum(s[2] for s in summaries)
+    mean = sum(s[0] * s[2] for s in summaries) / n
+    # within and between row sums of squares
+    ss = sum((s[2] - 1) * s[1] ** 2 + s[2] * (s[0] - mean) ** 2 for s in summaries)
+    stddev = math.sqrt(ss / (n - 1)) if n > 1 else 0
+    return mean, stddev, n
+
+
+def welch(base, new):
+    """
+    Returns the two sided p-value of Welch's t-test, using the normal
+    approximation (the sample sizes are large), and Cohen's d.
+    """
+    m1, s1, n1 = base
+    m2, s2, n2 = new
+    se = math.sqrt(s1 ** 2 / n1 + s2 ** 2 / n2)
+    pooled = math.sqrt((s1 ** 2 + s2 ** 2) / 2)
+    d = (m2 - m1) / pooled if pooled > 0 else 0.0
+    if se == 0:
+        return (1.0 if m1 == m2 else 0.0), d
+    return normal_sf((m2 - m1) / se), d
+
+
+def compare(key, base, new, args):
+    """Returns a dict describing the comparison, or None if it cannot be done"""
+    if len(base.samples) > 1 and len(new.samples) > 1:
+        old_value, new_value = median(base.samples), median(new.samples)
+        p, effect = mann_whitney(base.samples, new.samples)
+        stat, effect_name = "median", "Cliff's delta"
+    elif base.summaries and new.summaries:
+        b, n = pool_summaries(base.summaries), pool_summaries(new.summaries)
+        old_value, new_value = b[0], n[0]
+        p, effect = welch(b, n)
+        stat, effect_name = "mean", "Cohen's d"
+    else:
+        return None
+
+    change = (new_value - old_value) / old_value * 100 if old_value else 0.0
+    significant = p < args.alpha and abs(change) >= args.threshold
+    if significant and change > 0:
+        verdict = "regression"
+    elif significant and change < 0:
+        verdict = "improvement"
+    else:
+        verdict = "unchanged"
+
+    return {
+        "Benchmark": describe_key(key),
+        "Statistic": stat,
+        "Baseline": old_value,
+        "New": new_value,
+        "Change %": change,
+        "p-value": p,
+        "Effect size": effect,
+        "Effect measure": effect_name,
+        "Verdict": verdict,
+    }
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__,
+                                     formatter_class=argparse.RawDescriptionHelpFormatter)
+    parser.add_argument("baseline", help="console log or JSON output of the baseline run")
+    parser.add_argument("new", help="console log or JSON output of the run to compare")
+    parser.add_argument("--alpha", type=float, default=0.01,
+                        help="significance level of the tests (default: %(default)s)")
+    parser.add_argument("--threshold", type=float, default=1.0,
+                        help="smallest change of the median or mean, in percent, to report "
+                             "(default: %(default)s)")
+    parser.add_argument("--all", action="store_true",
+                        help="also list results that did not change")
+    parser.add_argument("--json", action="store_true",
+                        help="output the comparisons as JSON rather than a table")
+    args = parser.parse_args()
+
+    base_rows = load_rows(args.baseline)
+    new_rows = load_rows(args.new)
+
+    comparisons = []
+    for key in base_rows:
+        if key not in new_rows:
+            continue
+        comparison = compare(key, base_rows[key], new_rows[key], args)
+        if comparison is not None:
+            comparisons.append(comparison)
+
+    only_base = [describe_key(k) for k in base_rows if k not in new_rows]
+    only_new = [describe_key(k) for k in new_rows if k not in base_rows]
+
+    shown = [c for c in comparisons if args.all or c["Verdict"] != "unchanged"]
+    if args.json:
+        json.dump({"Comparisons": shown, "Only in baseline": only_base, "Only in new": only_new},
+                  sys.stdout, indent=2)
+        sys.stdout.write("\n")
+    else:
+        for c in shown:
+            print("%-11s %s: %s %.1f -> %.1f (%+.2f%%, p=%.2g, %s %+.3f)" %
+                  (c["Verdict"], c["Benchmark"], c["Statistic"], c["Baseline"], c["New"],
+                   c["Change %"], c["p-value"], c["Effect measure"], c["Effect size"]))
+        for name in only_base:
+            print("missing     %s: only in baseline" % name)
+        for name in only_new:
+            print("new         %s: only in new run" % name)
+
+    regressions = sum(1 for c in comparisons if c["Verdict"] == "regression")
+    improvements = sum(1 for c in comparisons if c["Verdict"] == "improvement")
+    print("%d compared, %d regressions, %d improvements" % (len(comparisons), regressions, improvements),
+          file=sys.stderr)
+    return 1 if regressions else 0
+
+
+if __name__ == "__main__":
+    sys.exit(main())
@@ -0,0 +1,134 @@
+#!/usr/bin/env python3
+#
+# Copyright 2020, Data61, CSIRO (ABN 41 687 119 230)
+#
+# SPDX-License-Identifier: BSD-2-Clause
+#
+
+"""
+Extract the JSON results from a sel4bench log and expand raw results that were
+output with the compact encoding (RawResultsEncoding=Compact) back into the
+usual "Raw results" arrays of integers.
+
+The input can either be a full console log, in which case the JSON between the
+"JSON OUTPUT" and "END JSON OUTPUT" markers is used, or plain JSON.
+"""
+
+import argparse
+import base64
+import json
+import sys
+import zlib
+
+ENCODING_NAME = "delta-zigzag-leb128-base64"
+COMPACT_KEY = "Raw results compact"
+RAW_KEY = "Raw results"
+
+START_MARKER = "JSON OUTPUT"
+END_MARKER = "END JSON OUTPUT"
+
+
+class DecodeError(Exception):
+    pass
+
+
+def extract_json(text):
+    """Return the JSON document within text, which may be a full console log."""
+    end = text.rfind(END_MARKER)
+    if end < 0:
+        return text
+    start = text.rfind("\n" + START_MARKER, 0, end)
+    if start < 0:
+        if not text.startswith(START_MARKER):
+            raise DecodeError("found '%s' without '%s'" % (END_MARKER, START_MARKER))
+        start = 0
+    else:
+        start += 1
+    return text[start + len(START_MARKER):end]
+
+
+def decode_block(block):
+    data = base64.b64decode(block["Data"], validate=True)
+    crc = zlib.crc32(data) & 0xFFFFFFFF
+    if crc != block["CRC32"]:
+        raise DecodeError("CRC mismatch: expected 0x%08x, got 0x%08x" % (block["CRC32"], crc))
+
+    samples = []
+    value = 0
+    shift = 0
+    prev = 0
+    for byte in data:
+        value |= (byte & 0x7F) << shift
+        shift += 7
+        if byte & 0x80:
+            continue
+        delta = (value >> 1) ^ -(value & 1)
+        prev = (prev + delta) & 0xFFFFFFFFFFFFFFFF
+        samples.append(prev)
+        value = 0
+        shift = 0
+
+    if shift != 0:
+        raise DecodeError("truncated varint at end of block")
+    if len(samples) != block["Samples"]:
+        raise DecodeError("expected %d samples in block, got %d" % (block["Samples"], len(samples)))
+    return samples
+
+
+def decode_compact(compact):
+    if compact.get("Encoding") != ENCODING_NAME:
+        raise DecodeError("unknown encoding '%s'" % compact.get("Encoding"))
+    samples = []
+    for block in compact["Blocks"]:
+        samples.extend(decode_block(block))
+    if len(samples) != compact["Samples"]:
+        raise DecodeError("expected %d samples, got %d" % (compact["Samples"], len(samples)))
+    return samples
+
+
+def expand(node, errors, name=None):
+    """Replace every compact raw result below node, in place."""
+    if isinstance(node, list):
+        for item in node:
+            expand(item, errors, name)
+    elif isinstance(node, dict):
+        name = node.get("Benchmark", name)
+        if COMPACT_KEY in node:
+            try:
+                node[RAW_KEY] = decode_compact(node[COMPACT_KEY])
+            except (DecodeError, KeyError, ValueError) as e:
+                errors.append("%s: %s" % (name, e))
+            else:
+                del node[COMPACT_KEY]
+        for value in node.values():
+            expand(value, errors, name)
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__,
+                                     formatter_class=argparse.RawDescriptionHelpFormatter)
+    parser.add_argument("input", nargs="?", type=argparse.FileType("r"), default=sys.stdin,
+                        help="console log or JSON output of sel4bench (default: stdin)")
+    parser.add_argument("-o", "--output", type=argparse.FileType("w"), default=sys.stdout,
+                        help="where to write the decoded JSON (default: stdout)")
+    parser.add_argument("--indent", type=int, default=None,
+                        help="indent the output JSON by this many spaces")
+    args = parser.parse_args()
+
+    try:
+        results = json.loads(extract_json(args.input.read()))
+    except (DecodeError, ValueError) as e:
+        sys.exit("error: could not read results: %s" % e)
+
+    errors = []
+    expand(results, errors)
+    json.dump(results, args.output, indent=args.indent)
+    args.output.write("\n")
+
+    for error in errors:
+        print("error: %s" % error, file=sys.stderr)
+    return 1 if errors else 0
+
+
+if __name__ == "__main__":
+    sys.exit(main())
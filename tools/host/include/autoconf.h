@@ -0,0 +1,8 @@
+/*
+ * Copyright 2020, Data61, CSIRO (ABN 41 687 119 230)
+ *
+ * SPDX-License-Identifier: BSD-2-Clause
+ */
+#pragma once
+
+/* Shim for building the results processing on Linux, see tools/host/CMakeLists.txt */
@@ -0,0 +1,17 @@
+/*
+ * Copyright 2020, Data61, CSIRO (ABN 41 687 119 230)
+ *
+ * SPDX-License-Identifier: BSD-2-Clause
+ */
+#pragma once
+
+/*
+ * Shim of libsel4benchsupport's benchmark.h, which pulls in most of the seL4
+ * libraries. The results processing only needs these definitions from it.
+ */
+#include <sel4bench/sel4bench.h>
+
+/* average events = sel4bench generic events + the cycle counter */
+#define NUM_AVERAGE_EVENTS (SEL4BENCH_NUM_GENERIC_EVENTS + 1u)
+#define CYCLE_COUNT_EVENT SEL4BENCH_NUM_GENERIC_EVENTS
+#define AVERAGE_RUNS 10000
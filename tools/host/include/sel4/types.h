@@ -0,0 +1,13 @@
+/*
+ * Copyright 2020, Data61, CSIRO (ABN 41 687 119 230)
+ *
+ * SPDX-License-Identifier: BSD-2-Clause
+ */
+#pragma once
+
+#include <stdint.h>
+
+typedef uintptr_t seL4_Word;
+typedef seL4_Word seL4_CPtr;
+
+#define seL4_WordBits (sizeof(seL4_Word) * 8)
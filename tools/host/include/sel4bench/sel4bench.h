@@ -0,0 +1,24 @@
+/*
+ * Copyright 2020, Data61, CSIRO (ABN 41 687 119 230)
+ *
+ * SPDX-License-Identifier: BSD-2-Clause
+ */
+#pragma once
+
+#include <inttypes.h>
+#include <stdint.h>
+
+/* The root task only needs the cycle count type and the generic event names */
+typedef uint64_t ccnt_t;
+#define CCNT_FORMAT "%"PRIu64
+
+#define SEL4BENCH_NUM_GENERIC_EVENTS 7
+static const char *const GENERIC_EVENT_NAMES[SEL4BENCH_NUM_GENERIC_EVENTS] = {
+    "CACHE_L1I_MISS",
+    "CACHE_L1D_MISS",
+    "TLB_L1I_MISS",
+    "TLB_L1D_MISS",
+    "EXECUTE_INSTRUCTION",
+    "BRANCH_MISPREDICT",
+    "MEMORY_ACCESS",
+};
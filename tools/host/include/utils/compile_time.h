@@ -0,0 +1,8 @@
+/*
+ * Copyright 2020, Data61, CSIRO (ABN 41 687 119 230)
+ *
+ * SPDX-License-Identifier: BSD-2-Clause
+ */
+#pragma once
+
+#define compile_time_assert(name, expr) _Static_assert(expr, #name)
@@ -0,0 +1,13 @@
+/*
+ * Copyright 2020, Data61, CSIRO (ABN 41 687 119 230)
+ *
+ * SPDX-License-Identifier: BSD-2-Clause
+ */
+#pragma once
+
+/* As in libutils: config_set(CONFIG_X) is 1 if CONFIG_X is defined to 1, 0 otherwise */
+#define _macrotest_1 ,
+#define config_set(macro) _is_set_(macro)
+#define _is_set_(value) _is_set__(_macrotest_##value)
+#define _is_set__(comma) _is_set___(comma 1, 0)
+#define _is_set___(_, v, ...) v
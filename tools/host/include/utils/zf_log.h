@@ -0,0 +1,38 @@
+/*
+ * Copyright 2020, Data61, CSIRO (ABN 41 687 119 230)
+ *
+ * SPDX-License-Identifier: BSD-2-Clause
+ */
+#pragma once
+
+#include <stdio.h>
+#include <stdlib.h>
+
+#define ZF_LOG_VERBOSE 1
+#define ZF_LOG_DEBUG   2
+#define ZF_LOG_INFO    3
+#define ZF_LOG_WARN    4
+#define ZF_LOG_ERROR   5
+#define ZF_LOG_FATAL   6
+
+#ifndef ZF_LOG_LEVEL
+#define ZF_LOG_LEVEL ZF_LOG_WARN
+#endif
+
+#define ZF_LOG_PRINT(level, tag, ...) do { \
+    if ((level) >= ZF_LOG_LEVEL) { \
+        fprintf(stderr, tag " %s:%d ", __FILE__, __LINE__); \
+        fprintf(stderr, __VA_ARGS__); \
+        fprintf(stderr, "\n"); \
+    } \
+} while (0)
+
+#define ZF_LOGV(...) ZF_LOG_PRINT(ZF_LOG_VERBOSE, "V", __VA_ARGS__)
+#define ZF_LOGD(...) ZF_LOG_PRINT(ZF_LOG_DEBUG, "D", __VA_ARGS__)
+#define ZF_LOGI(...) ZF_LOG_PRINT(ZF_LOG_INFO, "I", __VA_ARGS__)
+#define ZF_LOGW(...) ZF_LOG_PRINT(ZF_LOG_WARN, "W", __VA_ARGS__)
+#define ZF_LOGE(...) ZF_LOG_PRINT(ZF_LOG_ERROR, "E", __VA_ARGS__)
+#define ZF_LOGF(...) do { ZF_LOG_PRINT(ZF_LOG_FATAL, "F", __VA_ARGS__); abort(); } while (0)
+
+#define ZF_LOGF_IF(cond, ...) do { if (cond) { ZF_LOGF(__VA_ARGS__); } } while (0)
+#define ZF_LOGE_IF(cond, ...) do { if (cond) { ZF_LOGE(__VA_ARGS__); } } while (0)
@@ -0,0 +1,168 @@
+/*
+ * Copyright 2020, Data61, CSIRO (ABN 41 687 119 230)
+ *
+ * SPDX-License-Identifier: BSD-2-Clause
+ */
+
+/*
+ * Time the processing of synthetic samples by the sel4bench root task's results
+ * processing, from 10^3 samples up to a maximum (10^7 by default):
+ *
+ *   - process: process_result(), i.e. everything computed from the raw samples
+ *   - json:    result_set_to_json() of the result, and dumping it to a string
+ *
+ * Each is repeated until it has taken at least MIN_SECONDS, and the fastest run
+ * is reported. The statistics processed are checked against those of the
+ * distribution of each generator (see generators.h), and the driver fails if any
+ * of them do not match.
+ */
+
+#include <getopt.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include <src/json.h>
+#include <src/processing.h>
+
+#include "generators.h"
+
+#define DEFAULT_MAX_SAMPLES 10000000
+#define MIN_SECONDS 0.2
+#define SEED 42
+
+typedef struct options {
+    size_t max_samples;
+    const char *generator;
+} options_t;
+
+static double now(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+static double time_process(size_t n, ccnt_t samples[n], ccnt_t copy[n], result_t *result)
+{
+    result_desc_t desc = {
+        .name = "synthetic",
+    };
+    double best = 0;
+    double total = 0;
+
+    for (int runs = 0; runs == 0 || total < MIN_SECONDS; runs++) {
+        memcpy(copy, samples, n * sizeof(ccnt_t));
+        double start = now();
+        *result = process_result(n, copy, desc);
+        double elapsed = now() - start;
+        best = runs == 0 ? elapsed : MIN(best, elapsed);
+        total += elapsed;
+    }
+
+    return best;
+}
+
+static double time_json(result_t *result, size_t *length)
+{
+    result_set_t set = {
+        .name = "synthetic",
+        .n_results = 1,
+        .results = result,
+    };
+    double best = 0;
+    double total = 0;
+
+    for (int runs = 0; runs == 0 || total < MIN_SECONDS; runs++) {
+        double start = now();
+        json_t *json = result_set_to_json(set);
+        char *dumped = json_dumps(json, JSON_COMPACT);
+        double elapsed = now() - start;
+
+        ZF_LOGF_IF(dumped == NULL, "Failed to dump JSON");
+        *length = strlen(dumped);
+        free(dumped);
+        json_decref(json);
+
+        best = runs == 0 ? elapsed : MIN(best, elapsed);
+        total += elapsed;
+    }
+
+    return best;
+}
+
+/* @return the number of statistics that did not match their generator */
+static int run(options_t *options)
+{
+    int failed = 0;
+    ccnt_t *samples = malloc(options->max_samples * sizeof(ccnt_t));
+    ccnt_t *copy = malloc(options->max_samples * sizeof(ccnt_t));
+    ZF_LOGF_IF(samples == NULL || copy == NULL, "Failed to allocate %zu samples", options->max_samples);
+
+    printf("%-10s %10s %12s %12s %10s %12s %8s\n", "generator", "samples", "process ms", "ns/sample",
+           "json ms", "json bytes", "checks");
+
+    for (const generator_t *generator = generators; generator->name != NULL; generator++) {
+        if (options->generator != NULL && strcmp(options->generator, generator->name) != 0) {
+            continue;
+        }
+        for (size_t n = 1000; n <= options->max_samples; n *= 10) {
+            prng_t prng;
+            prng_seed(&prng, SEED);
+            generator->generate(&prng, n, samples);
+
+            result_t result;
+            size_t length;
+            double process = time_process(n, samples, copy, &result);
+            double json = time_json(&result, &length);
+            int mismatches = generator->check(n, &result);
+            failed += mismatches;
+
+            printf("%-10s %10zu %12.3f %12.1f %10.3f %12zu %8s\n", generator->name, n, process * 1e3,
+                   process * 1e9 / n, json * 1e3, length, mismatches == 0 ? "ok" : "FAILED");
+            fflush(stdout);
+        }
+    }
+
+    free(samples);
+    free(copy);
+    return failed;
+}
+
+static void usage(const char *name)
+{
+    fprintf(stderr, "usage: %s [-n max_samples] [-g generator]\ngenerators:", name);
+    for (const generator_t *generator = generators; generator->name != NULL; generator++) {
+        fprintf(stderr, " %s", generator->name);
+    }
+    fprintf(stderr, "\n");
+    exit(EXIT_FAILURE);
+}
+
+int main(int argc, char **argv)
+{
+    options_t options = {
+        .max_samples = DEFAULT_MAX_SAMPLES,
+    };
+    int opt;
+
+    while ((opt = getopt(argc, argv, "n:g:h")) != -1) {
+        switch (opt) {
+        case 'n':
+            options.max_samples = strtoull(optarg, NULL, 0);
+            break;
+        case 'g':
+            options.generator = optarg;
+            break;
+        default:
+            usage(argv[0]);
+        }
+    }
+
+    if (run(&options) != 0) {
+        return EXIT_FAILURE;
+    }
+
+    return 0;
+}
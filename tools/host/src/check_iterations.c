@@ -0,0 +1,201 @@
+/*
+ * Copyright 2020, Data61, CSIRO (ABN 41 687 119 230)
+ *
+ * SPDX-License-Identifier: BSD-2-Clause
+ */
+
+/*
+ * Check the merging of the runs of a benchmark (MergeIterations, see iterations.h)
+ * against the statistics of the samples of all runs pooled. Each run has a result
+ * set with raw samples, whose runs are pooled, and one with early processed
+ * results, whose runs are merged from their summaries. The runs are shifted from
+ * one another, so that they differ by a known between-run variance.
+ */
+
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <src/iterations.h>
+#include <src/json.h>
+#include <src/processing.h>
+
+#include "generators.h"
+
+#define SAMPLES 20000
+#define RUN_SHIFT 100
+#define SEED 42
+
+static int compare_samples(const void *a, const void *b)
+{
+    ccnt_t first = *(const ccnt_t *) a;
+    ccnt_t second = *(const ccnt_t *) b;
+    return (first > second) - (first < second);
+}
+
+static double row_real(json_t *set, const char *key)
+{
+    json_t *row = json_array_get(json_object_get(set, "Results"), 0);
+    json_t *value = json_object_get(row, key);
+    ZF_LOGF_IF(value == NULL, "Merged row has no %s", key);
+    return json_number_value(value);
+}
+
+/* statistics of the samples of all runs, computed directly */
+typedef struct {
+    double mean;
+    double variance;
+    double median;
+    /* variance of the samples around the mean of their run */
+    double within_variance;
+} pooled_t;
+
+static pooled_t pool(size_t runs, size_t n, ccnt_t samples[runs][n])
+{
+    pooled_t pooled = {0};
+    size_t total = runs * n;
+    ccnt_t *all = malloc(total * sizeof(ccnt_t));
+    ZF_LOGF_IF(all == NULL, "Failed to allocate %zu samples", total);
+
+    double run_means[runs];
+    for (size_t r = 0; r < runs; r++) {
+        run_means[r] = 0;
+        for (size_t i = 0; i < n; i++) {
+            all[r * n + i] = samples[r][i];
+            run_means[r] += samples[r][i];
+        }
+        pooled.mean += run_means[r];
+        run_means[r] /= n;
+    }
+    pooled.mean /= total;
+
+    for (size_t r = 0; r < runs; r++) {
+        for (size_t i = 0; i < n; i++) {
+            pooled.variance += (samples[r][i] - pooled.mean) * (samples[r][i] - pooled.mean);
+            pooled.within_variance += (samples[r][i] - run_means[r]) * (samples[r][i] - run_means[r]);
+        }
+    }
+    pooled.variance /= total;
+    pooled.within_variance /= total - runs;
+
+    qsort(all, total, sizeof(ccnt_t), compare_samples);
+    pooled.median = total % 2 ? all[total / 2] : (all[total / 2 - 1] + all[total / 2]) / 2.0;
+    free(all);
+    return pooled;
+}
+
+static int check_raw(json_t *set, pooled_t pooled, size_t total)
+{
+    int failed = 0;
+    failed += expect("samples", row_real(set, "Samples"), total, 0);
+    /* the mean is rounded to a whole cycle */
+    failed += expect("mean", row_real(set, "Mean"), pooled.mean, 0.5);
+    failed += expect("variance", row_real(set, "Variance"), pooled.variance, 0.01 * pooled.variance + 1);
+    failed += expect("median", row_real(set, "Median"), pooled.median, 0);
+    failed += expect("within-run variance", row_real(set, "Within-run variance"), pooled.within_variance,
+                     0.01 * pooled.within_variance);
+    /* the runs are RUN_SHIFT apart. The means of the runs are rounded to whole cycles */
+    failed += expect("between-run variance", row_real(set, "Between-run variance"), RUN_SHIFT * RUN_SHIFT,
+                     0.02 * RUN_SHIFT * RUN_SHIFT);
+
+    json_t *row = json_array_get(json_object_get(set, "Results"), 0);
+    json_t *mean_ci = json_object_get(row, "Mean bootstrap CI95");
+    if (CONFIG_BOOTSTRAP_RESAMPLES > 0) {
+        if (mean_ci == NULL) {
+            fprintf(stderr, "pooled row has no mean bootstrap interval\n");
+            return failed + 1;
+        }
+        /* combined from the runs, so that of the within-run noise alone */
+        double half_width = (json_number_value(json_array_get(mean_ci, 1)) -
+                             json_number_value(json_array_get(mean_ci, 0))) / 2;
+        failed += expect("mean bootstrap half-width", half_width, 1.96 * sqrt(pooled.within_variance / total),
+                         0.15 * 1.96 * sqrt(pooled.within_variance / total));
+    }
+    if (json_object_get(row, "Median bootstrap CI95") != NULL) {
+        fprintf(stderr, "pooled row has a median bootstrap interval, which is not known\n");
+        failed++;
+    }
+    if (json_object_get(row, "Merged from summaries") != NULL) {
+        fprintf(stderr, "pooled row is marked as merged from summaries\n");
+        failed++;
+    }
+    return failed;
+}
+
+static int check_summaries(json_t *set, pooled_t pooled, size_t total)
+{
+    int failed = 0;
+    failed += expect("early processing samples", row_real(set, "Samples"), total, 0);
+    /* early processing truncates the mean of each run to whole cycles */
+    failed += expect("early processing mean", row_real(set, "Mean"), pooled.mean, 1);
+    failed += expect("early processing variance", row_real(set, "Variance"), pooled.variance,
+                     0.01 * pooled.variance + 1);
+
+    json_t *row = json_array_get(json_object_get(set, "Results"), 0);
+    if (!json_is_true(json_object_get(row, "Merged from summaries"))) {
+        fprintf(stderr, "early processing row is not marked as merged from summaries\n");
+        failed++;
+    }
+    return failed;
+}
+
+int main(void)
+{
+    ZF_LOGF_IF(!iterations_merging(), "Built without merging of runs");
+
+    const size_t runs = CONFIG_ITERATIONS;
+    const generator_t *normal = &generators[1];
+    ZF_LOGF_IF(strcmp(normal->name, "normal") != 0, "Expected the normal generator");
+
+    static ccnt_t samples[CONFIG_ITERATIONS][SAMPLES];
+    static ccnt_t copy[SAMPLES];
+    prng_t prng;
+    prng_seed(&prng, SEED);
+    for (size_t r = 0; r < runs; r++) {
+        normal->generate(&prng, SAMPLES, samples[r]);
+        for (size_t i = 0; i < SAMPLES; i++) {
+            samples[r][i] += r * RUN_SHIFT;
+        }
+    }
+
+    json_t *raw_set = NULL;
+    json_t *summary_set = NULL;
+    for (size_t r = 0; r < runs; r++) {
+        iterations_begin(r);
+
+        memcpy(copy, samples[r], sizeof(copy));
+        result_t result = process_result(SAMPLES, copy, (result_desc_t) {
+            .name = "pooled",
+        });
+        result_set_t set = {
+            .name = "pooled",
+            .n_results = 1,
+            .results = &result,
+        };
+        json_decref(raw_set);
+        raw_set = result_set_to_json(set);
+
+        ccnt_t sum = 0;
+        ccnt_t sum2 = 0;
+        for (size_t i = 0; i < SAMPLES; i++) {
+            sum += samples[r][i];
+            sum2 += samples[r][i] * samples[r][i];
+        }
+        result = process_result_early_proc(SAMPLES, sum, sum2);
+        set.name = "summaries";
+        json_decref(summary_set);
+        summary_set = result_set_to_json(set);
+
+        processing_release();
+    }
+
+    pooled_t pooled = pool(runs, SAMPLES, samples);
+    int failed = check_raw(raw_set, pooled, runs * SAMPLES) +
+                 check_summaries(summary_set, pooled, runs * SAMPLES);
+    json_decref(raw_set);
+    json_decref(summary_set);
+
+    printf("merging of %zu runs: %s\n", runs, failed == 0 ? "ok" : "FAILED");
+    return failed == 0 ? 0 : EXIT_FAILURE;
+}
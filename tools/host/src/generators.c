@@ -0,0 +1,205 @@
+/*
+ * Copyright 2020, Data61, CSIRO (ABN 41 687 119 230)
+ *
+ * SPDX-License-Identifier: BSD-2-Clause
+ */
+#include <math.h>
+#include <stdio.h>
+
+#include "generators.h"
+
+/* tolerance, in standard errors, of a statistic of random samples */
+#define STANDARD_ERRORS 5
+
+/* uniform in [0, 1) */
+static double uniform(prng_t *prng)
+{
+    return (prng_next(prng) >> 11) * 0x1.0p-53;
+}
+
+/* approximately normal with mean 0 and stddev 1 (Irwin-Hall) */
+static double normal(prng_t *prng)
+{
+    double sum = 0;
+    for (int i = 0; i < 12; i++) {
+        sum += uniform(prng);
+    }
+    return sum - 6;
+}
+
+int expect(const char *what, double value, double expected, double tolerance)
+{
+    if (fabs(value - expected) <= tolerance) {
+        return 0;
+    }
+    fprintf(stderr, "%s is %g, expected %g +- %g\n", what, value, expected, tolerance);
+    return 1;
+}
+
+/* checks that hold whatever the distribution */
+static int check_consistent(const result_t *result)
+{
+    int failed = 0;
+    if (result->min > result->median || result->median > result->max) {
+        fprintf(stderr, "median %g is not between min "CCNT_FORMAT" and max "CCNT_FORMAT"\n",
+                result->median, result->min, result->max);
+        failed++;
+    }
+    if (result->first_quantile > result->median || result->median > result->third_quantile) {
+        fprintf(stderr, "median %g is not between the quartiles %g and %g\n", result->median,
+                result->first_quantile, result->third_quantile);
+        failed++;
+    }
+    /* the mean is rounded to a whole cycle, the interval is not */
+    if (!isnan(result->mean_bootstrap_low) &&
+        (result->mean_bootstrap_low - 0.5 > result->mean || result->mean > result->mean_bootstrap_high + 0.5)) {
+        fprintf(stderr, "mean %g is not in its bootstrap interval [%g, %g]\n", result->mean,
+                result->mean_bootstrap_low, result->mean_bootstrap_high);
+        failed++;
+    }
+    return failed;
+}
+
+/*
+ * Mean, standard deviation and median of samples of a distribution with the
+ * given mean, standard deviation and fourth central moment, and density density
+ * at its median. The generators truncate to whole cycles, which lowers the mean
+ * and median by half a cycle, and the mean is reported rounded to a whole cycle.
+ */
+static int check_distribution(const result_t *result, double mean, double stddev, double fourth,
+                              double median, double density)
+{
+    double n = result->samples;
+    /* standard error of the standard deviation, from that of the variance */
+    double stddev_error = sqrt((fourth - pow(stddev, 4)) / n) / (2 * stddev);
+
+    int failed = check_consistent(result);
+    failed += expect("mean", result->mean, mean - 0.5, STANDARD_ERRORS * stddev / sqrt(n) + 1);
+    failed += expect("stddev", result->stddev, stddev, STANDARD_ERRORS * stddev_error + 0.5);
+    failed += expect("median", result->median, median - 0.5,
+                     STANDARD_ERRORS / (2 * density * sqrt(n)) + 1);
+    return failed;
+}
+
+/* the same value every time, e.g. a stable overhead measurement */
+static void generate_constant(prng_t *prng, size_t n, ccnt_t samples[n])
+{
+    for (size_t i = 0; i < n; i++) {
+        samples[i] = 120;
+    }
+}
+
+static int check_constant(size_t n, const result_t *result)
+{
+    int failed = check_consistent(result);
+    failed += expect("min", result->min, 120, 0);
+    failed += expect("max", result->max, 120, 0);
+    failed += expect("mean", result->mean, 120, 0);
+    failed += expect("median", result->median, 120, 0);
+    failed += expect("stddev", result->stddev, 0, 0);
+    return failed;
+}
+
+/* tightly clustered around a fast path */
+static void generate_normal(prng_t *prng, size_t n, ccnt_t samples[n])
+{
+    for (size_t i = 0; i < n; i++) {
+        samples[i] = 400 + 8 * normal(prng);
+    }
+}
+
+static int check_normal(size_t n, const result_t *result)
+{
+    return check_distribution(result, 400, 8, 3 * pow(8, 4), 400, 1 / (8 * sqrt(2 * M_PI)));
+}
+
+/* mostly fast, with an exponential tail and rare large interruptions */
+static void generate_long_tail(prng_t *prng, size_t n, ccnt_t samples[n])
+{
+    for (size_t i = 0; i < n; i++) {
+        samples[i] = 400 - 50 * log(1 - uniform(prng));
+        if (prng_below(prng, 1000) == 0) {
+            samples[i] += 20000 + prng_below(prng, 10000);
+        }
+    }
+}
+
+static int check_long_tail(size_t n, const result_t *result)
+{
+    /* exponential with mean 50 above 400, and uniform between 20000 and 30000 on top
+     * of one in 1000 samples. The interruptions dominate the variance and the
+     * fourth moment, which are taken about the fast path for simplicity */
+    double p = 1 / 1000.0;
+    double tail_mean = 25000;
+    double tail_square = (pow(30000, 3) - pow(20000, 3)) / (3 * 10000);
+    double tail_fourth = (pow(30000, 5) - pow(20000, 5)) / (5 * 10000);
+    double variance = 50 * 50 + p * tail_square - (p * tail_mean) * (p * tail_mean);
+    double median = 400 + 50 * log(2);
+
+    int failed = check_distribution(result, 450 + p * tail_mean, sqrt(variance), p * tail_fourth, median,
+                                    exp(-(median - 400) / 50) / 50);
+    failed += expect("min", result->min, 400, 0);
+    return failed;
+}
+
+/* hot and cold cache */
+static void generate_bimodal(prng_t *prng, size_t n, ccnt_t samples[n])
+{
+    for (size_t i = 0; i < n; i++) {
+        samples[i] = (prng_below(prng, 2) ? 300 : 1200) + 10 * normal(prng);
+    }
+}
+
+static int check_bimodal(size_t n, const result_t *result)
+{
+    /* the median falls in the gap between the modes, but the quartiles are the
+     * medians of each mode */
+    double n_mode = result->samples / 2.0;
+    double tolerance = STANDARD_ERRORS * 10 * sqrt(2 * M_PI) / (2 * sqrt(n_mode)) + 1;
+
+    int failed = check_consistent(result);
+    failed += expect("mean", result->mean, 750 - 0.5,
+                     STANDARD_ERRORS * 450 / sqrt(result->samples) + 0.5);
+    failed += expect("stddev", result->stddev, sqrt(450 * 450 + 10 * 10), 0.01 * 450);
+    failed += expect("first quartile", result->first_quantile, 300 - 0.5, tolerance);
+    failed += expect("third quartile", result->third_quantile, 1200 - 0.5, tolerance);
+    return failed;
+}
+
+/* slowly increasing, e.g. with a growing data structure. Already sorted */
+static void generate_ascending(prng_t *prng, size_t n, ccnt_t samples[n])
+{
+    for (size_t i = 0; i < n; i++) {
+        samples[i] = 1000 + i / 16;
+    }
+}
+
+static int check_ascending(size_t n, const result_t *result)
+{
+    /* exactly known, from the first sample that was not dropped as warm-up */
+    size_t first = result->warmup_detected ? result->warmup : 0;
+    size_t m = n - first;
+    double sum = 0;
+    for (size_t i = first; i < n; i++) {
+        sum += 1000 + i / 16;
+    }
+    double middle = first + (m - 1) / 2.0;
+
+    int failed = check_consistent(result);
+    failed += expect("samples", result->samples, m, 0);
+    failed += expect("min", result->min, 1000 + first / 16, 0);
+    failed += expect("max", result->max, 1000 + (n - 1) / 16, 0);
+    failed += expect("mean", result->mean, sum / m, 0.5);
+    failed += expect("median", result->median, 1000 + middle / 16, 1);
+    failed += expect("stddev", result->stddev, m / 16.0 / sqrt(12), 0.01 * m / 16.0 / sqrt(12) + 0.5);
+    return failed;
+}
+
+const generator_t generators[] = {
+    { "constant", generate_constant, check_constant },
+    { "normal", generate_normal, check_normal },
+    { "long_tail", generate_long_tail, check_long_tail },
+    { "bimodal", generate_bimodal, check_bimodal },
+    { "ascending", generate_ascending, check_ascending },
+    { NULL, NULL, NULL },
+};
@@ -0,0 +1,36 @@
+/*
+ * Copyright 2020, Data61, CSIRO (ABN 41 687 119 230)
+ *
+ * SPDX-License-Identifier: BSD-2-Clause
+ */
+#pragma once
+
+#include <stddef.h>
+#include <prng.h>
+#include <sel4bench/sel4bench.h>
+
+#include <src/benchmark.h>
+
+/* Synthetic samples, shaped like the cycle counts benchmarks produce */
+typedef struct generator {
+    const char *name;
+    void (*generate)(prng_t *prng, size_t n, ccnt_t samples[n]);
+    /*
+     * Compare the statistics processed from n generated samples with those of the
+     * distribution the generator draws from, within a tolerance for the sample size.
+     * Reports each mismatch on stderr.
+     *
+     * @return the number of mismatches.
+     */
+    int (*check)(size_t n, const result_t *result);
+} generator_t;
+
+/* NULL terminated list of all generators */
+extern const generator_t generators[];
+
+/*
+ * Is value within tolerance of expected? If not, report it on stderr as what.
+ *
+ * @return 0 if it is, 1 if not.
+ */
+int expect(const char *what, double value, double expected, double tolerance);